@@ -0,0 +1,109 @@
+#include "allocator.h"
+#include "bench.h"
+#include "hashmap.h"
+#include "heap.h"
+#include "list.h"
+#include "vector.h"
+
+static int compare_ids(const void *a, const void *b);
+static void bench_vector(const struct allocator *allocator, size_t *ids,
+                         size_t count);
+static void bench_list(const struct allocator *allocator, size_t *ids,
+                       size_t count);
+static void bench_heap(const struct allocator *allocator, size_t *ids,
+                       size_t count);
+static void bench_hashmap(const struct allocator *allocator, size_t *ids,
+                          size_t count);
+static void bench_allocator(const char *name,
+                            void (*workload)(const struct allocator *, size_t *,
+                                             size_t),
+                            size_t *ids, size_t count);
+
+static int compare_ids(const void *a, const void *b) {
+    const size_t *x = a;
+    const size_t *y = b;
+    return (*x > *y) - (*x < *y);
+}
+
+static void bench_vector(const struct allocator *allocator, size_t *ids,
+                         size_t count) {
+    struct vector *vector = vector_create_with_allocator(allocator);
+    for (size_t i = 0; i < count; i++) {
+        vector_push(vector, &ids[i]);
+    }
+    vector_destroy(vector);
+}
+
+static void bench_list(const struct allocator *allocator, size_t *ids,
+                       size_t count) {
+    struct list *list = list_create_with_allocator(allocator);
+    for (size_t i = 0; i < count; i++) {
+        list_push(list, &ids[i]);
+    }
+    for (size_t i = 0; i < count / 2; i++) {
+        list_shift(list);
+    }
+    list_destroy(list);
+}
+
+static void bench_heap(const struct allocator *allocator, size_t *ids,
+                       size_t count) {
+    struct heap *heap = heap_create_with_allocator(compare_ids, allocator);
+    for (size_t i = 0; i < count; i++) {
+        heap_push(heap, &ids[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        heap_pop(heap);
+    }
+    heap_destroy(heap);
+}
+
+static void bench_hashmap(const struct allocator *allocator, size_t *ids,
+                          size_t count) {
+    struct hashmap *map = hashmap_create_with_allocator(allocator);
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_get(map, &key);
+    }
+    hashmap_destroy(map);
+}
+
+static void bench_allocator(const char *name,
+                            void (*workload)(const struct allocator *, size_t *,
+                                             size_t),
+                            size_t *ids, size_t count) {
+    char label[64];
+
+    double start = bench_now();
+    workload(&allocator_libc, ids, count);
+    snprintf(label, sizeof(label), "%s libc", name);
+    bench_report(label, count, bench_now() - start);
+
+    start = bench_now();
+    struct arena *arena = arena_create(1 << 20);
+    workload(&arena->allocator, ids, count);
+    arena_destroy(arena);
+    snprintf(label, sizeof(label), "%s arena", name);
+    bench_report(label, count, bench_now() - start);
+}
+
+int main(int argc, char **argv) {
+    size_t count = bench_count(argc, argv, 1 << 20);
+
+    size_t *ids = calloc(count, sizeof(size_t));
+    for (size_t i = 0; i < count; i++) {
+        ids[i] = (i * 2654435761u) % count;
+    }
+
+    bench_allocator("vector push", bench_vector, ids, count);
+    bench_allocator("list push/shift", bench_list, ids, count);
+    bench_allocator("heap push/pop", bench_heap, ids, count);
+    bench_allocator("hashmap set/get", bench_hashmap, ids, count);
+
+    free(ids);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/* Read a monotonic clock for timing benchmark runs.
+ *
+ * Returns the current time in seconds.
+ */
+static inline double bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/* Print one benchmark result line.
+ *
+ * name    - The benchmark case label.
+ * ops     - The number of operations performed.
+ * seconds - The elapsed time for all operations.
+ *
+ * Returns nothing.
+ */
+static inline void bench_report(const char *name, size_t ops, double seconds) {
+    printf("%-40s %10zu ops %10.1f ns/op\n", name, ops,
+           seconds * 1e9 / (double)ops);
+}
+
+/* Parse an operation count from the command line.
+ *
+ * argc     - The argument count passed to main.
+ * argv     - The arguments passed to main.
+ * fallback - The count to use when none is given.
+ *
+ * Returns the operation count.
+ */
+static inline size_t bench_count(int argc, char **argv, size_t fallback) {
+    if (argc > 1) {
+        return strtoul(argv[1], NULL, 10);
+    }
+    return fallback;
+}
+
+/* Generate a pseudo-random number with xorshift. Each thread keeps its own
+ * state so threaded benchmarks don't share a generator.
+ *
+ * state - The generator state, seeded with any non-zero value.
+ *
+ * Returns the next number in the sequence.
+ */
+static inline uint64_t bench_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/* Read the peak resident set size of the benchmark process. Run memory
+ * benchmarks in their own process so earlier cases don't raise the peak.
+ *
+ * Returns the peak RSS in kilobytes.
+ */
+static inline long bench_peak_rss(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include "bench.h"
+#include "concurrent_hashmap.h"
+#include <pthread.h>
+
+/* The number of distinct keys each run reads and writes.
+ */
+#define KEYS (1 << 16)
+
+struct locked_map {
+    pthread_mutex_t lock;
+    struct hashmap *map;
+};
+
+struct bench_worker {
+    struct locked_map *locked;
+    struct concurrent_hashmap *sharded;
+    size_t *ids;
+    size_t ops;
+    uint64_t seed;
+};
+
+static void *run_locked(void *context);
+static void *run_sharded(void *context);
+static void bench_threads(const char *name, void *(*run)(void *),
+                          struct locked_map *locked,
+                          struct concurrent_hashmap *sharded, size_t *ids,
+                          size_t threads, size_t count);
+
+static void *run_locked(void *context) {
+    struct bench_worker *worker = context;
+    for (size_t i = 0; i < worker->ops; i++) {
+        uint64_t random = bench_random(&worker->seed);
+        size_t *id = &worker->ids[random % KEYS];
+        struct hkey key = {id, sizeof(*id)};
+        pthread_mutex_lock(&worker->locked->lock);
+        if (random >> 60 == 0) {
+            hashmap_set(worker->locked->map, &key, id);
+        } else {
+            hashmap_get(worker->locked->map, &key);
+        }
+        pthread_mutex_unlock(&worker->locked->lock);
+    }
+    return NULL;
+}
+
+static void *run_sharded(void *context) {
+    struct bench_worker *worker = context;
+    for (size_t i = 0; i < worker->ops; i++) {
+        uint64_t random = bench_random(&worker->seed);
+        size_t *id = &worker->ids[random % KEYS];
+        struct hkey key = {id, sizeof(*id)};
+        if (random >> 60 == 0) {
+            concurrent_hashmap_set(worker->sharded, &key, id);
+        } else {
+            concurrent_hashmap_get(worker->sharded, &key);
+        }
+    }
+    return NULL;
+}
+
+/* Run a 15:1 get/set mix split across threads and report the wall time per
+ * operation, so better scaling shows as a lower ns/op.
+ */
+static void bench_threads(const char *name, void *(*run)(void *),
+                          struct locked_map *locked,
+                          struct concurrent_hashmap *sharded, size_t *ids,
+                          size_t threads, size_t count) {
+    pthread_t handles[64];
+    struct bench_worker workers[64];
+
+    double start = bench_now();
+    for (size_t i = 0; i < threads; i++) {
+        workers[i].locked = locked;
+        workers[i].sharded = sharded;
+        workers[i].ids = ids;
+        workers[i].ops = count / threads;
+        workers[i].seed = 0x9e3779b97f4a7c15 * (i + 1);
+        pthread_create(&handles[i], NULL, run, &workers[i]);
+    }
+    for (size_t i = 0; i < threads; i++) {
+        pthread_join(handles[i], NULL);
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s %zu threads", name, threads);
+    bench_report(label, count, bench_now() - start);
+}
+
+int main(int argc, char **argv) {
+    size_t count = bench_count(argc, argv, 1 << 22);
+
+    size_t *ids = calloc(KEYS, sizeof(size_t));
+    struct locked_map locked;
+    pthread_mutex_init(&locked.lock, NULL);
+    locked.map = hashmap_create();
+    struct concurrent_hashmap *sharded = concurrent_hashmap_create(0);
+
+    for (size_t i = 0; i < KEYS; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(locked.map, &key, &ids[i]);
+        concurrent_hashmap_set(sharded, &key, &ids[i]);
+    }
+
+    for (size_t threads = 1; threads <= 64; threads *= 2) {
+        bench_threads("mutex", run_locked, &locked, sharded, ids, threads,
+                      count);
+        bench_threads("sharded", run_sharded, &locked, sharded, ids, threads,
+                      count);
+    }
+
+    concurrent_hashmap_destroy(sharded);
+    hashmap_destroy(locked.map);
+    pthread_mutex_destroy(&locked.lock);
+    free(ids);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "bench.h"
+#include "expiring_map.h"
+#include "heap.h"
+
+/* The number of distinct session keys, and the range of their time to live
+ * in ticks. The clock advances one tick per operation.
+ */
+#define KEYS (1 << 18)
+#define MIN_TTL 1000
+#define MAX_TTL 60000
+
+/* Run expiration once per this many operations.
+ */
+#define EXPIRE_INTERVAL 64
+
+struct timer {
+    uint64_t deadline;
+    size_t *id;
+};
+
+static int compare_timers(const void *a, const void *b);
+static uint64_t bench_clock(void *context);
+static void bench_heap(size_t *ids, size_t count);
+static void bench_wheel(size_t *ids, size_t count);
+
+static int compare_timers(const void *a, const void *b) {
+    const struct timer *x = a;
+    const struct timer *y = b;
+    return (x->deadline > y->deadline) - (x->deadline < y->deadline);
+}
+
+static uint64_t bench_clock(void *context) {
+    return *(uint64_t *)context;
+}
+
+/* The structure this replaces: a hashmap from key to a separately allocated
+ * timer, and a heap of timers ordered by deadline. Renewing a key leaves its
+ * old timer in the heap, marked stale.
+ */
+static void bench_heap(size_t *ids, size_t count) {
+    struct hashmap *map = hashmap_create();
+    struct heap *timers = heap_create(compare_timers);
+
+    uint64_t now = 0;
+    uint64_t seed = 0x9e3779b97f4a7c15;
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++, now++) {
+        uint64_t random = bench_random(&seed);
+        size_t *id = &ids[random % KEYS];
+        struct hkey key = {id, sizeof(*id)};
+
+        struct timer *timer = malloc(sizeof(struct timer));
+        timer->deadline = now + MIN_TTL + (random >> 32) % (MAX_TTL - MIN_TTL);
+        timer->id = id;
+        heap_push(timers, timer);
+        struct timer *stale = hashmap_set(map, &key, timer);
+        if (stale) {
+            stale->id = NULL;
+        }
+
+        if (i % EXPIRE_INTERVAL == 0) {
+            while ((timer = heap_pop(timers))) {
+                if (timer->deadline > now) {
+                    heap_push(timers, timer);
+                    break;
+                }
+                if (timer->id) {
+                    struct hkey old = {timer->id, sizeof(*timer->id)};
+                    hashmap_remove(map, &old);
+                }
+                free(timer);
+            }
+        }
+    }
+    bench_report("hashmap + heap set", count, bench_now() - start);
+    printf("%-40s %10zu live\n", "hashmap + heap", map->size);
+
+    struct timer *timer;
+    while ((timer = heap_pop(timers))) {
+        free(timer);
+    }
+    heap_destroy(timers);
+    hashmap_destroy(map);
+}
+
+static void bench_wheel(size_t *ids, size_t count) {
+    uint64_t now = 0;
+    struct expiring_map_options options = {0};
+    options.clock = bench_clock;
+    options.context = &now;
+    struct expiring_map *map = expiring_map_create_with_options(&options);
+
+    uint64_t seed = 0x9e3779b97f4a7c15;
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++, now++) {
+        uint64_t random = bench_random(&seed);
+        size_t *id = &ids[random % KEYS];
+        struct hkey key = {id, sizeof(*id)};
+        expiring_map_set(map, &key, id,
+                         MIN_TTL + (random >> 32) % (MAX_TTL - MIN_TTL));
+
+        if (i % EXPIRE_INTERVAL == 0) {
+            expiring_map_expire_step(map, SIZE_MAX);
+        }
+    }
+    bench_report("expiring_map set", count, bench_now() - start);
+    printf("%-40s %10zu live\n", "expiring_map", map->size);
+
+    expiring_map_destroy(map);
+}
+
+int main(int argc, char **argv) {
+    size_t count = bench_count(argc, argv, 1 << 22);
+
+    size_t *ids = calloc(KEYS, sizeof(size_t));
+    for (size_t i = 0; i < KEYS; i++) {
+        ids[i] = i;
+    }
+
+    bench_heap(ids, count);
+    bench_wheel(ids, count);
+
+    free(ids);
+    return 0;
+}
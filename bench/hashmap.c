@@ -0,0 +1,400 @@
+#include "bench.h"
+#include "hashmap.h"
+#include <string.h>
+
+static void bench_layout(const char *layout, unsigned long flags, size_t *ids,
+                         size_t count);
+static void bench_key_length(size_t length, size_t count);
+static void bench_teardown(const char *layout, unsigned long flags,
+                           size_t *ids, size_t count);
+static void bench_hash(const char *hash, unsigned long flags, size_t length,
+                       size_t count);
+static void bench_reserve(size_t *ids, size_t count);
+static void bench_get_many(const char *layout, unsigned long flags,
+                           size_t *ids, size_t count);
+static void *bench_increment(void *value, void *context);
+static void bench_prehashed(size_t length, size_t count);
+static void bench_word_count(size_t count);
+static void bench_collisions(const char *hash, unsigned long flags,
+                             size_t *ids, size_t count);
+
+static void bench_layout(const char *layout, unsigned long flags, size_t *ids,
+                         size_t count) {
+    struct hashmap_options options = {0};
+    options.flags = flags;
+    struct hashmap *map = hashmap_create_with_options(&options);
+    char name[64];
+    double start;
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+    snprintf(name, sizeof(name), "%s set", layout);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        found += hashmap_get(map, &key) != NULL;
+    }
+    snprintf(name, sizeof(name), "%s get hit", layout);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        size_t id = ids[i] + 1;
+        struct hkey key = {&id, sizeof(id)};
+        found += hashmap_get(map, &key) != NULL;
+    }
+    snprintf(name, sizeof(name), "%s get miss", layout);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    struct iterator *entries = hashmap_iterator(map);
+    while (entries->next(entries)) {
+        found++;
+    }
+    entries->destroy(entries);
+    snprintf(name, sizeof(name), "%s iterate", layout);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_remove(map, &key);
+    }
+    snprintf(name, sizeof(name), "%s remove", layout);
+    bench_report(name, count, bench_now() - start);
+
+    if (found != count * 2) {
+        fprintf(stderr, "%s: unexpected lookup count %zu\n", layout, found);
+    }
+
+    hashmap_destroy(map);
+}
+
+static void bench_key_length(size_t length, size_t count) {
+    char *keys = calloc(count, length);
+    for (size_t i = 0; i < count; i++) {
+        char *key = keys + i * length;
+        memset(key, 'k', length);
+        memcpy(key + length - sizeof(i), &i, sizeof(i));
+    }
+
+    struct hashmap *map = hashmap_create();
+    char name[64];
+    double start;
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {keys + i * length, length};
+        hashmap_set(map, &key, keys);
+    }
+    snprintf(name, sizeof(name), "chained %zu byte keys set", length);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {keys + i * length, length};
+        hashmap_get(map, &key);
+    }
+    snprintf(name, sizeof(name), "chained %zu byte keys get", length);
+    bench_report(name, count, bench_now() - start);
+
+    hashmap_destroy(map);
+    free(keys);
+}
+
+static void bench_hash(const char *hash, unsigned long flags, size_t length,
+                       size_t count) {
+    struct hashmap_options options = {0};
+    options.flags = flags;
+    struct hashmap *map = hashmap_create_with_options(&options);
+    char *data = calloc(1, length);
+
+    size_t found = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        data[i % length] = (char)i;
+        struct hkey key = {data, length};
+        found += hashmap_contains(map, &key);
+    }
+    double seconds = bench_now() - start;
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s hash %zu byte keys", hash, length);
+    bench_report(name, count, seconds);
+    printf("%-40s %10.2f GB/s\n", name,
+           (double)(length * count) / seconds / 1e9);
+
+    if (found) {
+        fprintf(stderr, "%s: unexpected key in empty map\n", hash);
+    }
+
+    free(data);
+    hashmap_destroy(map);
+}
+
+static void bench_teardown(const char *layout, unsigned long flags,
+                           size_t *ids, size_t count) {
+    struct hashmap_options options = {0};
+    options.flags = flags;
+    struct hashmap *map = hashmap_create_with_options(&options);
+    char name[64];
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+    snprintf(name, sizeof(name), "%s build", layout);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    hashmap_destroy(map);
+    snprintf(name, sizeof(name), "%s destroy", layout);
+    bench_report(name, count, bench_now() - start);
+}
+
+static void bench_reserve(size_t *ids, size_t count) {
+    struct hashmap *map = hashmap_create_with_capacity(count);
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+    bench_report("chained reserved build", count, bench_now() - start);
+
+    hashmap_destroy(map);
+}
+
+/* Compare looking up keys one at a time with batched lookups, visiting keys
+ * in a shuffled order so neither the buckets nor the entries are in cache.
+ */
+static void bench_get_many(const char *layout, unsigned long flags,
+                           size_t *ids, size_t count) {
+    struct hashmap_options options = {0};
+    options.flags = flags;
+    struct hashmap *map = hashmap_create_with_options(&options);
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+
+    struct hkey *keys = calloc(count, sizeof(struct hkey));
+    uint64_t seed = 0x9e3779b97f4a7c15;
+    for (size_t i = 0; i < count; i++) {
+        keys[i].data = &ids[i];
+        keys[i].length = sizeof(ids[i]);
+    }
+    for (size_t i = count - 1; i > 0; i--) {
+        size_t j = bench_random(&seed) % (i + 1);
+        struct hkey swap = keys[i];
+        keys[i] = keys[j];
+        keys[j] = swap;
+    }
+
+    char name[64];
+    size_t found = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += hashmap_get(map, &keys[i]) != NULL;
+    }
+    snprintf(name, sizeof(name), "%s get shuffled", layout);
+    bench_report(name, count, bench_now() - start);
+
+    void *values[256];
+    for (size_t batch = 16; batch <= 256; batch *= 4) {
+        start = bench_now();
+        for (size_t i = 0; i + batch <= count; i += batch) {
+            found += hashmap_get_many(map, &keys[i], batch, values);
+        }
+        snprintf(name, sizeof(name), "%s get_many %zu shuffled", layout,
+                 batch);
+        bench_report(name, count - count % batch, bench_now() - start);
+    }
+
+    if (found > count * 4) {
+        fprintf(stderr, "%s: unexpected lookup count %zu\n", layout, found);
+    }
+
+    free(keys);
+    hashmap_destroy(map);
+}
+
+static void *bench_increment(void *value, void *context) {
+    (void)context;
+    return (void *)((uintptr_t)value + 1);
+}
+
+/* Count occurrences of short string keys drawn from a small vocabulary, with
+ * a lookup followed by a store, with `hashmap_entry`, and with
+ * `hashmap_update`.
+ */
+static void bench_word_count(size_t count) {
+    size_t vocabulary = count / 16 + 1;
+    char *words = calloc(count, 16);
+    uint64_t seed = 0x2545f4914f6cdd1d;
+    for (size_t i = 0; i < count; i++) {
+        unsigned word = (unsigned)(bench_random(&seed) % vocabulary);
+        snprintf(words + i * 16, 16, "w%u", word);
+    }
+
+    const char *methods[] = {"get+set", "entry", "update"};
+    for (size_t method = 0; method < 3; method++) {
+        struct hashmap *map = hashmap_create();
+        double start = bench_now();
+        for (size_t i = 0; i < count; i++) {
+            char *word = words + i * 16;
+            struct hkey key = {word, strlen(word)};
+            if (method == 0) {
+                void *value = hashmap_get(map, &key);
+                hashmap_set(map, &key, (void *)((uintptr_t)value + 1));
+            } else if (method == 1) {
+                void **value = hashmap_entry(map, &key, NULL);
+                *value = (void *)((uintptr_t)*value + 1);
+            } else {
+                hashmap_update(map, &key, bench_increment, NULL);
+            }
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "word count %s", methods[method]);
+        bench_report(name, count, bench_now() - start);
+        hashmap_destroy(map);
+    }
+
+    free(words);
+}
+
+/* Look up each key in two tiers of maps, where most keys miss the first,
+ * hashing the key for each map versus once with `hashmap_hash`.
+ */
+static void bench_prehashed(size_t length, size_t count) {
+    char *keys = calloc(count, length);
+    struct hashmap *l1 = hashmap_create();
+    struct hashmap *l2 = hashmap_create();
+    for (size_t i = 0; i < count; i++) {
+        char *key = keys + i * length;
+        memset(key, 'k', length);
+        memcpy(key + length - sizeof(i), &i, sizeof(i));
+        struct hkey hkey = {key, length};
+        hashmap_set(i % 8 ? l2 : l1, &hkey, key);
+    }
+
+    char name[64];
+    size_t found = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {keys + i * length, length};
+        void *value = hashmap_get(l1, &key);
+        found += (value ? value : hashmap_get(l2, &key)) != NULL;
+    }
+    snprintf(name, sizeof(name), "two tier %zu byte keys get", length);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {keys + i * length, length};
+        uint64_t hash = hashmap_hash(l1, &key);
+        void *value = hashmap_get_hashed(l1, &key, hash);
+        if (!value) {
+            value = hashmap_get_hashed(l2, &key, hash);
+        }
+        found += value != NULL;
+    }
+    snprintf(name, sizeof(name), "two tier %zu byte keys get_hashed", length);
+    bench_report(name, count, bench_now() - start);
+
+    if (found != count * 2) {
+        fprintf(stderr, "two tier: unexpected lookup count %zu\n", found);
+    }
+
+    hashmap_destroy(l1);
+    hashmap_destroy(l2);
+    free(keys);
+}
+
+/* Insert keys that all land in one bucket of an unseeded map, as keys chosen
+ * by an attacker who knows the hash would.
+ */
+static void bench_collisions(const char *hash, unsigned long flags,
+                             size_t *ids, size_t count) {
+    struct hashmap_options options = {0};
+    options.flags = flags;
+    options.capacity = count * 2;
+    struct hashmap *map = hashmap_create_with_options(&options);
+
+    char name[64];
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+    snprintf(name, sizeof(name), "%s colliding set", hash);
+    bench_report(name, count, bench_now() - start);
+
+    hashmap_destroy(map);
+}
+
+int main(int argc, char **argv) {
+    size_t count = bench_count(argc, argv, 1 << 20);
+
+    size_t *ids = calloc(count, sizeof(size_t));
+    for (size_t i = 0; i < count; i++) {
+        ids[i] = i * 2;
+    }
+
+    bench_layout("chained", 0, ids, count);
+    bench_layout("open", HASHMAP_OPEN, ids, count);
+
+    bench_teardown("chained", 0, ids, count);
+    bench_teardown("chained slab", HASHMAP_SLAB, ids, count);
+    bench_reserve(ids, count);
+
+    bench_word_count(count);
+    bench_prehashed(16, count / 4);
+    bench_prehashed(256, count / 16);
+
+    bench_get_many("chained", 0, ids, count);
+    bench_get_many("open", HASHMAP_OPEN, ids, count);
+
+    bench_key_length(64, count / 4);
+    bench_key_length(1024, count / 16);
+
+    for (size_t length = 4; length <= 4096; length *= 4) {
+        bench_hash("default", 0, length, count * 4 / length + 1024);
+        bench_hash("fnv1a", HASHMAP_FNV1A, length, count * 4 / length + 1024);
+        bench_hash("seeded", HASHMAP_SEEDED, length,
+                   count * 4 / length + 1024);
+        bench_hash("siphash", HASHMAP_SIPHASH, length,
+                   count * 4 / length + 1024);
+    }
+
+    /* Collect keys sharing bucket 0 by probing an empty unseeded map. */
+    size_t colliding = 2048;
+    struct hashmap_options options = {0};
+    options.capacity = colliding * 2;
+    struct hashmap *probe = hashmap_create_with_options(&options);
+    size_t found = 0;
+    for (size_t id = 0; found < colliding; id++) {
+        struct hkey key = {&id, sizeof(id)};
+        hashmap_set(probe, &key, NULL);
+        if (probe->entries[0]) {
+            ids[found++] = id;
+        }
+        hashmap_remove(probe, &key);
+    }
+    hashmap_destroy(probe);
+
+    bench_collisions("default", 0, ids, colliding);
+    bench_collisions("seeded", HASHMAP_SEEDED, ids, colliding);
+    bench_collisions("siphash", HASHMAP_SIPHASH, ids, colliding);
+
+    free(ids);
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include "bench.h"
+#include "heap.h"
+#include <string.h>
+
+/* The number of items in each top k heap, the number of smallest items read
+ * from it, and the number of times they're read.
+ */
+#define ITEMS (1 << 20)
+#define TOP 10
+#define LOOPS 64
+
+/* The number of strings in the string queue. They share a long prefix so
+ * each comparison is relatively expensive.
+ */
+#define STRINGS (1 << 20)
+#define STRING_SIZE 32
+
+static size_t comparisons = 0;
+
+/* The number of pop and push pairs run against each d-ary heap.
+ */
+#define HOLDS (1 << 22)
+
+static int compare_ids(const void *a, const void *b);
+static int compare_strings(const void *a, const void *b);
+static void bench_strings(void);
+static void bench_top_k(size_t *ids);
+static void bench_build(void **items, size_t count, const char *order);
+static void bench_arity(size_t *ids, void **items, size_t count);
+
+static int compare_ids(const void *a, const void *b) {
+    size_t x = *(const size_t *)a;
+    size_t y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_strings(const void *a, const void *b) {
+    comparisons++;
+    return strcmp(a, b);
+}
+
+/* Push and pop random strings, counting comparator calls.
+ */
+static void bench_strings(void) {
+    char *strings = malloc((size_t)STRINGS * STRING_SIZE);
+    uint64_t seed = 0x9e3779b97f4a7c15;
+    for (size_t i = 0; i < STRINGS; i++) {
+        snprintf(strings + i * STRING_SIZE, STRING_SIZE, "session:%020llu",
+                 (unsigned long long)(bench_random(&seed) % 1000000000000));
+    }
+
+    struct heap *heap = heap_create(compare_strings);
+    comparisons = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < STRINGS; i++) {
+        heap_push(heap, strings + i * STRING_SIZE);
+    }
+    bench_report("string heap_push", STRINGS, bench_now() - start);
+    printf("%-40s %10.2f per push\n", "comparisons",
+           (double)comparisons / STRINGS);
+
+    comparisons = 0;
+    start = bench_now();
+    for (size_t i = 0; i < STRINGS; i++) {
+        heap_pop(heap);
+    }
+    bench_report("string heap_pop", STRINGS, bench_now() - start);
+    printf("%-40s %10.2f per pop\n", "comparisons",
+           (double)comparisons / STRINGS);
+
+    heap_destroy(heap);
+    free(strings);
+}
+
+/* Read the smallest few items of a large heap without modifying it: by
+ * popping from a clone, as the heap iterator once did, then with the lazy
+ * iterator and heap_top_k.
+ */
+static void bench_top_k(size_t *ids) {
+    struct heap *heap = heap_create(compare_ids);
+    for (size_t i = 0; i < ITEMS; i++) {
+        heap_push(heap, &ids[i]);
+    }
+    size_t loops = LOOPS;
+
+    size_t sum = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct heap *clone = heap_clone(heap);
+        for (size_t j = 0; j < TOP; j++) {
+            sum += *(size_t *)heap_pop(clone);
+        }
+        heap_destroy(clone);
+    }
+    bench_report("clone and pop top 10", loops, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < loops * 1000; i++) {
+        struct iterator *nodes = heap_iterator(heap);
+        for (size_t j = 0; j < TOP; j++) {
+            sum += *(size_t *)nodes->next(nodes);
+        }
+        nodes->destroy(nodes);
+    }
+    bench_report("heap_iterator top 10", loops * 1000, bench_now() - start);
+
+    void *top[TOP];
+    start = bench_now();
+    for (size_t i = 0; i < loops * 1000; i++) {
+        heap_top_k(heap, TOP, top);
+        sum += *(size_t *)top[TOP - 1];
+    }
+    bench_report("heap_top_k 10", loops * 1000, bench_now() - start);
+
+    if (sum == 0) {
+        fprintf(stderr, "unexpected sum\n");
+    }
+    heap_destroy(heap);
+}
+
+/* Build a queue by pushing items one at a time and by building it bottom-up
+ * from an array, then combine two half-sized queues by pushing one's items
+ * onto the other and by merging them.
+ */
+static void bench_build(void **items, size_t count, const char *order) {
+    char name[64];
+    size_t half = count / 2;
+
+    double start = bench_now();
+    struct heap *heap = heap_create(compare_ids);
+    for (size_t i = 0; i < count; i++) {
+        heap_push(heap, items[i]);
+    }
+    snprintf(name, sizeof(name), "%s heap_push %zu", order, count);
+    bench_report(name, count, bench_now() - start);
+    heap_destroy(heap);
+
+    start = bench_now();
+    heap = heap_create_from(compare_ids, items, count);
+    snprintf(name, sizeof(name), "%s heap_create_from %zu", order, count);
+    bench_report(name, count, bench_now() - start);
+    heap_destroy(heap);
+
+    heap = heap_create_from(compare_ids, items, half);
+    start = bench_now();
+    for (size_t i = half; i < count; i++) {
+        heap_push(heap, items[i]);
+    }
+    snprintf(name, sizeof(name), "%s push halves %zu", order, count);
+    bench_report(name, count - half, bench_now() - start);
+    heap_destroy(heap);
+
+    heap = heap_create_from(compare_ids, items, half);
+    struct heap *other =
+        heap_create_from(compare_ids, items + half, count - half);
+    start = bench_now();
+    heap_merge(heap, other);
+    snprintf(name, sizeof(name), "%s heap_merge halves %zu", order, count);
+    bench_report(name, count - half, bench_now() - start);
+    heap_destroy(other);
+    heap_destroy(heap);
+}
+
+/* Run a scheduler's mix against heaps of each arity: pop the earliest item
+ * and push it back with a later deadline, keeping the heap's size steady.
+ */
+static void bench_arity(size_t *ids, void **items, size_t count) {
+    size_t arities[] = {2, 4, 8};
+    for (size_t a = 0; a < 3; a++) {
+        uint64_t seed = 0x9e3779b97f4a7c15;
+        for (size_t i = 0; i < count; i++) {
+            ids[i] = bench_random(&seed) >> 16;
+        }
+
+        struct heap_options options = {0};
+        options.arity = arities[a];
+        struct heap *heap = heap_create_with_options(compare_ids, &options);
+        heap_push_many(heap, items, count);
+
+        char name[64];
+        double start = bench_now();
+        for (size_t i = 0; i < HOLDS; i++) {
+            size_t *id = heap_pop(heap);
+            *id += bench_random(&seed) >> 40;
+            heap_push(heap, id);
+        }
+        snprintf(name, sizeof(name), "%zu-ary pop+push %zu", arities[a],
+                 count);
+        bench_report(name, HOLDS, bench_now() - start);
+
+        heap_destroy(heap);
+    }
+}
+
+/* The optional argument is the size of the largest queue to build, up to
+ * 100M items.
+ */
+int main(int argc, char **argv) {
+    size_t count = bench_count(argc, argv, 10000000);
+    size_t total = count > ITEMS ? count : ITEMS;
+
+    size_t *ids = calloc(total, sizeof(size_t));
+    void **items = calloc(total, sizeof(void *));
+    uint64_t seed = 0x9e3779b97f4a7c15;
+    for (size_t i = 0; i < total; i++) {
+        ids[i] = bench_random(&seed);
+        items[i] = &ids[i];
+    }
+
+    bench_top_k(ids);
+    bench_strings();
+    size_t sizes[] = {1000, 1000000, 100000000};
+    for (size_t i = 0; i < 3 && sizes[i] <= count; i++) {
+        bench_arity(ids, items, sizes[i]);
+    }
+    for (size_t size = 1000000; size <= count; size *= 10) {
+        bench_build(items, size, "random");
+    }
+
+    /* Descending items are the worst case for pushing onto a min-heap: each
+     * one moves all the way up to the root.
+     */
+    for (size_t i = 0; i < total; i++) {
+        ids[i] = total - i;
+    }
+    for (size_t size = 1000000; size <= count; size *= 10) {
+        bench_build(items, size, "descending");
+    }
+
+    free(items);
+    free(ids);
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include "bench.h"
+#include "hashmap.h"
+#include "list.h"
+#include "vector.h"
+
+/* The number of items in each container. Small containers make the per-loop
+ * cost of allocating an iterator stand out, as on hot paths that walk many
+ * of them.
+ */
+#define ITEMS 16
+
+/* The buffer size for batched iteration.
+ */
+#define BATCH 64
+
+static void bench_vector(size_t *ids, size_t count);
+static void bench_list(size_t *ids, size_t count);
+static void bench_hashmap(size_t *ids, size_t count);
+static void bench_check(const char *name, size_t sum, size_t expected);
+
+static void bench_check(const char *name, size_t sum, size_t expected) {
+    if (sum != expected) {
+        fprintf(stderr, "%s: unexpected sum %zu\n", name, sum);
+    }
+}
+
+static void bench_vector(size_t *ids, size_t count) {
+    struct vector *vector = vector_create();
+    for (size_t i = 0; i < ITEMS; i++) {
+        vector_push(vector, &ids[i]);
+    }
+    size_t loops = count / ITEMS;
+    size_t expected = loops * ITEMS * (ITEMS - 1) / 2;
+
+    size_t sum = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct iterator *items = vector_iterator(vector);
+        while (items->next(items)) {
+            sum += *(size_t *)items->current;
+        }
+        items->destroy(items);
+    }
+    bench_report("vector iterator", loops * ITEMS, bench_now() - start);
+    bench_check("vector iterator", sum, expected);
+
+    sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct iterator *items = vector_iterator(vector);
+        void *batch[BATCH];
+        size_t n;
+        while ((n = items->next_batch(items, batch, BATCH))) {
+            for (size_t j = 0; j < n; j++) {
+                sum += *(size_t *)batch[j];
+            }
+        }
+        items->destroy(items);
+    }
+    bench_report("vector next_batch", loops * ITEMS, bench_now() - start);
+    bench_check("vector next_batch", sum, expected);
+
+    sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct vector_iter items;
+        vector_iter_init(&items, vector);
+        while (vector_iter_next(&items)) {
+            sum += *(size_t *)items.current;
+        }
+    }
+    bench_report("vector iter", loops * ITEMS, bench_now() - start);
+    bench_check("vector iter", sum, expected);
+
+    sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        size_t *id;
+        VECTOR_FOREACH(id, vector) {
+            sum += *id;
+        }
+    }
+    bench_report("vector foreach", loops * ITEMS, bench_now() - start);
+    bench_check("vector foreach", sum, expected);
+
+    vector_destroy(vector);
+}
+
+static void bench_list(size_t *ids, size_t count) {
+    struct list *list = list_create();
+    for (size_t i = 0; i < ITEMS; i++) {
+        list_push(list, &ids[i]);
+    }
+    size_t loops = count / ITEMS;
+    size_t expected = loops * ITEMS * (ITEMS - 1) / 2;
+
+    size_t sum = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct iterator *items = list_iterator(list);
+        while (items->next(items)) {
+            sum += *(size_t *)items->current;
+        }
+        items->destroy(items);
+    }
+    bench_report("list iterator", loops * ITEMS, bench_now() - start);
+    bench_check("list iterator", sum, expected);
+
+    sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct iterator *items = list_iterator(list);
+        void *batch[BATCH];
+        size_t n;
+        while ((n = items->next_batch(items, batch, BATCH))) {
+            for (size_t j = 0; j < n; j++) {
+                sum += *(size_t *)batch[j];
+            }
+        }
+        items->destroy(items);
+    }
+    bench_report("list next_batch", loops * ITEMS, bench_now() - start);
+    bench_check("list next_batch", sum, expected);
+
+    sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct list_iter items;
+        list_iter_init(&items, list);
+        while (list_iter_next(&items)) {
+            sum += *(size_t *)items.current;
+        }
+    }
+    bench_report("list iter", loops * ITEMS, bench_now() - start);
+    bench_check("list iter", sum, expected);
+
+    sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        size_t *id;
+        LIST_FOREACH(id, list) {
+            sum += *id;
+        }
+    }
+    bench_report("list foreach", loops * ITEMS, bench_now() - start);
+    bench_check("list foreach", sum, expected);
+
+    list_destroy(list);
+}
+
+static void bench_hashmap(size_t *ids, size_t count) {
+    struct hashmap *map = hashmap_create();
+    for (size_t i = 0; i < ITEMS; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+    size_t loops = count / ITEMS;
+    size_t expected = loops * ITEMS * (ITEMS - 1) / 2;
+
+    size_t sum = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct iterator *entries = hashmap_iterator(map);
+        while (entries->next(entries)) {
+            struct hentry *entry = entries->current;
+            sum += *(size_t *)entry->value;
+        }
+        entries->destroy(entries);
+    }
+    bench_report("hashmap iterator", loops * ITEMS, bench_now() - start);
+    bench_check("hashmap iterator", sum, expected);
+
+    sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct iterator *entries = hashmap_iterator(map);
+        void *batch[BATCH];
+        size_t n;
+        while ((n = entries->next_batch(entries, batch, BATCH))) {
+            for (size_t j = 0; j < n; j++) {
+                sum += *(size_t *)((struct hentry *)batch[j])->value;
+            }
+        }
+        entries->destroy(entries);
+    }
+    bench_report("hashmap next_batch", loops * ITEMS, bench_now() - start);
+    bench_check("hashmap next_batch", sum, expected);
+
+    sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct hashmap_iter entries;
+        hashmap_iter_init(&entries, map);
+        while (hashmap_iter_next(&entries)) {
+            sum += *(size_t *)entries.current->value;
+        }
+    }
+    bench_report("hashmap iter", loops * ITEMS, bench_now() - start);
+    bench_check("hashmap iter", sum, expected);
+
+    sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < loops; i++) {
+        struct hentry *entry;
+        HASHMAP_FOREACH(entry, map) {
+            sum += *(size_t *)entry->value;
+        }
+    }
+    bench_report("hashmap foreach", loops * ITEMS, bench_now() - start);
+    bench_check("hashmap foreach", sum, expected);
+
+    hashmap_destroy(map);
+}
+
+int main(int argc, char **argv) {
+    size_t count = bench_count(argc, argv, 1 << 26);
+
+    size_t ids[ITEMS];
+    for (size_t i = 0; i < ITEMS; i++) {
+        ids[i] = i;
+    }
+
+    bench_vector(ids, count);
+    bench_list(ids, count);
+    bench_hashmap(ids, count);
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "bench.h"
+#include "hashmap.h"
+
+static int compare_latency(const void *a, const void *b);
+static void bench_latency(const char *layout, unsigned long flags, size_t *ids,
+                          double *latency, size_t count);
+
+static int compare_latency(const void *a, const void *b) {
+    const double *x = a;
+    const double *y = b;
+    return (*x > *y) - (*x < *y);
+}
+
+static void bench_latency(const char *layout, unsigned long flags, size_t *ids,
+                          double *latency, size_t count) {
+    struct hashmap_options options = {0};
+    options.flags = flags;
+    struct hashmap *map = hashmap_create_with_options(&options);
+
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        double start = bench_now();
+        hashmap_set(map, &key, &ids[i]);
+        latency[i] = bench_now() - start;
+    }
+
+    qsort(latency, count, sizeof(double), compare_latency);
+
+    double percentiles[] = {.5, .99, .999, .9999, 1};
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(double); i++) {
+        size_t index = (size_t)(percentiles[i] * (double)(count - 1));
+        char name[64];
+        snprintf(name, sizeof(name), "%s set p%g", layout,
+                 percentiles[i] * 100);
+        printf("%-40s %10.1f us\n", name, latency[index] * 1e6);
+    }
+
+    hashmap_destroy(map);
+}
+
+int main(int argc, char **argv) {
+    size_t count = bench_count(argc, argv, 1 << 22);
+
+    size_t *ids = calloc(count, sizeof(size_t));
+    double *latency = calloc(count, sizeof(double));
+    for (size_t i = 0; i < count; i++) {
+        ids[i] = i;
+    }
+
+    /* Run the incremental map first, while large bucket arrays still come
+     * from fresh zero pages. Memory freed by an earlier run must be zeroed by
+     * calloc, which adds a stall that no rehash strategy can avoid.
+     */
+    bench_latency("incremental", HASHMAP_INCREMENTAL, ids, latency, count);
+    bench_latency("chained", 0, ids, latency, count);
+
+    free(latency);
+    free(ids);
+    return 0;
+}
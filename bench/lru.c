@@ -0,0 +1,155 @@
+#include "bench.h"
+#include "list.h"
+#include "lru_cache.h"
+
+/* The number of entries each cache holds, and the number of distinct keys
+ * requested from it.
+ */
+#define CAPACITY (1 << 16)
+#define KEYS (CAPACITY * 4)
+
+struct byte_counter {
+    size_t live;
+    size_t peak;
+};
+
+static void *count_alloc(void *context, size_t size);
+static void *count_realloc(void *context, void *memory, size_t size,
+                           size_t new_size);
+static void count_free(void *context, void *memory, size_t size);
+static size_t *bench_key(size_t *ids, uint64_t *seed);
+static void bench_map_list(size_t *ids, size_t count);
+static void bench_lru(size_t *ids, size_t count);
+
+static void *count_alloc(void *context, size_t size) {
+    struct byte_counter *counter = context;
+    counter->live += size;
+    counter->peak = counter->live > counter->peak ? counter->live
+                                                  : counter->peak;
+    return malloc(size);
+}
+
+static void *count_realloc(void *context, void *memory, size_t size,
+                           size_t new_size) {
+    struct byte_counter *counter = context;
+    counter->live += new_size - size;
+    counter->peak = counter->live > counter->peak ? counter->live
+                                                  : counter->peak;
+    return realloc(memory, new_size);
+}
+
+static void count_free(void *context, void *memory, size_t size) {
+    struct byte_counter *counter = context;
+    counter->live -= size;
+    free(memory);
+}
+
+/* Pick a key so that four of five requests go to an eighth of the keys,
+ * which fit in the cache, and the rest are spread over all of them.
+ */
+static size_t *bench_key(size_t *ids, uint64_t *seed) {
+    uint64_t random = bench_random(seed);
+    if (random % 5) {
+        return &ids[(random >> 8) % (KEYS / 8)];
+    }
+    return &ids[(random >> 8) % KEYS];
+}
+
+/* The cache this replaces: a hashmap from key to a node in a separate list
+ * kept in recency order. A hit unlinks the node and pushes a new one.
+ */
+static void bench_map_list(size_t *ids, size_t count) {
+    struct byte_counter bytes = {0, 0};
+    struct allocator counter = {count_alloc, count_realloc, count_free,
+                                &bytes};
+    struct hashmap_options options = {0};
+    options.allocator = &counter;
+    struct hashmap *map = hashmap_create_with_options(&options);
+    struct list *recent = list_create_with_allocator(&counter);
+
+    size_t hits = 0;
+    uint64_t seed = 0x9e3779b97f4a7c15;
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        size_t *id = bench_key(ids, &seed);
+        struct hkey key = {id, sizeof(*id)};
+        struct lnode *node = hashmap_get(map, &key);
+        if (node) {
+            hits++;
+            if (node != recent->tail) {
+                if (node == recent->head) {
+                    recent->head = node->next;
+                } else {
+                    node->prev->next = node->next;
+                }
+                node->next->prev = node->prev;
+                recent->length--;
+                allocator_free(recent->allocator, node, sizeof(*node));
+                list_push(recent, id);
+                hashmap_set(map, &key, recent->tail);
+            }
+            continue;
+        }
+
+        list_push(recent, id);
+        hashmap_set(map, &key, recent->tail);
+        if (recent->length > CAPACITY) {
+            size_t *oldest = list_shift(recent);
+            struct hkey evicted = {oldest, sizeof(*oldest)};
+            hashmap_remove(map, &evicted);
+        }
+    }
+    double seconds = bench_now() - start;
+
+    bench_report("map + list", count, seconds);
+    printf("%-40s %10.1f %% hits %6zu bytes/entry\n", "map + list",
+           (double)hits * 100 / (double)count, bytes.peak / CAPACITY);
+
+    list_destroy(recent);
+    hashmap_destroy(map);
+}
+
+static void bench_lru(size_t *ids, size_t count) {
+    struct byte_counter bytes = {0, 0};
+    struct allocator counter = {count_alloc, count_realloc, count_free,
+                                &bytes};
+    struct lru_cache_options options = {0};
+    options.max_entries = CAPACITY;
+    options.allocator = &counter;
+    struct lru_cache *cache = lru_cache_create_with_options(&options);
+
+    size_t hits = 0;
+    uint64_t seed = 0x9e3779b97f4a7c15;
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        size_t *id = bench_key(ids, &seed);
+        struct hkey key = {id, sizeof(*id)};
+        if (lru_cache_get(cache, &key)) {
+            hits++;
+        } else {
+            lru_cache_set(cache, &key, id);
+        }
+    }
+    double seconds = bench_now() - start;
+
+    bench_report("lru_cache", count, seconds);
+    printf("%-40s %10.1f %% hits %6zu bytes/entry\n", "lru_cache",
+           (double)hits * 100 / (double)count, bytes.peak / CAPACITY);
+
+    lru_cache_destroy(cache);
+}
+
+int main(int argc, char **argv) {
+    size_t count = bench_count(argc, argv, 1 << 22);
+
+    size_t *ids = calloc(KEYS, sizeof(size_t));
+    for (size_t i = 0; i < KEYS; i++) {
+        ids[i] = i;
+    }
+
+    bench_map_list(ids, count);
+    bench_lru(ids, count);
+
+    free(ids);
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "allocator.h"
+#include "bench.h"
+#include "compact_hashmap.h"
+#include "hashmap.h"
+#include <string.h>
+
+static void *count_alloc(void *context, size_t size);
+static void *count_realloc(void *context, void *memory, size_t size,
+                           size_t new_size);
+static void count_free(void *context, void *memory, size_t size);
+
+static void *count_alloc(void *context, size_t size) {
+    size_t *calls = context;
+    (*calls)++;
+    return malloc(size);
+}
+
+static void *count_realloc(void *context, void *memory, size_t size,
+                           size_t new_size) {
+    size_t *calls = context;
+    (void)size;
+    (*calls)++;
+    return realloc(memory, new_size);
+}
+
+static void count_free(void *context, void *memory, size_t size) {
+    size_t *calls = context;
+    (void)size;
+    (*calls)++;
+    free(memory);
+}
+
+/* Measure the memory used by a map of short keys. Peak RSS is per process, so
+ * each storage option is measured by its own run.
+ *
+ * Usage: bench-memory [count] [slab|compact]
+ */
+int main(int argc, char **argv) {
+    size_t count = bench_count(argc, argv, 1 << 22);
+
+    char *keys = calloc(count, 16);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(keys + i * 16, &i, sizeof(i));
+    }
+
+    size_t calls = 0;
+    struct allocator counter = {count_alloc, count_realloc, count_free, &calls};
+    struct hashmap_options options = {0};
+    options.allocator = &counter;
+    const char *variant = "chained";
+    bool compact = false;
+    if (argc > 2 && strcmp(argv[2], "slab") == 0) {
+        options.flags = HASHMAP_SLAB;
+        variant = "chained slab";
+    } else if (argc > 2 && strcmp(argv[2], "compact") == 0) {
+        compact = true;
+        variant = "compact";
+    }
+    char name[64];
+
+    long baseline = bench_peak_rss();
+    struct hashmap *map = NULL;
+    struct compact_hashmap *dense = NULL;
+    if (compact) {
+        dense = compact_hashmap_create_with_allocator(&counter);
+    } else {
+        map = hashmap_create_with_options(&options);
+    }
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        struct hkey key = {keys + i * 16, 16};
+        if (compact) {
+            compact_hashmap_set(dense, &key, keys);
+        } else {
+            hashmap_set(map, &key, keys);
+        }
+    }
+    snprintf(name, sizeof(name), "%s 16 byte keys set", variant);
+    bench_report(name, count, bench_now() - start);
+
+    snprintf(name, sizeof(name), "%s 16 byte keys allocations", variant);
+    printf("%-40s %10zu calls %8.2f calls/entry\n", name, calls,
+           (double)calls / (double)count);
+
+    long rss = bench_peak_rss() - baseline;
+    snprintf(name, sizeof(name), "%s 16 byte keys rss", variant);
+    printf("%-40s %10ld KB %10.1f bytes/entry\n", name, rss,
+           (double)rss * 1024 / (double)count);
+
+    start = bench_now();
+    struct iterator *entries =
+        compact ? compact_hashmap_iterator(dense) : hashmap_iterator(map);
+    size_t visited = 0;
+    while (entries->next(entries)) {
+        visited++;
+    }
+    entries->destroy(entries);
+    snprintf(name, sizeof(name), "%s 16 byte keys iterate", variant);
+    bench_report(name, visited, bench_now() - start);
+
+    start = bench_now();
+    if (compact) {
+        compact_hashmap_destroy(dense);
+    } else {
+        hashmap_destroy(map);
+    }
+    snprintf(name, sizeof(name), "%s 16 byte keys destroy", variant);
+    bench_report(name, count, bench_now() - start);
+
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "bench.h"
+#include "concurrent_hashmap.h"
+#include "rcu_hashmap.h"
+#include <pthread.h>
+
+/* The number of distinct keys each run reads.
+ */
+#define KEYS (1 << 16)
+
+struct bench_worker {
+    struct concurrent_hashmap *locked;
+    struct rcu_hashmap *rcu;
+    size_t *ids;
+    size_t ops;
+    uint64_t seed;
+};
+
+static void *run_locked(void *context);
+static void *run_rcu(void *context);
+static void bench_readers(const char *name, void *(*run)(void *),
+                          struct concurrent_hashmap *locked,
+                          struct rcu_hashmap *rcu, size_t *ids,
+                          size_t threads, size_t count);
+
+static void *run_locked(void *context) {
+    struct bench_worker *worker = context;
+    for (size_t i = 0; i < worker->ops; i++) {
+        size_t *id = &worker->ids[bench_random(&worker->seed) % KEYS];
+        struct hkey key = {id, sizeof(*id)};
+        concurrent_hashmap_get(worker->locked, &key);
+    }
+    return NULL;
+}
+
+static void *run_rcu(void *context) {
+    struct bench_worker *worker = context;
+    struct rreader *reader = rcu_hashmap_register(worker->rcu);
+    for (size_t i = 0; i < worker->ops; i++) {
+        size_t *id = &worker->ids[bench_random(&worker->seed) % KEYS];
+        struct hkey key = {id, sizeof(*id)};
+        rcu_hashmap_get(worker->rcu, reader, &key);
+    }
+    rcu_hashmap_unregister(worker->rcu, reader);
+    return NULL;
+}
+
+/* Split lookups across reader threads and report the wall time per lookup,
+ * so better scaling shows as a lower ns/op.
+ */
+static void bench_readers(const char *name, void *(*run)(void *),
+                          struct concurrent_hashmap *locked,
+                          struct rcu_hashmap *rcu, size_t *ids,
+                          size_t threads, size_t count) {
+    pthread_t handles[64];
+    struct bench_worker workers[64];
+
+    double start = bench_now();
+    for (size_t i = 0; i < threads; i++) {
+        workers[i].locked = locked;
+        workers[i].rcu = rcu;
+        workers[i].ids = ids;
+        workers[i].ops = count / threads;
+        workers[i].seed = 0x9e3779b97f4a7c15 * (i + 1);
+        pthread_create(&handles[i], NULL, run, &workers[i]);
+    }
+    for (size_t i = 0; i < threads; i++) {
+        pthread_join(handles[i], NULL);
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s get %zu threads", name, threads);
+    bench_report(label, count, bench_now() - start);
+}
+
+int main(int argc, char **argv) {
+    size_t count = bench_count(argc, argv, 1 << 22);
+
+    size_t *ids = calloc(KEYS, sizeof(size_t));
+    struct concurrent_hashmap *rwlock = concurrent_hashmap_create(1);
+    struct concurrent_hashmap *sharded = concurrent_hashmap_create(0);
+    struct rcu_hashmap *rcu = rcu_hashmap_create();
+
+    for (size_t i = 0; i < KEYS; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        concurrent_hashmap_set(rwlock, &key, &ids[i]);
+        concurrent_hashmap_set(sharded, &key, &ids[i]);
+        rcu_hashmap_set(rcu, &key, &ids[i]);
+    }
+
+    for (size_t threads = 1; threads <= 64; threads *= 2) {
+        bench_readers("rwlock", run_locked, rwlock, rcu, ids, threads, count);
+        bench_readers("sharded", run_locked, sharded, rcu, ids, threads,
+                      count);
+        bench_readers("rcu", run_rcu, NULL, rcu, ids, threads, count);
+    }
+
+    rcu_hashmap_destroy(rcu);
+    concurrent_hashmap_destroy(sharded);
+    concurrent_hashmap_destroy(rwlock);
+    free(ids);
+    return 0;
+}
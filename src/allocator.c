@@ -0,0 +1,307 @@
+#include "allocator.h"
+#include <stdint.h>
+#include <string.h>
+
+/* Every arena allocation is aligned for any fundamental type.
+ */
+#define ARENA_ALIGNMENT 16
+
+struct achunk {
+    struct achunk *next;
+    size_t used;
+    size_t capacity;
+    unsigned char data[];
+};
+
+static void *libc_alloc(void *context, size_t size);
+static void *libc_realloc(void *context, void *memory, size_t size,
+                          size_t new_size);
+static void libc_free(void *context, void *memory, size_t size);
+
+static void *arena_alloc(void *context, size_t size);
+static void *arena_realloc(void *context, void *memory, size_t size,
+                           size_t new_size);
+static void arena_free(void *context, void *memory, size_t size);
+static size_t arena_offset(struct achunk *chunk);
+
+/* The default allocator used by every data structure created without an
+ * explicit allocator. It forwards to the C library's malloc, realloc, and
+ * free functions.
+ */
+const struct allocator allocator_libc = {libc_alloc, libc_realloc, libc_free,
+                                         NULL};
+
+/* Allocate uninitialized memory with an allocator.
+ *
+ * this - The allocator to use.
+ * size - The number of bytes to allocate.
+ *
+ * Returns the memory or null if allocation failed.
+ */
+void *allocator_alloc(const struct allocator *this, size_t size) {
+    return this->alloc(this->context, size);
+}
+
+/* Allocate zeroed memory for an array with an allocator.
+ *
+ * this  - The allocator to use.
+ * count - The number of array elements.
+ * size  - The size of each element.
+ *
+ * The C library allocator forwards to calloc, which can hand out large blocks
+ * of fresh zero pages without touching them.
+ *
+ * Returns the memory or null if allocation failed or the total size overflows.
+ */
+void *allocator_calloc(const struct allocator *this, size_t count,
+                       size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    if (this == &allocator_libc) {
+        return calloc(count, size);
+    }
+
+    void *memory = this->alloc(this->context, count * size);
+    if (memory) {
+        memset(memory, 0, count * size);
+    }
+    return memory;
+}
+
+/* Resize memory previously allocated with the same allocator. Like realloc,
+ * a null memory pointer allocates new memory.
+ *
+ * this     - The allocator that owns the memory.
+ * memory   - The memory to resize, or null.
+ * size     - The current size of the memory in bytes.
+ * new_size - The requested size in bytes.
+ *
+ * Returns the resized memory or null if allocation failed, in which case the
+ * original memory is left untouched.
+ */
+void *allocator_realloc(const struct allocator *this, void *memory, size_t size,
+                        size_t new_size) {
+    return this->realloc(this->context, memory, size, new_size);
+}
+
+/* Release memory previously allocated with the same allocator.
+ *
+ * this   - The allocator that owns the memory.
+ * memory - The memory to free, or null.
+ * size   - The size of the memory in bytes.
+ *
+ * Returns nothing.
+ */
+void allocator_free(const struct allocator *this, void *memory, size_t size) {
+    if (memory) {
+        this->free(this->context, memory, size);
+    }
+}
+
+/* Allocate memory for a new bump allocation arena. Allocations are carved
+ * sequentially out of large chunks and individual frees are ignored, except
+ * for the most recent allocation, which can be freed or grown in place. All
+ * memory is released at once with `arena_reset` or `arena_destroy`.
+ *
+ * Data structures allocated from the arena must not outlive it.
+ *
+ * chunk_size - The number of bytes to request from malloc at a time.
+ *
+ * Examples
+ *
+ *   struct arena *arena = arena_create(1 << 20);
+ *   struct vector *vector = vector_create_with_allocator(&arena->allocator);
+ *   vector_push(vector, item);
+ *   arena_destroy(arena);
+ *
+ * Returns the arena or null if memory allocation failed.
+ */
+struct arena *arena_create(size_t chunk_size) {
+    struct arena *this = calloc(1, sizeof(struct arena));
+    if (!this) {
+        return NULL;
+    }
+
+    this->allocator.alloc = arena_alloc;
+    this->allocator.realloc = arena_realloc;
+    this->allocator.free = arena_free;
+    this->allocator.context = this;
+    this->chunks = NULL;
+    this->last = NULL;
+    this->chunk_size = chunk_size;
+
+    return this;
+}
+
+/* Free the arena along with every allocation made from it.
+ *
+ * this - The arena to free.
+ *
+ * Returns nothing.
+ */
+void arena_destroy(struct arena *this) {
+    arena_reset(this);
+    free(this->chunks);
+    this->chunks = NULL;
+    free(this);
+}
+
+/* Release every allocation made from the arena. The newest chunk is kept for
+ * future allocations and the rest are returned to malloc.
+ *
+ * this - The arena to reset.
+ *
+ * Returns nothing.
+ */
+void arena_reset(struct arena *this) {
+    if (!this->chunks) {
+        return;
+    }
+
+    struct achunk *chunk = this->chunks->next;
+    while (chunk) {
+        struct achunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    this->chunks->next = NULL;
+    this->chunks->used = 0;
+    this->last = NULL;
+}
+
+/* Private: Allocate memory with malloc. This implements `alloc` for the
+ * default allocator.
+ */
+void *libc_alloc(void *context, size_t size) {
+    (void)context;
+    return malloc(size);
+}
+
+/* Private: Resize memory with realloc. This implements `realloc` for the
+ * default allocator.
+ */
+void *libc_realloc(void *context, void *memory, size_t size, size_t new_size) {
+    (void)context;
+    (void)size;
+    return realloc(memory, new_size);
+}
+
+/* Private: Release memory with free. This implements `free` for the default
+ * allocator.
+ */
+void libc_free(void *context, void *memory, size_t size) {
+    (void)context;
+    (void)size;
+    free(memory);
+}
+
+/* Private: Carve memory out of the arena's newest chunk, allocating a new
+ * chunk when it's full. This implements `alloc` for arena allocators.
+ *
+ * context - The arena.
+ * size    - The number of bytes to allocate.
+ *
+ * Returns the memory or null if allocation failed.
+ */
+void *arena_alloc(void *context, size_t size) {
+    struct arena *this = context;
+    struct achunk *chunk = this->chunks;
+
+    size_t offset = chunk ? arena_offset(chunk) : 0;
+    if (!chunk || offset > chunk->capacity ||
+        chunk->capacity - offset < size) {
+        if (size > SIZE_MAX - ARENA_ALIGNMENT - sizeof(struct achunk) ||
+            this->chunk_size > SIZE_MAX - sizeof(struct achunk)) {
+            return NULL;
+        }
+
+        size_t capacity = this->chunk_size;
+        if (capacity < size + ARENA_ALIGNMENT) {
+            capacity = size + ARENA_ALIGNMENT;
+        }
+
+        chunk = malloc(sizeof(struct achunk) + capacity);
+        if (!chunk) {
+            return NULL;
+        }
+
+        chunk->next = this->chunks;
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        this->chunks = chunk;
+        offset = arena_offset(chunk);
+    }
+
+    void *memory = chunk->data + offset;
+    chunk->used = offset + size;
+    this->last = memory;
+    return memory;
+}
+
+/* Private: Resize an arena allocation. The most recent allocation grows or
+ * shrinks in place when its chunk has room. Other allocations are copied to
+ * new memory. This implements `realloc` for arena allocators.
+ *
+ * context  - The arena.
+ * memory   - The memory to resize, or null.
+ * size     - The current size of the memory in bytes.
+ * new_size - The requested size in bytes.
+ *
+ * Returns the resized memory or null if allocation failed.
+ */
+void *arena_realloc(void *context, void *memory, size_t size,
+                    size_t new_size) {
+    struct arena *this = context;
+
+    if (memory && memory == this->last) {
+        struct achunk *chunk = this->chunks;
+        size_t offset = (size_t)((unsigned char *)memory - chunk->data);
+        if (chunk->capacity - offset >= new_size) {
+            chunk->used = offset + new_size;
+            return memory;
+        }
+    }
+
+    void *resized = arena_alloc(this, new_size);
+    if (resized && memory) {
+        memcpy(resized, memory, size < new_size ? size : new_size);
+    }
+    return resized;
+}
+
+/* Private: Release an arena allocation. Only the most recent allocation is
+ * reclaimed, and the rest stays reserved until the arena is reset. This
+ * implements `free` for arena allocators.
+ *
+ * context - The arena.
+ * memory  - The memory to free.
+ * size    - The size of the memory in bytes.
+ *
+ * Returns nothing.
+ */
+void arena_free(void *context, void *memory, size_t size) {
+    struct arena *this = context;
+    (void)size;
+
+    if (memory == this->last) {
+        struct achunk *chunk = this->chunks;
+        chunk->used = (size_t)((unsigned char *)memory - chunk->data);
+        this->last = NULL;
+    }
+}
+
+/* Private: Find the next aligned offset for an allocation in the chunk.
+ *
+ * chunk - The chunk to allocate from.
+ *
+ * Returns the offset from the start of the chunk's data.
+ */
+size_t arena_offset(struct achunk *chunk) {
+    uintptr_t address = (uintptr_t)(chunk->data + chunk->used);
+    uintptr_t aligned = (address + ARENA_ALIGNMENT - 1) &
+                        ~(uintptr_t)(ARENA_ALIGNMENT - 1);
+    return chunk->used + (size_t)(aligned - address);
+}
@@ -0,0 +1,40 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stdlib.h>
+
+struct allocator {
+    void *(*alloc)(void *context, size_t size);
+    void *(*realloc)(void *context, void *memory, size_t size,
+                     size_t new_size);
+    void (*free)(void *context, void *memory, size_t size);
+    void *context;
+};
+
+struct achunk;
+
+struct arena {
+    struct allocator allocator;
+    struct achunk *chunks;
+    void *last;
+    size_t chunk_size;
+};
+
+extern const struct allocator allocator_libc;
+
+void *allocator_alloc(const struct allocator *this, size_t size);
+
+void *allocator_calloc(const struct allocator *this, size_t count, size_t size);
+
+void *allocator_realloc(const struct allocator *this, void *memory, size_t size,
+                        size_t new_size);
+
+void allocator_free(const struct allocator *this, void *memory, size_t size);
+
+struct arena *arena_create(size_t chunk_size);
+
+void arena_destroy(struct arena *this);
+
+void arena_reset(struct arena *this);
+
+#endif
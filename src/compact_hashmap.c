@@ -0,0 +1,476 @@
+#include "compact_hashmap.h"
+#include <errno.h>
+#include <string.h>
+
+/* The fraction of index slots that may refer to entries, including removed
+ * entries that haven't been compacted away yet.
+ */
+#define MAX_LOAD_FACTOR .75
+
+/* The smallest number of index slots a map will have.
+ */
+#define MIN_CAPACITY 8
+
+/* The key length that marks a removed entry in the dense array.
+ */
+#define CENTRY_REMOVED SIZE_MAX
+
+static bool compact_hashmap_resize(struct compact_hashmap *this,
+                                   size_t capacity);
+static size_t compact_hashmap_find(struct compact_hashmap *this,
+                                   struct hkey *key, uint64_t hash);
+static size_t compact_hashmap_usable(size_t capacity);
+static void *compact_hashmap_next_entry(struct iterator *this);
+
+static size_t cindex_width(size_t capacity);
+static size_t cindex_get(struct compact_hashmap *this, size_t slot);
+static void cindex_set(struct compact_hashmap *this, size_t slot,
+                       size_t position);
+static void cindex_delete(struct compact_hashmap *this, size_t slot);
+
+/* Allocate and initialize memory for a new compact hashmap. Entries are
+ * stored by value in one dense array in insertion order, and looked up
+ * through a sparse array of small integer indexes into it, sized to the
+ * smallest of 8, 16, 32, or 64 bits that can address every entry.
+ * Compared with `struct hashmap`, entries need no per-entry allocation or
+ * list pointers, and iteration is a linear scan. Removed entries leave a
+ * hole in the dense array until the next resize compacts it. The map must
+ * be freed later with a call to `compact_hashmap_destroy`.
+ *
+ * Returns the map or null if allocation failed.
+ */
+struct compact_hashmap *compact_hashmap_create(void) {
+    return compact_hashmap_create_with_allocator(&allocator_libc);
+}
+
+/* Allocate and initialize memory for a new compact hashmap whose memory is
+ * provided by an allocator. The map must be freed later with a call to
+ * `compact_hashmap_destroy`.
+ *
+ * allocator - The allocator to use for all of the map's memory.
+ *
+ * Returns the map or null if allocation failed.
+ */
+struct compact_hashmap *
+compact_hashmap_create_with_allocator(const struct allocator *allocator) {
+    struct compact_hashmap *this =
+        allocator_alloc(allocator, sizeof(struct compact_hashmap));
+    if (!this) {
+        return NULL;
+    }
+
+    this->allocator = allocator;
+    this->entries = NULL;
+    this->indexes = NULL;
+    this->capacity = 0;
+    this->used = 0;
+    this->size = 0;
+
+    if (!compact_hashmap_resize(this, MIN_CAPACITY)) {
+        compact_hashmap_destroy(this);
+        return NULL;
+    }
+
+    return this;
+}
+
+/* Free the memory associated with this map. The values stored in the map
+ * are not freed. They must be freed by the caller.
+ *
+ * this - The map to free.
+ *
+ * Returns nothing.
+ */
+void compact_hashmap_destroy(struct compact_hashmap *this) {
+    compact_hashmap_clear(this);
+    allocator_free(this->allocator, this->entries,
+                   compact_hashmap_usable(this->capacity) *
+                       sizeof(struct centry));
+    allocator_free(this->allocator, this->indexes,
+                   this->capacity * cindex_width(this->capacity));
+    allocator_free(this->allocator, this, sizeof(struct compact_hashmap));
+}
+
+/* Retrieve the value stored at the key.
+ *
+ * this - The map from which to retrieve the value.
+ * key  - The key to look up in the map.
+ *
+ * Returns the value or null if not found.
+ */
+void *compact_hashmap_get(struct compact_hashmap *this, struct hkey *key) {
+    uint64_t hash = hkey_hash(key->data, key->length);
+    size_t slot = compact_hashmap_find(this, key, hash);
+    if (slot == this->capacity) {
+        return NULL;
+    }
+    return this->entries[cindex_get(this, slot) - 1].value;
+}
+
+/* Store the key/value pair in the map. New keys are appended to the end of
+ * the dense entry array.
+ *
+ * this  - The map in which to store the value.
+ * key   - The key to store, copied into the map.
+ * value - The value to store.
+ *
+ * Returns the previous value or null. The `errno` global is set to non-zero if
+ * the set failed, zero if the value was stored successfully.
+ */
+void *compact_hashmap_set(struct compact_hashmap *this, struct hkey *key,
+                          void *value) {
+    uint64_t hash = hkey_hash(key->data, key->length);
+    size_t slot = compact_hashmap_find(this, key, hash);
+
+    errno = 0;
+    if (slot < this->capacity) {
+        struct centry *entry = &this->entries[cindex_get(this, slot) - 1];
+        void *evicted = entry->value;
+        entry->value = value;
+        return evicted;
+    }
+
+    if (this->used == compact_hashmap_usable(this->capacity)) {
+        size_t capacity = this->capacity;
+        while (compact_hashmap_usable(capacity) < (this->size + 1) * 2) {
+            capacity *= 2;
+        }
+        if (!compact_hashmap_resize(this, capacity)) {
+            return NULL;
+        }
+    }
+
+    struct centry *entry = &this->entries[this->used];
+    if (key->length <= HKEY_INLINE_SIZE) {
+        entry->key.data = entry->buffer;
+    } else {
+        entry->key.data = allocator_alloc(this->allocator, key->length);
+        if (!entry->key.data) {
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    if (key->length) {
+        memcpy(entry->key.data, key->data, key->length);
+    }
+    entry->key.length = key->length;
+    entry->hash = hash;
+    entry->value = value;
+
+    size_t mask = this->capacity - 1;
+    slot = (size_t)hash & mask;
+    while (cindex_get(this, slot)) {
+        slot = (slot + 1) & mask;
+    }
+    cindex_set(this, slot, ++this->used);
+    this->size++;
+
+    return NULL;
+}
+
+/* Determine if the key is contained within the map.
+ *
+ * this - The map to query.
+ * key  - The key to find.
+ *
+ * Returns true if the key is stored in the map.
+ */
+bool compact_hashmap_contains(struct compact_hashmap *this, struct hkey *key) {
+    uint64_t hash = hkey_hash(key->data, key->length);
+    return compact_hashmap_find(this, key, hash) < this->capacity;
+}
+
+/* Remove the value stored under the key. The entry's slot in the dense array
+ * is left empty until the map is next resized. The value memory is not
+ * released by this function. The caller should free the value if needed.
+ *
+ * this - The map from which to remove the key/value pair.
+ * key  - The key whose value should be discarded.
+ *
+ * Returns the stored value or null if the key didn't exist.
+ */
+void *compact_hashmap_remove(struct compact_hashmap *this, struct hkey *key) {
+    uint64_t hash = hkey_hash(key->data, key->length);
+    size_t slot = compact_hashmap_find(this, key, hash);
+    if (slot == this->capacity) {
+        return NULL;
+    }
+
+    struct centry *entry = &this->entries[cindex_get(this, slot) - 1];
+    if (entry->key.length > HKEY_INLINE_SIZE) {
+        allocator_free(this->allocator, entry->key.data, entry->key.length);
+    }
+    entry->key.data = NULL;
+    entry->key.length = CENTRY_REMOVED;
+    cindex_delete(this, slot);
+    this->size--;
+
+    return entry->value;
+}
+
+/* Remove all key/value entries from the map. This does not free the memory
+ * associated with the values referenced in the map.
+ *
+ * this - The map to clear.
+ *
+ * Returns nothing.
+ */
+void compact_hashmap_clear(struct compact_hashmap *this) {
+    for (size_t i = 0; i < this->used; i++) {
+        struct centry *entry = &this->entries[i];
+        if (entry->key.length != CENTRY_REMOVED &&
+            entry->key.length > HKEY_INLINE_SIZE) {
+            allocator_free(this->allocator, entry->key.data,
+                           entry->key.length);
+        }
+    }
+
+    if (this->indexes) {
+        memset(this->indexes, 0,
+               this->capacity * cindex_width(this->capacity));
+    }
+    this->used = 0;
+    this->size = 0;
+}
+
+/* Create an iterator over the map's entries in insertion order. Each
+ * `current` value is a `struct centry`. The map must not be modified while
+ * the iterator is in use.
+ *
+ * this - The map to iterate over.
+ *
+ * Returns the iterator or null if allocation failed.
+ */
+struct iterator *compact_hashmap_iterator(struct compact_hashmap *this) {
+    return iterator_create_with_allocator(this, compact_hashmap_next_entry,
+                                          this->allocator);
+}
+
+/* Private: Advance the iterator to the next entry in the dense array,
+ * skipping the holes left by removed entries. Once the end is reached the
+ * iterator lets go of the map, so later calls keep returning null rather
+ * than starting over.
+ *
+ * this - The iterator to advance.
+ *
+ * Returns the next entry or null when the iteration is complete.
+ */
+void *compact_hashmap_next_entry(struct iterator *this) {
+    struct compact_hashmap *map = this->iterable;
+    struct centry *entry = this->current;
+    if (!map) {
+        return NULL;
+    }
+
+    size_t position = entry ? (size_t)(entry - map->entries) + 1 : 0;
+    while (position < map->used &&
+           map->entries[position].key.length == CENTRY_REMOVED) {
+        position++;
+    }
+
+    if (position < map->used) {
+        if (entry) {
+            this->index++;
+        }
+        this->current = &map->entries[position];
+    } else {
+        this->iterable = NULL;
+        this->current = NULL;
+    }
+
+    return this->current;
+}
+
+/* Private: Move the live entries into a new dense array in insertion order,
+ * dropping the holes left by removed entries, and rebuild the index.
+ *
+ * this     - The map to resize.
+ * capacity - The new number of index slots, a power of two.
+ *
+ * Returns true if the resize succeeded, false if memory allocation failed.
+ */
+bool compact_hashmap_resize(struct compact_hashmap *this, size_t capacity) {
+    size_t width = cindex_width(capacity);
+    void *indexes = allocator_calloc(this->allocator, capacity, width);
+    if (!indexes) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    size_t usable = compact_hashmap_usable(capacity);
+    struct centry *entries =
+        allocator_alloc(this->allocator, usable * sizeof(struct centry));
+    if (!entries) {
+        allocator_free(this->allocator, indexes, capacity * width);
+        errno = ENOMEM;
+        return false;
+    }
+
+    size_t used = 0;
+    for (size_t i = 0; i < this->used; i++) {
+        struct centry *entry = &this->entries[i];
+        if (entry->key.length == CENTRY_REMOVED) {
+            continue;
+        }
+
+        entries[used] = *entry;
+        if (entry->key.length <= HKEY_INLINE_SIZE) {
+            entries[used].key.data = entries[used].buffer;
+        }
+        used++;
+    }
+
+    allocator_free(this->allocator, this->entries,
+                   compact_hashmap_usable(this->capacity) *
+                       sizeof(struct centry));
+    allocator_free(this->allocator, this->indexes,
+                   this->capacity * cindex_width(this->capacity));
+
+    this->entries = entries;
+    this->indexes = indexes;
+    this->capacity = capacity;
+    this->used = used;
+
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < used; i++) {
+        size_t slot = (size_t)entries[i].hash & mask;
+        while (cindex_get(this, slot)) {
+            slot = (slot + 1) & mask;
+        }
+        cindex_set(this, slot, i + 1);
+    }
+
+    return true;
+}
+
+/* Private: Find the index slot referring to the key's entry. Slots are
+ * probed linearly from the hash's home slot until an empty one is reached.
+ *
+ * this - The map to search.
+ * key  - The key to find.
+ * hash - The key's hash.
+ *
+ * Returns the slot or the map's capacity if the key isn't stored.
+ */
+size_t compact_hashmap_find(struct compact_hashmap *this, struct hkey *key,
+                            uint64_t hash) {
+    size_t mask = this->capacity - 1;
+    size_t slot = (size_t)hash & mask;
+
+    for (;;) {
+        size_t position = cindex_get(this, slot);
+        if (!position) {
+            return this->capacity;
+        }
+
+        struct centry *entry = &this->entries[position - 1];
+        if (entry->hash == hash && entry->key.length == key->length &&
+            memcmp(entry->key.data, key->data, key->length) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+/* Private: Calculate the number of dense array entries that fit an index of
+ * a given size without exceeding the maximum load factor.
+ *
+ * capacity - The number of index slots.
+ *
+ * Returns the number of entries.
+ */
+size_t compact_hashmap_usable(size_t capacity) {
+    return (size_t)((double)capacity * MAX_LOAD_FACTOR);
+}
+
+/* Private: Choose the size of each index slot. Slots hold an entry's
+ * position plus one, leaving zero for empty slots.
+ *
+ * capacity - The number of index slots.
+ *
+ * Returns the slot width in bytes.
+ */
+size_t cindex_width(size_t capacity) {
+    if (capacity <= UINT8_MAX) {
+        return sizeof(uint8_t);
+    } else if (capacity <= UINT16_MAX) {
+        return sizeof(uint16_t);
+    } else if (capacity <= UINT32_MAX) {
+        return sizeof(uint32_t);
+    }
+    return sizeof(uint64_t);
+}
+
+/* Private: Read an index slot.
+ *
+ * this - The map whose index to read.
+ * slot - The slot to read.
+ *
+ * Returns the entry's position plus one, or zero if the slot is empty.
+ */
+size_t cindex_get(struct compact_hashmap *this, size_t slot) {
+    switch (cindex_width(this->capacity)) {
+    case sizeof(uint8_t):
+        return ((uint8_t *)this->indexes)[slot];
+    case sizeof(uint16_t):
+        return ((uint16_t *)this->indexes)[slot];
+    case sizeof(uint32_t):
+        return ((uint32_t *)this->indexes)[slot];
+    default:
+        return (size_t)((uint64_t *)this->indexes)[slot];
+    }
+}
+
+/* Private: Write an index slot.
+ *
+ * this     - The map whose index to write.
+ * slot     - The slot to write.
+ * position - The entry's position plus one, or zero to empty the slot.
+ *
+ * Returns nothing.
+ */
+void cindex_set(struct compact_hashmap *this, size_t slot, size_t position) {
+    switch (cindex_width(this->capacity)) {
+    case sizeof(uint8_t):
+        ((uint8_t *)this->indexes)[slot] = (uint8_t)position;
+        break;
+    case sizeof(uint16_t):
+        ((uint16_t *)this->indexes)[slot] = (uint16_t)position;
+        break;
+    case sizeof(uint32_t):
+        ((uint32_t *)this->indexes)[slot] = (uint32_t)position;
+        break;
+    default:
+        ((uint64_t *)this->indexes)[slot] = position;
+        break;
+    }
+}
+
+/* Private: Empty an index slot, shifting back later slots in the same probe
+ * run so lookups never need tombstones in the index.
+ *
+ * this - The map whose index to update.
+ * slot - The slot to empty.
+ *
+ * Returns nothing.
+ */
+void cindex_delete(struct compact_hashmap *this, size_t slot) {
+    size_t mask = this->capacity - 1;
+    size_t next = (slot + 1) & mask;
+
+    for (;;) {
+        size_t position = cindex_get(this, next);
+        if (!position) {
+            break;
+        }
+
+        size_t home = (size_t)this->entries[position - 1].hash & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            cindex_set(this, slot, position);
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    cindex_set(this, slot, 0);
+}
@@ -0,0 +1,45 @@
+#ifndef COMPACT_HASHMAP_H
+#define COMPACT_HASHMAP_H
+
+#include "hashmap.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+struct centry {
+    uint64_t hash;
+    struct hkey key;
+    void *value;
+    unsigned char buffer[HKEY_INLINE_SIZE];
+};
+
+struct compact_hashmap {
+    struct centry *entries;
+    void *indexes;
+    size_t capacity;
+    size_t used;
+    size_t size;
+    const struct allocator *allocator;
+};
+
+struct compact_hashmap *compact_hashmap_create(void);
+
+struct compact_hashmap *
+compact_hashmap_create_with_allocator(const struct allocator *allocator);
+
+void compact_hashmap_destroy(struct compact_hashmap *this);
+
+void *compact_hashmap_get(struct compact_hashmap *this, struct hkey *key);
+
+void *compact_hashmap_set(struct compact_hashmap *this, struct hkey *key,
+                          void *value);
+
+bool compact_hashmap_contains(struct compact_hashmap *this, struct hkey *key);
+
+void *compact_hashmap_remove(struct compact_hashmap *this, struct hkey *key);
+
+void compact_hashmap_clear(struct compact_hashmap *this);
+
+struct iterator *compact_hashmap_iterator(struct compact_hashmap *this);
+
+#endif
@@ -0,0 +1,343 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "concurrent_hashmap.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+
+/* The number of shards used when the caller asks for zero.
+ */
+#define DEFAULT_SHARDS 64
+
+/* Bytes of unused space after each shard's lock and map pointer, so two
+ * shards' hot fields never share a cache line however the array is aligned.
+ */
+#define CSHARD_PADDING 64
+
+struct cshard {
+    pthread_rwlock_t lock;
+    struct hashmap *map;
+    unsigned char padding[CSHARD_PADDING];
+};
+
+/* Marks keys inserted by a merge, as opposed to keys whose value it replaced.
+ */
+static char cinserted;
+
+static struct cshard *cshard_find(struct concurrent_hashmap *this,
+                                  uint64_t hash);
+static size_t cshard_count(size_t shards);
+
+/* Allocate and initialize memory for a new concurrent hashmap. The map's
+ * keys are spread by hash across a number of independent shards, each
+ * guarded by its own reader-writer lock, so threads working on different
+ * shards never wait on each other. The map must be freed later with a call
+ * to `concurrent_hashmap_destroy`.
+ *
+ * shards - The number of shards to create, rounded up to a power of two.
+ *          Zero selects a default suited to a few dozen threads.
+ *
+ * Returns the map or null if allocation failed.
+ */
+struct concurrent_hashmap *concurrent_hashmap_create(size_t shards) {
+    struct hashmap_options options = {0};
+    return concurrent_hashmap_create_with_options(&options, shards);
+}
+
+/* Allocate and initialize memory for a new concurrent hashmap whose shards
+ * are configured with non-default options. The map must be freed later with
+ * a call to `concurrent_hashmap_destroy`.
+ *
+ * options - The configuration for each shard, as for
+ *           `hashmap_create_with_options`. The `capacity` field is the
+ *           number of entries to make room for across the whole map. The
+ *           `allocator` field must be safe to call from several threads at
+ *           once. `HASHMAP_INCREMENTAL` is not supported because it makes
+ *           lookups modify the map.
+ * shards  - The number of shards to create, rounded up to a power of two.
+ *           Zero selects a default suited to a few dozen threads.
+ *
+ * Returns the map or null if allocation failed or the options conflict, in
+ * which case `errno` is set to `EINVAL`.
+ */
+struct concurrent_hashmap *
+concurrent_hashmap_create_with_options(struct hashmap_options *options,
+                                       size_t shards) {
+    if (options->flags & HASHMAP_INCREMENTAL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    const struct allocator *allocator =
+        options->allocator ? options->allocator : &allocator_libc;
+
+    struct concurrent_hashmap *this =
+        allocator_alloc(allocator, sizeof(struct concurrent_hashmap));
+    if (!this) {
+        return NULL;
+    }
+
+    this->allocator = allocator;
+    this->count = cshard_count(shards);
+    this->shards =
+        allocator_alloc(allocator, this->count * sizeof(struct cshard));
+    if (!this->shards) {
+        allocator_free(allocator, this, sizeof(struct concurrent_hashmap));
+        return NULL;
+    }
+
+    struct hashmap_options shard_options = *options;
+    shard_options.allocator = allocator;
+    shard_options.capacity =
+        (options->capacity + this->count - 1) / this->count;
+
+    for (size_t i = 0; i < this->count; i++) {
+        struct cshard *shard = &this->shards[i];
+        shard->map = hashmap_create_with_options(&shard_options);
+        if (i == 0 && shard->map) {
+            /* Every shard must hash keys like the first one. */
+            shard_options.seed[0] = shard->map->seed[0];
+            shard_options.seed[1] = shard->map->seed[1];
+        }
+
+        int error = shard->map ? pthread_rwlock_init(&shard->lock, NULL) : 0;
+        if (!shard->map || error) {
+            error = error ? error : errno;
+            if (shard->map) {
+                hashmap_destroy(shard->map);
+            }
+            while (i--) {
+                pthread_rwlock_destroy(&this->shards[i].lock);
+                hashmap_destroy(this->shards[i].map);
+            }
+            allocator_free(allocator, this->shards,
+                           this->count * sizeof(struct cshard));
+            allocator_free(allocator, this, sizeof(struct concurrent_hashmap));
+            errno = error;
+            return NULL;
+        }
+    }
+
+    return this;
+}
+
+/* Free the memory associated with this concurrent hashmap. No other thread
+ * may be using the map. The values stored in the map are not freed.
+ *
+ * this - The map to free.
+ *
+ * Returns nothing.
+ */
+void concurrent_hashmap_destroy(struct concurrent_hashmap *this) {
+    for (size_t i = 0; i < this->count; i++) {
+        pthread_rwlock_destroy(&this->shards[i].lock);
+        hashmap_destroy(this->shards[i].map);
+    }
+
+    allocator_free(this->allocator, this->shards,
+                   this->count * sizeof(struct cshard));
+    allocator_free(this->allocator, this, sizeof(struct concurrent_hashmap));
+}
+
+/* Retrieve the value stored at the key. Lookups in the same shard may run
+ * in parallel with each other but wait for writers.
+ *
+ * this - The map from which to retrieve the value.
+ * key  - The key to look up in the map.
+ *
+ * Returns the value or null if not found.
+ */
+void *concurrent_hashmap_get(struct concurrent_hashmap *this,
+                             struct hkey *key) {
+    uint64_t hash = hashmap_hash(this->shards[0].map, key);
+    struct cshard *shard = cshard_find(this, hash);
+    pthread_rwlock_rdlock(&shard->lock);
+    void *value = hashmap_get_hashed(shard->map, key, hash);
+    pthread_rwlock_unlock(&shard->lock);
+    return value;
+}
+
+/* Store the key/value pair in the map, as for `hashmap_set`.
+ *
+ * this  - The map in which to store the value.
+ * key   - The key to store, copied into the map.
+ * value - The value to store.
+ *
+ * Returns the previous value or null. The `errno` global is set to non-zero if
+ * the set failed, zero if the value was stored successfully.
+ */
+void *concurrent_hashmap_set(struct concurrent_hashmap *this, struct hkey *key,
+                             void *value) {
+    uint64_t hash = hashmap_hash(this->shards[0].map, key);
+    struct cshard *shard = cshard_find(this, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+    void *evicted = hashmap_set_hashed(shard->map, key, hash, value);
+    int error = errno;
+    pthread_rwlock_unlock(&shard->lock);
+    errno = error;
+    return evicted;
+}
+
+/* Determine if the key is contained within the map.
+ *
+ * this - The map to query.
+ * key  - The key to find.
+ *
+ * Returns true if the key is stored in the map.
+ */
+bool concurrent_hashmap_contains(struct concurrent_hashmap *this,
+                                 struct hkey *key) {
+    uint64_t hash = hashmap_hash(this->shards[0].map, key);
+    struct cshard *shard = cshard_find(this, hash);
+    pthread_rwlock_rdlock(&shard->lock);
+    bool found = hashmap_contains_hashed(shard->map, key, hash);
+    pthread_rwlock_unlock(&shard->lock);
+    return found;
+}
+
+/* Remove the value stored under the key. The value memory is not released by
+ * this function. The caller should free the value if needed.
+ *
+ * this - The map from which to remove the key/value pair.
+ * key  - The key whose value should be discarded.
+ *
+ * Returns the stored value or null if the key didn't exist.
+ */
+void *concurrent_hashmap_remove(struct concurrent_hashmap *this,
+                                struct hkey *key) {
+    uint64_t hash = hashmap_hash(this->shards[0].map, key);
+    struct cshard *shard = cshard_find(this, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+    void *value = hashmap_remove_hashed(shard->map, key, hash);
+    pthread_rwlock_unlock(&shard->lock);
+    return value;
+}
+
+/* Remove all key/value entries from the map, one shard at a time. Entries
+ * stored concurrently in shards that were already cleared are kept.
+ *
+ * this - The map to clear.
+ *
+ * Returns nothing.
+ */
+void concurrent_hashmap_clear(struct concurrent_hashmap *this) {
+    for (size_t i = 0; i < this->count; i++) {
+        struct cshard *shard = &this->shards[i];
+        pthread_rwlock_wrlock(&shard->lock);
+        hashmap_clear(shard->map);
+        pthread_rwlock_unlock(&shard->lock);
+    }
+}
+
+/* Count the entries in the map. Shards are counted one at a time, so the
+ * result may be stale if other threads are writing.
+ *
+ * this - The map to count.
+ *
+ * Returns the number of entries.
+ */
+size_t concurrent_hashmap_size(struct concurrent_hashmap *this) {
+    size_t size = 0;
+    for (size_t i = 0; i < this->count; i++) {
+        struct cshard *shard = &this->shards[i];
+        pthread_rwlock_rdlock(&shard->lock);
+        size += shard->map->size;
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return size;
+}
+
+/* Copy all key/value pairs from a hashmap into this map. Every shard is
+ * locked for the duration, so other threads see either none or all of the
+ * merged entries. A merge that fails is rolled back before the shards are
+ * unlocked. The other map must not be modified during the merge.
+ *
+ * this  - The map into which to store the entries.
+ * other - The hashmap from which to copy entries.
+ *
+ * Returns true if all entries were stored, false if memory allocation failed
+ * and the map was left unchanged.
+ */
+bool concurrent_hashmap_merge(struct concurrent_hashmap *this,
+                              struct hashmap *other) {
+    if (!other->size) {
+        return true;
+    }
+
+    /* The value each key held before the merge, or the sentinel for keys the
+     * merge inserted, so a failed merge can be undone without allocating.
+     */
+    void **previous =
+        allocator_alloc(this->allocator, other->size * sizeof(void *));
+    if (!previous) {
+        return false;
+    }
+
+    for (size_t i = 0; i < this->count; i++) {
+        pthread_rwlock_wrlock(&this->shards[i].lock);
+    }
+
+    size_t stored = 0;
+    struct hentry *entry = other->head;
+    while (entry) {
+        uint64_t hash = hashmap_hash(this->shards[0].map, &entry->key);
+        struct cshard *shard = cshard_find(this, hash);
+        bool inserted;
+        void **value = hashmap_entry(shard->map, &entry->key, &inserted);
+        if (!value) {
+            break;
+        }
+        previous[stored++] = inserted ? &cinserted : *value;
+        *value = entry->value;
+        entry = entry->next;
+    }
+
+    if (entry) {
+        entry = other->head;
+        for (size_t i = 0; i < stored; i++, entry = entry->next) {
+            uint64_t hash = hashmap_hash(this->shards[0].map, &entry->key);
+            struct cshard *shard = cshard_find(this, hash);
+            if (previous[i] == &cinserted) {
+                hashmap_remove_hashed(shard->map, &entry->key, hash);
+            } else {
+                hashmap_set_hashed(shard->map, &entry->key, hash, previous[i]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < this->count; i++) {
+        pthread_rwlock_unlock(&this->shards[i].lock);
+    }
+
+    allocator_free(this->allocator, previous, other->size * sizeof(void *));
+    return stored == other->size;
+}
+
+/* Find the shard responsible for a key. Shards are picked from the product
+ * of the hash and the golden ratio, whose high bits depend on every bit of
+ * the hash, so 32-bit hashes spread across shards too.
+ *
+ * this - The map containing the shard.
+ * hash - The key's hash, computed by the shards' hash function.
+ *
+ * Returns the key's shard.
+ */
+struct cshard *cshard_find(struct concurrent_hashmap *this, uint64_t hash) {
+    uint64_t mixed = hash * 0x9e3779b97f4a7c15;
+    return &this->shards[(size_t)(mixed >> 40) & (this->count - 1)];
+}
+
+/* Round a requested shard count up to a power of two.
+ *
+ * shards - The requested number of shards, or zero for the default.
+ *
+ * Returns the number of shards to create.
+ */
+size_t cshard_count(size_t shards) {
+    size_t count = 1;
+    shards = shards ? shards : DEFAULT_SHARDS;
+    while (count < shards) {
+        count <<= 1;
+    }
+    return count;
+}
@@ -0,0 +1,43 @@
+#ifndef CONCURRENT_HASHMAP_H
+#define CONCURRENT_HASHMAP_H
+
+#include "hashmap.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+struct cshard;
+
+struct concurrent_hashmap {
+    struct cshard *shards;
+    size_t count;
+    const struct allocator *allocator;
+};
+
+struct concurrent_hashmap *concurrent_hashmap_create(size_t shards);
+
+struct concurrent_hashmap *
+concurrent_hashmap_create_with_options(struct hashmap_options *options,
+                                       size_t shards);
+
+void concurrent_hashmap_destroy(struct concurrent_hashmap *this);
+
+void *concurrent_hashmap_get(struct concurrent_hashmap *this,
+                             struct hkey *key);
+
+void *concurrent_hashmap_set(struct concurrent_hashmap *this, struct hkey *key,
+                             void *value);
+
+bool concurrent_hashmap_contains(struct concurrent_hashmap *this,
+                                 struct hkey *key);
+
+void *concurrent_hashmap_remove(struct concurrent_hashmap *this,
+                                struct hkey *key);
+
+void concurrent_hashmap_clear(struct concurrent_hashmap *this);
+
+size_t concurrent_hashmap_size(struct concurrent_hashmap *this);
+
+bool concurrent_hashmap_merge(struct concurrent_hashmap *this,
+                              struct hashmap *other);
+
+#endif
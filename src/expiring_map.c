@@ -0,0 +1,645 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "expiring_map.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_LOAD_FACTOR .75
+
+/* The number of buckets in a new map.
+ */
+#define MIN_CAPACITY 16
+
+/* The number of expired entries each `expiring_map_set` call may reap, so
+ * maps that are never stepped explicitly still shed their expired entries.
+ */
+#define EXPIRE_STEP 4
+
+/* The deadline of entries that never expire, and the wheel slot of entries
+ * that aren't on the wheel.
+ */
+#define EENTRY_FOREVER UINT64_MAX
+#define EENTRY_UNTIMED SIZE_MAX
+
+struct eentry {
+    struct eentry *chain;
+    struct eentry *prev;
+    struct eentry *next;
+    uint64_t hash;
+    uint64_t deadline;
+    size_t slot;
+    void *value;
+    size_t length;
+    unsigned char key[];
+};
+
+static uint64_t expiring_map_clock(void *context);
+static struct eentry **expiring_map_find(struct expiring_map *this,
+                                         struct hkey *key, uint64_t hash);
+static struct eentry **expiring_map_lookup(struct expiring_map *this,
+                                           struct hkey *key);
+static struct eentry *expiring_map_unlink(struct expiring_map *this,
+                                          struct eentry **link);
+static void expiring_map_reap(struct expiring_map *this,
+                              struct eentry **link);
+static size_t expiring_map_advance(struct expiring_map *this, uint64_t now,
+                                   size_t max);
+static bool expiring_map_resize(struct expiring_map *this, size_t capacity);
+
+static void ewheel_insert(struct expiring_map *this, struct eentry *entry);
+static void ewheel_remove(struct expiring_map *this, struct eentry *entry);
+static uint64_t ewheel_next(struct expiring_map *this);
+static size_t ewheel_cascade(struct expiring_map *this, size_t slot,
+                             size_t max);
+static size_t ewheel_level(uint64_t bits);
+static size_t ewheel_first(uint64_t bits);
+
+static bool eentry_equals(struct eentry *entry, struct hkey *key,
+                          uint64_t hash);
+
+/* Allocate and initialize memory for a new map whose entries expire after a
+ * number of milliseconds. The map must be freed later with a call to
+ * `expiring_map_destroy`.
+ *
+ * Returns the map or null if allocation failed.
+ */
+struct expiring_map *expiring_map_create(void) {
+    struct expiring_map_options options = {0};
+    return expiring_map_create_with_options(&options);
+}
+
+/* Allocate and initialize memory for a new expiring map configured with
+ * non-default options. The map must be freed later with a call to
+ * `expiring_map_destroy`.
+ *
+ * Deadlines are kept on a hierarchical timer wheel of 64 slot levels, each
+ * slot of a level spanning a whole turn of the level below. Timing an entry
+ * links it into one slot in constant time, and an entry moves down at most
+ * once per level before it expires, so expiring entries costs amortized
+ * constant time instead of a heap's logarithmic time and extra allocation.
+ *
+ * options - The map configuration. The `clock` function returns the current
+ *           time in ticks, or is null for a monotonic clock in milliseconds.
+ *           The `expire` function is called with the `context` for each
+ *           reaped entry, so its value can be freed, and may be null. The
+ *           `allocator` field provides all of the map's memory, or is null
+ *           for the C library allocator.
+ *
+ * Returns the map or null if allocation failed.
+ */
+struct expiring_map *
+expiring_map_create_with_options(struct expiring_map_options *options) {
+    const struct allocator *allocator =
+        options->allocator ? options->allocator : &allocator_libc;
+
+    struct expiring_map *this =
+        allocator_alloc(allocator, sizeof(struct expiring_map));
+    if (!this) {
+        return NULL;
+    }
+
+    this->buckets =
+        allocator_calloc(allocator, MIN_CAPACITY, sizeof(struct eentry *));
+    if (!this->buckets) {
+        allocator_free(allocator, this, sizeof(struct expiring_map));
+        return NULL;
+    }
+
+    this->capacity = MIN_CAPACITY;
+    this->size = 0;
+    this->clock = options->clock ? options->clock : expiring_map_clock;
+    this->expire = options->expire;
+    this->context = options->context;
+    this->allocator = allocator;
+    this->tick = this->clock(this->context);
+    memset(this->occupied, 0, sizeof(this->occupied));
+    memset(this->wheel, 0, sizeof(this->wheel));
+
+    return this;
+}
+
+/* Free the memory associated with this map. Every remaining entry is passed
+ * to the expiration function first, as with `expiring_map_clear`.
+ *
+ * this - The map to free.
+ *
+ * Returns nothing.
+ */
+void expiring_map_destroy(struct expiring_map *this) {
+    expiring_map_clear(this);
+    allocator_free(this->allocator, this->buckets,
+                   this->capacity * sizeof(struct eentry *));
+    allocator_free(this->allocator, this, sizeof(struct expiring_map));
+}
+
+/* Retrieve the value stored at the key. An entry found past its deadline is
+ * reaped rather than returned.
+ *
+ * this - The map from which to retrieve the value.
+ * key  - The key to look up in the map.
+ *
+ * Returns the value or null if not found or expired.
+ */
+void *expiring_map_get(struct expiring_map *this, struct hkey *key) {
+    struct eentry **link = expiring_map_lookup(this, key);
+    return link ? (*link)->value : NULL;
+}
+
+/* Store the key/value pair in the map, replacing any previous value and
+ * deadline for the key. A few expired entries are reaped on each call.
+ *
+ * this  - The map in which to store the value.
+ * key   - The key to store, copied into the map.
+ * value - The value to store.
+ * ttl   - The number of clock ticks until the entry expires, or zero if it
+ *         never expires.
+ *
+ * Returns the previous value or null. The replaced value isn't passed to the
+ * expiration function and must be freed by the caller, as needed. The `errno`
+ * global is set to non-zero if the set failed, zero if the value was stored
+ * successfully.
+ */
+void *expiring_map_set(struct expiring_map *this, struct hkey *key,
+                       void *value, uint64_t ttl) {
+    uint64_t now = this->clock(this->context);
+    expiring_map_advance(this, now, EXPIRE_STEP);
+
+    uint64_t deadline = EENTRY_FOREVER;
+    if (ttl) {
+        deadline = ttl < EENTRY_FOREVER - now ? now + ttl : EENTRY_FOREVER - 1;
+    }
+
+    uint64_t hash = hkey_hash(key->data, key->length);
+    struct eentry **link = expiring_map_find(this, key, hash);
+    struct eentry *entry = *link;
+
+    errno = 0;
+    void *evicted = NULL;
+    if (entry) {
+        evicted = entry->value;
+        if (entry->deadline <= now) {
+            evicted = NULL;
+            if (this->expire) {
+                struct hkey expired = {entry->key, entry->length};
+                this->expire(&expired, entry->value, this->context);
+            }
+        }
+        ewheel_remove(this, entry);
+    } else {
+        size_t size = sizeof(struct eentry) + key->length;
+        entry = allocator_alloc(this->allocator, size);
+        if (!entry) {
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        entry->chain = NULL;
+        entry->hash = hash;
+        entry->length = key->length;
+        if (key->length) {
+            memcpy(entry->key, key->data, key->length);
+        }
+        *link = entry;
+        this->size++;
+    }
+
+    entry->value = value;
+    entry->deadline = deadline;
+    ewheel_insert(this, entry);
+
+    double load = (double)this->size / (double)this->capacity;
+    if (load > MAX_LOAD_FACTOR) {
+        expiring_map_resize(this, this->capacity * 2);
+    }
+
+    return evicted;
+}
+
+/* Determine if an unexpired entry for the key is stored in the map. An entry
+ * found past its deadline is reaped.
+ *
+ * this - The map to query.
+ * key  - The key to find.
+ *
+ * Returns true if the key is stored in the map.
+ */
+bool expiring_map_contains(struct expiring_map *this, struct hkey *key) {
+    return expiring_map_lookup(this, key) != NULL;
+}
+
+/* Remove the value stored under the key. The value isn't passed to the
+ * expiration function and must be freed by the caller, as needed.
+ *
+ * this - The map from which to remove the key/value pair.
+ * key  - The key whose value should be discarded.
+ *
+ * Returns the stored value or null if the key didn't exist or had expired.
+ */
+void *expiring_map_remove(struct expiring_map *this, struct hkey *key) {
+    struct eentry **link = expiring_map_lookup(this, key);
+    if (!link) {
+        return NULL;
+    }
+
+    struct eentry *entry = expiring_map_unlink(this, link);
+    void *value = entry->value;
+    allocator_free(this->allocator, entry,
+                   sizeof(struct eentry) + entry->length);
+    return value;
+}
+
+/* Remove every entry from the map, passing each one to the expiration
+ * function whether or not it has expired.
+ *
+ * this - The map to empty.
+ *
+ * Returns nothing.
+ */
+void expiring_map_clear(struct expiring_map *this) {
+    for (size_t i = 0; i < this->capacity; i++) {
+        struct eentry *entry = this->buckets[i];
+        while (entry) {
+            struct eentry *chain = entry->chain;
+            if (this->expire) {
+                struct hkey key = {entry->key, entry->length};
+                this->expire(&key, entry->value, this->context);
+            }
+            allocator_free(this->allocator, entry,
+                           sizeof(struct eentry) + entry->length);
+            entry = chain;
+        }
+        this->buckets[i] = NULL;
+    }
+
+    this->size = 0;
+    memset(this->occupied, 0, sizeof(this->occupied));
+    memset(this->wheel, 0, sizeof(this->wheel));
+}
+
+/* Reap expired entries by turning the timer wheel up to the current time,
+ * doing a bounded amount of work. Call this periodically, for example once
+ * per event loop iteration, so expired entries that are never looked up
+ * again are freed without ever stalling the caller.
+ *
+ * Idle stretches of the wheel are skipped in one step, so only slots that
+ * hold entries cost anything.
+ *
+ * this - The map to expire entries from.
+ * max  - The largest number of entries to reap or move down the wheel.
+ *
+ * Returns the number of entries reaped.
+ */
+size_t expiring_map_expire_step(struct expiring_map *this, size_t max) {
+    return expiring_map_advance(this, this->clock(this->context), max);
+}
+
+/* Private: Read the default clock, a monotonic count of milliseconds.
+ *
+ * context - Unused.
+ *
+ * Returns the current time in milliseconds.
+ */
+uint64_t expiring_map_clock(void *context) {
+    (void)context;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+/* Private: Find the link to a key's entry in its bucket chain.
+ *
+ * this - The map to search.
+ * key  - The key to find.
+ * hash - The key's hash value.
+ *
+ * Returns the link pointing at the entry, or at null if the key isn't in the
+ * map.
+ */
+struct eentry **expiring_map_find(struct expiring_map *this, struct hkey *key,
+                                  uint64_t hash) {
+    struct eentry **link = &this->buckets[hash & (this->capacity - 1)];
+    while (*link && !eentry_equals(*link, key, hash)) {
+        link = &(*link)->chain;
+    }
+    return link;
+}
+
+/* Private: Find the entry for a key, reaping it if its deadline has passed.
+ *
+ * this - The map to search.
+ * key  - The key to find.
+ *
+ * Returns the link pointing at the unexpired entry, or null.
+ */
+struct eentry **expiring_map_lookup(struct expiring_map *this,
+                                    struct hkey *key) {
+    uint64_t hash = hkey_hash(key->data, key->length);
+    struct eentry **link = expiring_map_find(this, key, hash);
+    struct eentry *entry = *link;
+    if (!entry) {
+        return NULL;
+    }
+
+    if (entry->deadline != EENTRY_FOREVER &&
+        entry->deadline <= this->clock(this->context)) {
+        expiring_map_reap(this, link);
+        return NULL;
+    }
+    return link;
+}
+
+/* Private: Remove an entry from its bucket chain and the timer wheel, without
+ * freeing it.
+ *
+ * this - The map holding the entry.
+ * link - The link pointing at the entry.
+ *
+ * Returns the entry.
+ */
+struct eentry *expiring_map_unlink(struct expiring_map *this,
+                                   struct eentry **link) {
+    struct eentry *entry = *link;
+    *link = entry->chain;
+    ewheel_remove(this, entry);
+    this->size--;
+    return entry;
+}
+
+/* Private: Remove an expired entry, pass it to the expiration function, and
+ * free it.
+ *
+ * this - The map holding the entry.
+ * link - The link pointing at the entry.
+ *
+ * Returns nothing.
+ */
+void expiring_map_reap(struct expiring_map *this, struct eentry **link) {
+    struct eentry *entry = expiring_map_unlink(this, link);
+    if (this->expire) {
+        struct hkey key = {entry->key, entry->length};
+        this->expire(&key, entry->value, this->context);
+    }
+    allocator_free(this->allocator, entry,
+                   sizeof(struct eentry) + entry->length);
+}
+
+/* Private: Turn the timer wheel toward a time, cascading entries from upper
+ * levels as their slots come due and reaping the entries in each due slot
+ * of the bottom level. Stops early, without losing its place, once the work
+ * budget is spent.
+ *
+ * this - The map to expire entries from.
+ * now  - The current time in ticks.
+ * max  - The largest number of entries to reap or move.
+ *
+ * Returns the number of entries reaped.
+ */
+size_t expiring_map_advance(struct expiring_map *this, uint64_t now,
+                            size_t max) {
+    size_t work = 0;
+    size_t reaped = 0;
+
+    while (work < max) {
+        uint64_t tick = ewheel_next(this);
+        if (tick > now) {
+            if (this->tick <= now) {
+                this->tick = now + 1;
+            }
+            break;
+        }
+        this->tick = tick;
+
+        for (size_t level = EWHEEL_LEVELS - 1; level > 0 && work < max;
+             level--) {
+            uint64_t turn = ((uint64_t)1 << (6 * level)) - 1;
+            if ((tick & turn) == 0) {
+                size_t index = (tick >> (6 * level)) & (EWHEEL_SLOTS - 1);
+                work += ewheel_cascade(this, level * EWHEEL_SLOTS + index,
+                                       max - work);
+            }
+        }
+
+        size_t slot = tick & (EWHEEL_SLOTS - 1);
+        while (this->wheel[slot] && work < max) {
+            struct eentry *entry = this->wheel[slot];
+            struct eentry **link = expiring_map_find(
+                this, &(struct hkey){entry->key, entry->length}, entry->hash);
+            expiring_map_reap(this, link);
+            work++;
+            reaped++;
+        }
+
+        if (!this->wheel[slot] && work < max) {
+            this->tick = tick + 1;
+        }
+    }
+
+    return reaped;
+}
+
+/* Private: Grow the bucket array, relinking every entry into its new bucket.
+ * Entries keep their place on the timer wheel.
+ *
+ * this     - The map to resize.
+ * capacity - The new number of buckets, a power of two.
+ *
+ * Returns false if memory allocation failed, true for success.
+ */
+bool expiring_map_resize(struct expiring_map *this, size_t capacity) {
+    struct eentry **buckets =
+        allocator_calloc(this->allocator, capacity, sizeof(struct eentry *));
+    if (!buckets) {
+        return false;
+    }
+
+    for (size_t i = 0; i < this->capacity; i++) {
+        struct eentry *entry = this->buckets[i];
+        while (entry) {
+            struct eentry *chain = entry->chain;
+            struct eentry **bucket = &buckets[entry->hash & (capacity - 1)];
+            entry->chain = *bucket;
+            *bucket = entry;
+            entry = chain;
+        }
+    }
+
+    allocator_free(this->allocator, this->buckets,
+                   this->capacity * sizeof(struct eentry *));
+    this->buckets = buckets;
+    this->capacity = capacity;
+
+    return true;
+}
+
+/* Private: Link an entry into the timer wheel slot for its deadline. The
+ * level is the highest 6-bit digit in which the deadline differs from the
+ * wheel's current tick, and the slot is the deadline's digit at that level,
+ * so the slot comes due exactly when the tick reaches that digit. Deadlines
+ * that have already passed are due at the current tick.
+ *
+ * this  - The map holding the entry.
+ * entry - The entry to time.
+ *
+ * Returns nothing.
+ */
+void ewheel_insert(struct expiring_map *this, struct eentry *entry) {
+    if (entry->deadline == EENTRY_FOREVER) {
+        entry->slot = EENTRY_UNTIMED;
+        return;
+    }
+
+    uint64_t due = entry->deadline > this->tick ? entry->deadline : this->tick;
+    size_t level = ewheel_level(due ^ this->tick);
+    size_t index = (due >> (6 * level)) & (EWHEEL_SLOTS - 1);
+    size_t slot = level * EWHEEL_SLOTS + index;
+
+    entry->slot = slot;
+    entry->prev = NULL;
+    entry->next = this->wheel[slot];
+    if (entry->next) {
+        entry->next->prev = entry;
+    }
+    this->wheel[slot] = entry;
+    this->occupied[level] |= (uint64_t)1 << index;
+}
+
+/* Private: Unlink an entry from its timer wheel slot, if it has one.
+ *
+ * this  - The map holding the entry.
+ * entry - The entry to unlink.
+ *
+ * Returns nothing.
+ */
+void ewheel_remove(struct expiring_map *this, struct eentry *entry) {
+    size_t slot = entry->slot;
+    if (slot == EENTRY_UNTIMED) {
+        return;
+    }
+
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        this->wheel[slot] = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    }
+
+    if (!this->wheel[slot]) {
+        this->occupied[slot / EWHEEL_SLOTS] &=
+            ~((uint64_t)1 << (slot % EWHEEL_SLOTS));
+    }
+    entry->slot = EENTRY_UNTIMED;
+}
+
+/* Private: Find the next tick at which the wheel has work to do, using each
+ * level's occupancy bits to skip empty slots. Each level's candidate is the
+ * start of its first occupied slot in the current turn of the level above,
+ * and the earliest candidate wins.
+ *
+ * this - The map whose wheel to search.
+ *
+ * Returns the tick, or `UINT64_MAX` if no entry is on the wheel.
+ */
+uint64_t ewheel_next(struct expiring_map *this) {
+    uint64_t tick = this->tick;
+    uint64_t next = UINT64_MAX;
+
+    for (size_t level = 0; level < EWHEEL_LEVELS; level++) {
+        size_t shift = 6 * level;
+        size_t index = (tick >> shift) & (EWHEEL_SLOTS - 1);
+
+        /* An upper slot at the current index is only due while the tick
+         * is at the start of its span, when a cascade may be unfinished.
+         */
+        uint64_t span = ((uint64_t)1 << shift) - 1;
+        uint64_t ahead = level && (tick & span) ? index + 1 : index;
+        uint64_t bits = ahead < EWHEEL_SLOTS
+                            ? this->occupied[level] & (UINT64_MAX << ahead)
+                            : 0;
+        if (bits) {
+            uint64_t turn = shift + 6 < 64 ? tick >> (shift + 6) << (shift + 6)
+                                           : 0;
+            uint64_t due = turn | (uint64_t)ewheel_first(bits) << shift;
+            next = due < next ? due : next;
+        }
+    }
+
+    return next;
+}
+
+/* Private: Move every entry in an upper wheel slot that has come due down to
+ * the slots for their deadlines relative to the current tick.
+ *
+ * this - The map whose wheel to turn.
+ * slot - The slot to empty.
+ * max  - The largest number of entries to move.
+ *
+ * Returns the number of entries moved. The slot stays occupied if it held
+ * more than `max` entries.
+ */
+size_t ewheel_cascade(struct expiring_map *this, size_t slot, size_t max) {
+    size_t moved = 0;
+    while (this->wheel[slot] && moved < max) {
+        struct eentry *entry = this->wheel[slot];
+        ewheel_remove(this, entry);
+        ewheel_insert(this, entry);
+        moved++;
+    }
+    return moved;
+}
+
+/* Private: Select the wheel level for the bits that differ between a deadline
+ * and the current tick.
+ *
+ * bits - The deadline xor the tick.
+ *
+ * Returns the index of the highest non-zero 6-bit digit, or zero.
+ */
+size_t ewheel_level(uint64_t bits) {
+    if (!bits) {
+        return 0;
+    }
+#if defined(__GNUC__)
+    return (size_t)(63 - __builtin_clzll(bits)) / 6;
+#else
+    size_t level = 0;
+    while (bits >>= 6) {
+        level++;
+    }
+    return level;
+#endif
+}
+
+/* Private: Find the lowest set bit in a level's occupancy bits.
+ *
+ * bits - The occupancy bits, which must not be zero.
+ *
+ * Returns the index of the first occupied slot.
+ */
+size_t ewheel_first(uint64_t bits) {
+#if defined(__GNUC__)
+    return (size_t)__builtin_ctzll(bits);
+#else
+    size_t index = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+/* Private: Compare an entry's key with a lookup key.
+ *
+ * entry - The entry to check.
+ * key   - The key to find.
+ * hash  - The lookup key's hash.
+ *
+ * Returns true if the keys match.
+ */
+bool eentry_equals(struct eentry *entry, struct hkey *key, uint64_t hash) {
+    return entry->hash == hash && entry->length == key->length &&
+           memcmp(entry->key, key->data, key->length) == 0;
+}
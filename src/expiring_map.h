@@ -0,0 +1,57 @@
+#ifndef EXPIRING_MAP_H
+#define EXPIRING_MAP_H
+
+#include "hashmap.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* The timer wheel has this many levels of 64 slots each, enough for every
+ * 64-bit deadline.
+ */
+#define EWHEEL_LEVELS 11
+#define EWHEEL_SLOTS 64
+
+struct eentry;
+
+struct expiring_map_options {
+    uint64_t (*clock)(void *context);
+    void (*expire)(struct hkey *key, void *value, void *context);
+    void *context;
+    const struct allocator *allocator;
+};
+
+struct expiring_map {
+    struct eentry **buckets;
+    size_t capacity;
+    size_t size;
+    uint64_t tick;
+    uint64_t (*clock)(void *context);
+    void (*expire)(struct hkey *key, void *value, void *context);
+    void *context;
+    const struct allocator *allocator;
+    uint64_t occupied[EWHEEL_LEVELS];
+    struct eentry *wheel[EWHEEL_LEVELS * EWHEEL_SLOTS];
+};
+
+struct expiring_map *expiring_map_create(void);
+
+struct expiring_map *
+expiring_map_create_with_options(struct expiring_map_options *options);
+
+void expiring_map_destroy(struct expiring_map *this);
+
+void *expiring_map_get(struct expiring_map *this, struct hkey *key);
+
+void *expiring_map_set(struct expiring_map *this, struct hkey *key,
+                       void *value, uint64_t ttl);
+
+bool expiring_map_contains(struct expiring_map *this, struct hkey *key);
+
+void *expiring_map_remove(struct expiring_map *this, struct hkey *key);
+
+void expiring_map_clear(struct expiring_map *this);
+
+size_t expiring_map_expire_step(struct expiring_map *this, size_t max);
+
+#endif
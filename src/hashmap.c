@@ -1,20 +1,136 @@
 #include "hashmap.h"
 #include <errno.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #define MAX_LOAD_FACTOR .75
 
+/* Maps created with the `HASHMAP_SHRINK` flag halve their buckets when the
+ * load factor drops below this after a remove.
+ */
+#define MIN_LOAD_FACTOR .125
+
+/* The smallest number of buckets a map will have.
+ */
+#define MIN_CAPACITY 16
+
+/* The number of buckets an incrementally rehashing map migrates on each
+ * operation. Up to ten times as many empty buckets may be skipped.
+ */
+#define REHASH_STEP 4
+
+/* Flags that change the hash value computed for a key. Maps must agree on
+ * these to share cached hashes.
+ */
+#define HASH_FLAGS (HASHMAP_FNV1A | HASHMAP_SEEDED | HASHMAP_SIPHASH)
+
+/* The smallest and largest slab allocations made by maps created with the
+ * `HASHMAP_SLAB` flag. Slabs double in size between the two.
+ */
+#define MIN_SLAB_SIZE 4096
+#define MAX_SLAB_SIZE (1 << 20)
+
+/* The number of size classes for long keys carved out of slabs. Class c holds
+ * keys of up to 2^c bytes, so one class per bit of `size_t` covers them all.
+ */
+#define KEY_CLASSES (sizeof(size_t) * 8)
+
+/* The number of keys `hashmap_get_many` and `hashmap_contains_many` look up
+ * together, overlapping the cache misses of one batch.
+ */
+#define FIND_BATCH 16
+
+#if defined(__GNUC__)
+#define HPREFETCH(address) __builtin_prefetch(address)
+#else
+#define HPREFETCH(address) ((void)(address))
+#endif
+
+/* Resize bookkeeping for `hashmap_stats`, which compiles to nothing unless
+ * the library is built with `-DHASHMAP_STATS`.
+ */
+#ifdef HASHMAP_STATS
+#define HSTATS_START(start) clock_t start = clock()
+#define HSTATS_RESIZE(this) ((this)->resizes++)
+#define HSTATS_TIME(this, start)                                               \
+    ((this)->resize_seconds += (double)(clock() - (start)) / CLOCKS_PER_SEC)
+#else
+#define HSTATS_START(start) ((void)0)
+#define HSTATS_RESIZE(this) ((void)0)
+#define HSTATS_TIME(this, start) ((void)0)
+#endif
+
+struct hslab {
+    struct hslab *next;
+    size_t used;
+    size_t capacity;
+    unsigned char data[];
+};
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 hkey_uint128;
+#endif
+
 static bool hashmap_resize(struct hashmap *this, size_t capacity);
+static size_t hashmap_buckets(size_t size);
+static size_t hashmap_index(uint64_t hash, size_t capacity);
+static void *hashmap_store(struct hashmap *this, struct hkey *key,
+                           uint64_t hashed, void *value);
+static void hashmap_find_batch(struct hashmap *this, struct hkey *keys,
+                               size_t count, struct hentry **found);
+static void hashmap_promote(struct hashmap *this, struct hentry *entry);
+static struct hentry *hashmap_upsert(struct hashmap *this, struct hkey *key,
+                                     uint64_t hashed, bool *inserted);
+static struct hentry *hashmap_find(struct hashmap *this, struct hkey *key,
+                                   uint64_t hashed);
 static void *hashmap_next_entry(struct iterator *this);
+static size_t hashmap_next_batch(struct iterator *this, void **out,
+                                 size_t max);
+
+static bool hashmap_rehash_start(struct hashmap *this, size_t capacity);
+static void hashmap_rehash_step(struct hashmap *this, size_t buckets);
+static void hashmap_rehash_finish(struct hashmap *this);
+
+static struct hentry *hchain_find(struct hentry *entry, struct hkey *key,
+                                  uint64_t hashed);
+static struct hentry *hchain_remove(struct hentry **bucket, struct hkey *key,
+                                    uint64_t hashed);
+
+static size_t hslot_find(struct hashmap *this, struct hkey *key,
+                         uint64_t hashed);
+static void hslot_insert(struct hslot *slots, size_t capacity, uint64_t hash,
+                         struct hentry *entry);
+static void hslot_delete(struct hashmap *this, size_t index);
+static size_t hslot_distance(uint64_t hash, size_t index, size_t capacity);
+
+static struct hentry *hentry_create(struct hashmap *map, struct hkey *key,
+                                    uint64_t hash, void *value);
+static void hentry_destroy(struct hashmap *map, struct hentry *entry);
+
+static void *hslab_alloc(struct hashmap *this, size_t size);
+static void hslab_release(struct hashmap *this);
+static size_t hslab_key_class(size_t length);
+static void *hslab_key_alloc(struct hashmap *this, size_t length);
+static void hslab_key_free(struct hashmap *this, void *data, size_t length);
+
+static bool hashmap_same_hash(struct hashmap *a, struct hashmap *b);
+#ifdef HASHMAP_STATS
+static void hstats_probe(struct hashmap_stats *stats, size_t probe);
+#endif
+static void hashmap_seed(struct hashmap *this, const uint64_t seed[2]);
 
-static struct hentry *hentry_create(struct hkey *key, void *value);
-static void hentry_destroy(struct hentry *entry);
-
-static struct hkey *hkey_create(const void *data, size_t length);
-static void hkey_destroy(struct hkey *key);
 static bool hkey_equals(struct hkey *a, struct hkey *b);
-static uint32_t hkey_hash(const void *data, size_t length);
+static uint64_t hkey_wyhash(const void *data, size_t length, uint64_t seed);
+static uint64_t hkey_siphash(const void *data, size_t length,
+                             const uint64_t seed[2]);
+static void hkey_sipround(uint64_t state[4]);
+static uint32_t hkey_fnv1a(const void *data, size_t length);
+static uint64_t hkey_read64(const unsigned char *bytes);
+static uint64_t hkey_read32(const unsigned char *bytes);
+static void hkey_multiply(uint64_t *a, uint64_t *b);
+static uint64_t hkey_mix(uint64_t a, uint64_t b);
 
 /* Allocate and initialize memory for a new hashmap. The map must be freed
  * later with a call to `hashmap_destroy`.
@@ -22,18 +138,75 @@ static uint32_t hkey_hash(const void *data, size_t length);
  * Returns the map or null if allocation failed.
  */
 struct hashmap *hashmap_create() {
-    struct hashmap *this = calloc(1, sizeof(struct hashmap));
+    struct hashmap_options options = {0};
+    return hashmap_create_with_options(&options);
+}
+
+/* Allocate and initialize memory for a new hashmap configured with non-default
+ * options. The map must be freed later with a call to `hashmap_destroy`.
+ *
+ * options - The map configuration. The `flags` field selects the storage
+ *           layout: zero for chained buckets or `HASHMAP_OPEN` for a flat
+ *           open addressing table. Both layouts iterate in insertion order.
+ *           Adding `HASHMAP_INCREMENTAL` spreads chained rehashing across
+ *           operations. The `capacity` field is the number of entries to
+ *           make room for up front. The `allocator` field provides all of
+ *           the map's memory, or is null for the C library allocator. The
+ *           `seed` field keys the `HASHMAP_SEEDED` and `HASHMAP_SIPHASH`
+ *           hashes, or is zero to pick a random seed for the map.
+ *
+ * Examples
+ *
+ *   struct hashmap_options options = {0};
+ *   options.flags = HASHMAP_OPEN;
+ *   struct hashmap *map = hashmap_create_with_options(&options);
+ *
+ * Returns the map or null if allocation failed or the options conflict, in
+ * which case `errno` is set to `EINVAL`. At most one hash function flag may
+ * be set.
+ */
+struct hashmap *hashmap_create_with_options(struct hashmap_options *options) {
+    if ((options->flags & HASHMAP_OPEN) &&
+        (options->flags & HASHMAP_INCREMENTAL)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    unsigned long hashes =
+        options->flags & (HASHMAP_FNV1A | HASHMAP_SEEDED | HASHMAP_SIPHASH);
+    if (hashes & (hashes - 1)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    const struct allocator *allocator =
+        options->allocator ? options->allocator : &allocator_libc;
+
+    struct hashmap *this = allocator_alloc(allocator, sizeof(struct hashmap));
     if (!this) {
         return NULL;
     }
 
+    this->allocator = allocator;
     this->entries = NULL;
+    this->slots = NULL;
     this->head = NULL;
     this->tail = NULL;
     this->capacity = 0;
     this->size = 0;
-
-    if (!hashmap_resize(this, 16)) {
+    this->old_entries = NULL;
+    this->old_capacity = 0;
+    this->rehash_index = 0;
+    this->slabs = NULL;
+    this->unused = NULL;
+    this->unused_keys = NULL;
+    this->flags = options->flags;
+    hashmap_seed(this, options->seed);
+    this->resizes = 0;
+    this->resize_seconds = 0;
+
+    size_t capacity = hashmap_buckets(options->capacity);
+    if (!capacity || !hashmap_resize(this, capacity)) {
         hashmap_destroy(this);
         return NULL;
     }
@@ -41,6 +214,35 @@ struct hashmap *hashmap_create() {
     return this;
 }
 
+/* Allocate and initialize memory for a new hashmap with room for a number of
+ * entries. Storing up to that many entries never triggers a rehash. The map
+ * must be freed later with a call to `hashmap_destroy`.
+ *
+ * capacity - The number of entries to make room for.
+ *
+ * Returns the map or null if allocation failed.
+ */
+struct hashmap *hashmap_create_with_capacity(size_t capacity) {
+    struct hashmap_options options = {0};
+    options.capacity = capacity;
+    return hashmap_create_with_options(&options);
+}
+
+/* Allocate and initialize memory for a new hashmap whose entries, keys,
+ * buckets, and iterators are provided by an allocator. The map must be freed
+ * later with a call to `hashmap_destroy`.
+ *
+ * allocator - The allocator to use for all of the map's memory.
+ *
+ * Returns the map or null if allocation failed.
+ */
+struct hashmap *
+hashmap_create_with_allocator(const struct allocator *allocator) {
+    struct hashmap_options options = {0};
+    options.allocator = allocator;
+    return hashmap_create_with_options(&options);
+}
+
 /* Free the memory associated with this hashmap. The values stored in the
  * map are not freed. They must be freed by the caller. See the examples
  * section for a method of cleaning all memory associated with the map.
@@ -61,10 +263,14 @@ struct hashmap *hashmap_create() {
  */
 void hashmap_destroy(struct hashmap *this) {
     hashmap_clear(this);
-    free(this->entries);
+    allocator_free(this->allocator, this->entries,
+                   this->capacity * sizeof(struct hentry *));
+    allocator_free(this->allocator, this->slots,
+                   this->capacity * sizeof(struct hslot));
     this->entries = NULL;
+    this->slots = NULL;
     this->capacity = 0;
-    free(this);
+    allocator_free(this->allocator, this, sizeof(struct hashmap));
 }
 
 /* Copy all key/value pairs into a new hashmap instance.
@@ -74,7 +280,12 @@ void hashmap_destroy(struct hashmap *this) {
  * Returns the cloned hashmap or null if memory allocation failed.
  */
 struct hashmap *hashmap_clone(struct hashmap *this) {
-    struct hashmap *clone = hashmap_create();
+    struct hashmap_options options = {0};
+    options.flags = this->flags;
+    options.allocator = this->allocator;
+    options.seed[0] = this->seed[0];
+    options.seed[1] = this->seed[1];
+    struct hashmap *clone = hashmap_create_with_options(&options);
     if (!clone) {
         return NULL;
     }
@@ -96,14 +307,30 @@ struct hashmap *hashmap_clone(struct hashmap *this) {
  * Returns nothing.
  */
 void hashmap_clear(struct hashmap *this) {
-    struct hentry *entry = this->head;
-    while (entry) {
-        struct hentry *next = entry->next;
-        hentry_destroy(entry);
-        entry = next;
+    if (this->flags & HASHMAP_SLAB) {
+        hslab_release(this);
+    } else {
+        struct hentry *entry = this->head;
+        while (entry) {
+            struct hentry *next = entry->next;
+            hentry_destroy(this, entry);
+            entry = next;
+        }
+    }
+
+    if (this->slots) {
+        memset(this->slots, 0, this->capacity * sizeof(struct hslot));
+    } else if (this->entries) {
+        memset(this->entries, 0, this->capacity * sizeof(struct hentry *));
     }
 
-    memset(this->entries, 0, this->capacity * sizeof(struct hentry *));
+    if (this->old_entries) {
+        allocator_free(this->allocator, this->old_entries,
+                       this->old_capacity * sizeof(struct hentry *));
+        this->old_entries = NULL;
+        this->old_capacity = 0;
+        this->rehash_index = 0;
+    }
 
     this->head = NULL;
     this->tail = NULL;
@@ -130,48 +357,64 @@ void hashmap_clear(struct hashmap *this) {
  * the set failed, zero if the value was stored successfully.
  */
 void *hashmap_set(struct hashmap *this, struct hkey *key, void *value) {
-    uint32_t hashed = hkey_hash(key->data, key->length);
-    size_t bucket = hashed % this->capacity;
-    struct hentry *entry = this->entries[bucket];
+    uint64_t hashed = hashmap_hash(this, key);
+    return hashmap_store(this, key, hashed, value);
+}
 
-    errno = 0;
-    while (entry) {
-        if (hkey_equals(entry->key, key)) {
-            void *evicted = entry->value;
-            entry->value = value;
-            return evicted;
-        }
-        entry = entry->chain;
+/* Find the value slot for a key, inserting the key with a null value if it
+ * isn't stored yet. The key is hashed and looked up once, so counting and
+ * other get-then-set patterns can update the value in place.
+ *
+ * this     - The hashmap to search.
+ * key      - The key to find or insert, copied into the map if inserted.
+ * inserted - Set to true if the key was inserted, false if it was already
+ *            stored. May be null.
+ *
+ * Examples
+ *
+ *    struct hkey key = {word, strlen(word)};
+ *    void **count = hashmap_entry(map, &key, NULL);
+ *    *count = (void *)((uintptr_t)*count + 1);
+ *
+ * Returns a pointer to the stored value, valid until the key is removed, or
+ * null if memory allocation failed.
+ */
+void **hashmap_entry(struct hashmap *this, struct hkey *key, bool *inserted) {
+    bool created;
+    uint64_t hashed = hashmap_hash(this, key);
+    struct hentry *entry = hashmap_upsert(this, key, hashed, &created);
+    if (inserted) {
+        *inserted = created;
     }
+    return entry ? &entry->value : NULL;
+}
 
-    entry = hentry_create(key, value);
+/* Replace the value stored at a key with the result of a function, hashing
+ * and looking up the key once. Keys that aren't stored yet are inserted, and
+ * the function receives a null value for them.
+ *
+ * this    - The hashmap to update.
+ * key     - The key to update, copied into the map if inserted.
+ * update  - The function called with the current value and the context,
+ *           returning the value to store.
+ * context - Passed through to the update function.
+ *
+ * Returns the newly stored value or null. The `errno` global is set to
+ * non-zero if memory allocation failed, zero if the value was stored
+ * successfully. The function isn't called if the key couldn't be inserted.
+ */
+void *hashmap_update(struct hashmap *this, struct hkey *key,
+                     void *(*update)(void *value, void *context),
+                     void *context) {
+    bool inserted;
+    uint64_t hashed = hashmap_hash(this, key);
+    struct hentry *entry = hashmap_upsert(this, key, hashed, &inserted);
     if (!entry) {
         return NULL;
     }
 
-    entry->chain = this->entries[bucket];
-    this->entries[bucket] = entry;
-
-    if (!this->head) {
-        this->head = entry;
-    }
-
-    if (this->tail) {
-        this->tail->next = entry;
-        entry->prev = this->tail;
-    }
-    this->tail = entry;
-
-    this->size++;
-
-    double load = (double)this->size / this->capacity;
-    if (load > MAX_LOAD_FACTOR) {
-        if (!hashmap_resize(this, this->capacity * 2)) {
-            return NULL;
-        }
-    }
-
-    return NULL;
+    entry->value = update(entry->value, context);
+    return entry->value;
 }
 
 /* Retrieve the value stored at the key.
@@ -191,18 +434,82 @@ void *hashmap_set(struct hashmap *this, struct hkey *key, void *value) {
  * Returns the value or null if not found.
  */
 void *hashmap_get(struct hashmap *this, struct hkey *key) {
-    uint32_t hashed = hkey_hash(key->data, key->length);
-    size_t bucket = hashed % this->capacity;
-    struct hentry *entry = this->entries[bucket];
+    return hashmap_get_hashed(this, key, hashmap_hash(this, key));
+}
 
-    while (entry) {
-        if (hkey_equals(entry->key, key)) {
-            return entry->value;
-        }
-        entry = entry->chain;
+/* Retrieve the value stored at a key and move its entry to the end of the
+ * map's insertion order, so that iterating from `head` visits the least
+ * recently touched entries first. This is the promotion step of an LRU
+ * cache and takes constant time.
+ *
+ * this - The hashmap to search.
+ * key  - The key to look up in the map.
+ *
+ * Returns a pointer to the stored value, valid until the key is removed, or
+ * null if the key isn't in the map.
+ */
+void **hashmap_touch(struct hashmap *this, struct hkey *key) {
+    struct hentry *entry = hashmap_find(this, key, hashmap_hash(this, key));
+    if (!entry) {
+        return NULL;
     }
 
-    return NULL;
+    hashmap_promote(this, entry);
+    return &entry->value;
+}
+
+/* Find the value slot for a key as `hashmap_entry` does, and move the key's
+ * entry to the end of the map's insertion order as `hashmap_touch` does. The
+ * key is hashed and looked up once, so a cache can store a value and mark it
+ * most recently used in a single probe.
+ *
+ * this     - The hashmap to search.
+ * key      - The key to find or insert, copied into the map if inserted.
+ * inserted - Set to true if the key was inserted, false if it was already
+ *            stored. May be null.
+ *
+ * Returns a pointer to the stored value, valid until the key is removed, or
+ * null if memory allocation failed.
+ */
+void **hashmap_touch_entry(struct hashmap *this, struct hkey *key,
+                           bool *inserted) {
+    bool created;
+    uint64_t hashed = hashmap_hash(this, key);
+    struct hentry *entry = hashmap_upsert(this, key, hashed, &created);
+    if (inserted) {
+        *inserted = created;
+    }
+    if (!entry) {
+        return NULL;
+    }
+
+    hashmap_promote(this, entry);
+    return &entry->value;
+}
+
+/* Private: Move an entry to the end of the map's insertion order.
+ *
+ * this  - The hashmap that owns the entry.
+ * entry - The entry to move.
+ *
+ * Returns nothing.
+ */
+void hashmap_promote(struct hashmap *this, struct hentry *entry) {
+    if (entry == this->tail) {
+        return;
+    }
+
+    if (entry == this->head) {
+        this->head = entry->next;
+    } else {
+        entry->prev->next = entry->next;
+    }
+    entry->next->prev = entry->prev;
+
+    entry->prev = this->tail;
+    entry->next = NULL;
+    this->tail->next = entry;
+    this->tail = entry;
 }
 
 /* Determine if the key is contained within the hashmap. Useful for cases
@@ -214,18 +521,70 @@ void *hashmap_get(struct hashmap *this, struct hkey *key) {
  * Returns true if the key is stored in the map.
  */
 bool hashmap_contains(struct hashmap *this, struct hkey *key) {
-    uint32_t hashed = hkey_hash(key->data, key->length);
-    size_t bucket = hashed % this->capacity;
-    struct hentry *entry = this->entries[bucket];
+    return hashmap_contains_hashed(this, key, hashmap_hash(this, key));
+}
 
-    while (entry) {
-        if (hkey_equals(entry->key, key)) {
-            return true;
+/* Retrieve the values stored at many keys at once. The keys are hashed
+ * first, then their buckets and entries are prefetched in turn before any
+ * are compared, so the cache misses of a batch overlap rather than each
+ * lookup waiting on its own. This is much faster than calling `hashmap_get`
+ * in a loop when the map is larger than the processor's cache.
+ *
+ * this   - The hashmap from which to retrieve the values.
+ * keys   - The keys to look up in the map.
+ * count  - The number of keys.
+ * values - The array receiving each key's value, or null if not found.
+ *
+ * Examples
+ *
+ *    struct hkey keys[2] = {{&a, sizeof(a)}, {&b, sizeof(b)}};
+ *    void *values[2];
+ *    hashmap_get_many(map, keys, 2, values);
+ *
+ * Returns the number of keys found.
+ */
+size_t hashmap_get_many(struct hashmap *this, struct hkey *keys, size_t count,
+                        void **values) {
+    struct hentry *found[FIND_BATCH];
+    size_t hits = 0;
+
+    for (size_t i = 0; i < count; i += FIND_BATCH) {
+        size_t batch = count - i < FIND_BATCH ? count - i : FIND_BATCH;
+        hashmap_find_batch(this, &keys[i], batch, found);
+        for (size_t j = 0; j < batch; j++) {
+            values[i + j] = found[j] ? found[j]->value : NULL;
+            hits += found[j] != NULL;
+        }
+    }
+
+    return hits;
+}
+
+/* Determine which of many keys are contained within the hashmap, with the
+ * same batched prefetching as `hashmap_get_many`.
+ *
+ * this     - The hashmap to query.
+ * keys     - The keys to find.
+ * count    - The number of keys.
+ * contains - The array receiving whether each key is stored in the map.
+ *
+ * Returns the number of keys found.
+ */
+size_t hashmap_contains_many(struct hashmap *this, struct hkey *keys,
+                             size_t count, bool *contains) {
+    struct hentry *found[FIND_BATCH];
+    size_t hits = 0;
+
+    for (size_t i = 0; i < count; i += FIND_BATCH) {
+        size_t batch = count - i < FIND_BATCH ? count - i : FIND_BATCH;
+        hashmap_find_batch(this, &keys[i], batch, found);
+        for (size_t j = 0; j < batch; j++) {
+            contains[i + j] = found[j] != NULL;
+            hits += found[j] != NULL;
         }
-        entry = entry->chain;
     }
 
-    return false;
+    return hits;
 }
 
 /* Remove the value stored under the key. The value memory is not released by
@@ -237,49 +596,183 @@ bool hashmap_contains(struct hashmap *this, struct hkey *key) {
  * Returns the stored value or null if the key didn't exist.
  */
 void *hashmap_remove(struct hashmap *this, struct hkey *key) {
-    uint32_t hashed = hkey_hash(key->data, key->length);
-    size_t bucket = hashed % this->capacity;
-    struct hentry *entry = this->entries[bucket];
-    struct hentry *previous = NULL;
+    return hashmap_remove_hashed(this, key, hashmap_hash(this, key));
+}
 
-    while (entry) {
-        if (hkey_equals(entry->key, key)) {
-            if (previous) {
-                previous->chain = entry->chain;
-            }
+/* Compute the hash of a key as this map would. Pass the result to the
+ * `_hashed` functions to look up the same key repeatedly, or in several maps,
+ * without hashing its bytes each time. Maps created with the same hash flags
+ * and seed compute the same value for a key.
+ *
+ * this - The hashmap whose hash function to use.
+ * key  - The key to hash.
+ *
+ * Examples
+ *
+ *    uint64_t hash = hashmap_hash(l1, &key);
+ *    void *value = hashmap_get_hashed(l1, &key, hash);
+ *    if (!value) {
+ *        value = hashmap_get_hashed(l2, &key, hash);
+ *    }
+ *
+ * Returns the key's hash value.
+ */
+uint64_t hashmap_hash(struct hashmap *this, struct hkey *key) {
+    if (this->flags & HASHMAP_FNV1A) {
+        return hkey_fnv1a(key->data, key->length);
+    } else if (this->flags & HASHMAP_SEEDED) {
+        return hkey_wyhash(key->data, key->length, this->seed[0]);
+    } else if (this->flags & HASHMAP_SIPHASH) {
+        return hkey_siphash(key->data, key->length, this->seed);
+    }
+    return hkey_hash(key->data, key->length);
+}
 
-            if (entry == this->entries[bucket]) {
-                this->entries[bucket] = entry->chain;
-            }
+/* Retrieve the value stored at a key whose hash was computed with
+ * `hashmap_hash`.
+ *
+ * this - The hashmap from which to retrieve the value.
+ * key  - The key to look up in the map.
+ * hash - The key's hash value for this map.
+ *
+ * Returns the value or null if not found.
+ */
+void *hashmap_get_hashed(struct hashmap *this, struct hkey *key,
+                         uint64_t hash) {
+    struct hentry *entry = hashmap_find(this, key, hash);
+    return entry ? entry->value : NULL;
+}
 
-            if (entry == this->head) {
-                this->head = entry->next;
-            }
+/* Store a key/value pair whose key hash was computed with `hashmap_hash`.
+ *
+ * this  - The hashmap in which to store the value.
+ * key   - The key to store, copied into the map.
+ * hash  - The key's hash value for this map.
+ * value - The value to store.
+ *
+ * Returns the previous value or null, setting `errno` as `hashmap_set` does.
+ */
+void *hashmap_set_hashed(struct hashmap *this, struct hkey *key, uint64_t hash,
+                         void *value) {
+    return hashmap_store(this, key, hash, value);
+}
 
-            if (entry == this->tail) {
-                this->tail = entry->prev;
-            }
+/* Determine if a key whose hash was computed with `hashmap_hash` is
+ * contained within the hashmap.
+ *
+ * this - The hashmap to query.
+ * key  - The key to find.
+ * hash - The key's hash value for this map.
+ *
+ * Returns true if the key is stored in the map.
+ */
+bool hashmap_contains_hashed(struct hashmap *this, struct hkey *key,
+                             uint64_t hash) {
+    return hashmap_find(this, key, hash) != NULL;
+}
 
-            if (entry->prev) {
-                entry->prev->next = entry->next;
-            }
+/* Remove the value stored under a key whose hash was computed with
+ * `hashmap_hash`. The value memory is not released by this function.
+ *
+ * this - The hashmap from which to remove the key/value pair.
+ * key  - The key whose value should be discarded.
+ * hash - The key's hash value for this map.
+ *
+ * Returns the stored value or null if the key didn't exist.
+ */
+void *hashmap_remove_hashed(struct hashmap *this, struct hkey *key,
+                            uint64_t hash) {
+    struct hentry *entry = NULL;
 
-            if (entry->next) {
-                entry->next->prev = entry->prev;
-            }
+    if (this->slots) {
+        size_t index = hslot_find(this, key, hash);
+        if (index == this->capacity) {
+            return NULL;
+        }
+        entry = this->slots[index].entry;
+        hslot_delete(this, index);
+    } else {
+        if (this->old_entries) {
+            hashmap_rehash_step(this, REHASH_STEP);
+        }
 
-            this->size--;
+        size_t bucket = hashmap_index(hash, this->capacity);
+        entry = hchain_remove(&this->entries[bucket], key, hash);
+        if (!entry && this->old_entries) {
+            bucket = hashmap_index(hash, this->old_capacity);
+            entry = hchain_remove(&this->old_entries[bucket], key, hash);
+        }
 
-            void *evicted = entry->value;
-            hentry_destroy(entry);
-            return evicted;
+        if (!entry) {
+            return NULL;
         }
+    }
 
-        previous = entry;
-        entry = entry->chain;
+    if (entry == this->head) {
+        this->head = entry->next;
     }
 
-    return NULL;
+    if (entry == this->tail) {
+        this->tail = entry->prev;
+    }
+
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    }
+
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    }
+
+    this->size--;
+
+    void *evicted = entry->value;
+    hentry_destroy(this, entry);
+
+    if ((this->flags & HASHMAP_SHRINK) && this->capacity > MIN_CAPACITY) {
+        double load = (double)this->size / (double)this->capacity;
+        if (load < MIN_LOAD_FACTOR) {
+            hashmap_resize(this, this->capacity / 2);
+        }
+    }
+
+    return evicted;
+}
+
+/* Make room for a number of entries so that storing them never triggers a
+ * rehash. Use before bulk loading a known number of keys.
+ *
+ * this - The hashmap to grow.
+ * size - The total number of entries the map should hold.
+ *
+ * Returns false if memory allocation failed, true for success.
+ */
+bool hashmap_reserve(struct hashmap *this, size_t size) {
+    size_t capacity = hashmap_buckets(size);
+    if (!capacity) {
+        return false;
+    }
+    if (capacity <= this->capacity) {
+        return true;
+    }
+    return hashmap_resize(this, capacity);
+}
+
+/* Release unused bucket memory, shrinking the table to the smallest capacity
+ * that holds the current entries below the maximum load factor. Useful after
+ * removing many keys from a long-lived map.
+ *
+ * this - The hashmap to shrink.
+ *
+ * Returns false if memory allocation failed, true for success. The map is
+ * unchanged when allocation fails.
+ */
+bool hashmap_shrink_to_fit(struct hashmap *this) {
+    size_t capacity = hashmap_buckets(this->size);
+    if (capacity >= this->capacity) {
+        return true;
+    }
+    return hashmap_resize(this, capacity);
 }
 
 /* Combine two hashmaps into one. If a key exists in both maps, the `other`
@@ -292,16 +785,18 @@ void *hashmap_remove(struct hashmap *this, struct hkey *key) {
  * Returns true if the merge succeeded, false if memory allocation failed.
  */
 bool hashmap_merge(struct hashmap *this, struct hashmap *other) {
-    size_t total = this->size + other->size;
-    if (this->capacity < total) {
-        if (!hashmap_resize(this, total)) {
-            return false;
-        }
+    if (!hashmap_reserve(this, this->size + other->size)) {
+        return false;
     }
 
     struct hentry *entry = other->head;
     while (entry) {
-        if (!hashmap_set(this, entry->key, entry->value) && errno) {
+        uint64_t hashed = entry->hash;
+        if (!hashmap_same_hash(this, other)) {
+            hashed = hashmap_hash(this, &entry->key);
+        }
+
+        if (!hashmap_store(this, &entry->key, hashed, entry->value) && errno) {
             return false;
         }
         entry = entry->next;
@@ -321,15 +816,94 @@ bool hashmap_merge(struct hashmap *this, struct hashmap *other) {
  *   struct iterator *entries = hashmap_iterator(map);
  *   while (entries->next(entries)) {
  *       struct hentry *entry = entries->current;
- *       printf("%s => %x\n", entry->key, entry->value);
+ *       printf("%s => %x\n", entry->key.data, entry->value);
  *   }
  *   entries->destroy(entries);
  *
  * Returns an iterator over the map's entries or null if allocation failed.
  */
 struct iterator *hashmap_iterator(struct hashmap *this) {
-    return iterator_create(this->head, hashmap_next_entry);
+    struct iterator *entries = iterator_create_with_allocator(
+        this->head, hashmap_next_entry, this->allocator);
+    if (entries) {
+        entries->next_batch = hashmap_next_batch;
+    }
+    return entries;
+}
+
+#ifdef HASHMAP_STATS
+/* Describe the shape of the map's table, for tuning capacity and spotting a
+ * poorly distributed hash. Only available when the library is built with
+ * `-DHASHMAP_STATS`; otherwise the resize counters stay zero.
+ *
+ * An entry's probe length is the number of keys compared to find it: its
+ * position in its bucket's chain, or one more than its distance from its
+ * home slot in maps created with `HASHMAP_OPEN`. The longest probe of a
+ * chained map is its longest chain.
+ *
+ * this  - The hashmap to measure.
+ * stats - Filled with the map's size, capacity, load factor, longest and mean
+ *         probe length, a histogram of entries by probe length, the number
+ *         of resizes and processor time spent in them, and the total bytes
+ *         of the stored keys.
+ *
+ * Returns nothing.
+ */
+void hashmap_stats(struct hashmap *this, struct hashmap_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->size = this->size;
+    stats->capacity = this->capacity;
+    stats->load = (double)this->size / (double)this->capacity;
+    stats->resizes = this->resizes;
+    stats->resize_seconds = this->resize_seconds;
+
+    if (this->flags & HASHMAP_OPEN) {
+        for (size_t i = 0; i < this->capacity; i++) {
+            struct hslot *slot = &this->slots[i];
+            if (slot->entry) {
+                hstats_probe(stats,
+                             hslot_distance(slot->hash, i, this->capacity) + 1);
+            }
+        }
+    } else {
+        struct hentry **tables[] = {this->entries, this->old_entries};
+        size_t capacities[] = {this->capacity, this->old_capacity};
+        for (size_t t = 0; t < 2; t++) {
+            for (size_t i = 0; i < capacities[t]; i++) {
+                size_t probe = 0;
+                for (struct hentry *entry = tables[t][i]; entry;
+                     entry = entry->chain) {
+                    hstats_probe(stats, ++probe);
+                }
+            }
+        }
+    }
+    if (this->size) {
+        stats->mean_probe /= (double)this->size;
+    }
+
+    for (struct hentry *entry = this->head; entry; entry = entry->next) {
+        stats->key_bytes += entry->key.length;
+    }
+}
+
+/* Private: Count one entry's probe length in the map's statistics. The mean
+ * is accumulated as a sum until every entry has been counted.
+ *
+ * stats - The statistics being gathered.
+ * probe - The number of keys compared to find the entry.
+ *
+ * Returns nothing.
+ */
+void hstats_probe(struct hashmap_stats *stats, size_t probe) {
+    size_t bin = probe < HASHMAP_PROBE_BINS ? probe : HASHMAP_PROBE_BINS;
+    stats->probes[bin - 1]++;
+    stats->mean_probe += (double)probe;
+    if (probe > stats->max_probe) {
+        stats->max_probe = probe;
+    }
 }
+#endif
 
 /* Private: Advance the iterator to the next entry in the map. This is the
  * implementation of the iter->next() function pointer for hashmaps.
@@ -358,31 +932,277 @@ void *hashmap_next_entry(struct iterator *this) {
     return this->current;
 }
 
-/* Private: Allocate additional memory to accomodate a hash table with more
- * buckets and a reduced load factor.
- *
- * This is triggered when the current load factor reaches above 75%. That is,
- * when the number of entries consumes most of the available buckets, it's
- * time to rehash to avoid excessive chaining within each bucket.
+/* Private: Copy the next run of entries in insertion order. This is the
+ * implementation of the iter->next_batch() function pointer for hashmaps.
  *
- * The existing entries are rehashed into the new buckets, and the previous
- * bucket memory is released.
- *
- * this     - The hashmap to rehash.
- * capacity - The new number of buckets.
+ * this - The iterator to advance.
+ * out  - The buffer to fill with entries.
+ * max  - The maximum number of entries to copy.
  *
- * Returns false if memory allocation failed, true for success.
+ * Returns the number of entries copied, or zero when the end is reached.
  */
-bool hashmap_resize(struct hashmap *this, size_t capacity) {
-    struct hentry **entries = calloc(capacity, sizeof(struct hentry *));
+size_t hashmap_next_batch(struct iterator *this, void **out, size_t max) {
+    struct hentry *entry = this->iterable;
+
+    bool first = !this->current && this->index == 0;
+
+    size_t count = 0;
+    while (count < max && entry) {
+        out[count++] = entry;
+        entry = entry->next;
+    }
+
+    this->iterable = entry;
+    if (count > 0) {
+        this->index += first ? count - 1 : count;
+    }
+    this->current = count == max && count > 0 ? out[count - 1] : NULL;
+
+    return count;
+}
+
+/* Private: Store a key and value pair under a precomputed hash. This is the
+ * implementation of `hashmap_set`, shared with merging, which reuses the
+ * hashes already cached in the source map's entries.
+ *
+ * this   - The hashmap in which to store the value.
+ * key    - The unique key to which to map the value.
+ * hashed - The key's hash value.
+ * value  - The value to be looked up by its key.
+ *
+ * Returns the previous value or null, setting `errno` as `hashmap_set` does.
+ */
+void *hashmap_store(struct hashmap *this, struct hkey *key, uint64_t hashed,
+                    void *value) {
+    bool inserted;
+    struct hentry *entry = hashmap_upsert(this, key, hashed, &inserted);
+    if (!entry) {
+        return NULL;
+    }
+
+    void *evicted = inserted ? NULL : entry->value;
+    entry->value = value;
+    return evicted;
+}
+
+/* Private: Find the entry for a key, inserting an entry with a null value if
+ * the key isn't stored yet. The key is hashed and probed only once either
+ * way. Entries never move once created, so the result stays valid until the
+ * key is removed.
+ *
+ * this     - The hashmap to search.
+ * key      - The key to find or insert.
+ * hashed   - The key's hash value.
+ * inserted - Set to true if a new entry was created.
+ *
+ * Returns the entry or null if memory allocation failed. The `errno` global is
+ * set to non-zero if an allocation failed, zero otherwise. Open maps fail when
+ * they need to grow and can't, but chained maps store the key anyway.
+ */
+struct hentry *hashmap_upsert(struct hashmap *this, struct hkey *key,
+                              uint64_t hashed, bool *inserted) {
+    struct hentry *entry = hashmap_find(this, key, hashed);
+
+    errno = 0;
+    *inserted = false;
+    if (entry) {
+        return entry;
+    }
+
+    /* Open tables grow before inserting, since probing needs an empty slot
+     * and a full table has none.
+     */
+    if (this->slots) {
+        double load = (double)(this->size + 1) / (double)this->capacity;
+        if (load > MAX_LOAD_FACTOR &&
+            !hashmap_resize(this, this->capacity * 2)) {
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    entry = hentry_create(this, key, hashed, NULL);
+    if (!entry) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    *inserted = true;
+
+    if (this->slots) {
+        hslot_insert(this->slots, this->capacity, hashed, entry);
+    } else {
+        size_t bucket = hashmap_index(hashed, this->capacity);
+        entry->chain = this->entries[bucket];
+        this->entries[bucket] = entry;
+    }
+
+    if (!this->head) {
+        this->head = entry;
+    }
+
+    if (this->tail) {
+        this->tail->next = entry;
+        entry->prev = this->tail;
+    }
+    this->tail = entry;
+
+    this->size++;
+
+    /* A chained table that can't grow keeps the entry in a longer chain and
+     * tries again on the next insert, so the store still succeeds.
+     */
+    double load = (double)this->size / (double)this->capacity;
+    if (!this->slots && load > MAX_LOAD_FACTOR) {
+        bool grown = this->flags & HASHMAP_INCREMENTAL
+                         ? hashmap_rehash_start(this, this->capacity * 2)
+                         : hashmap_resize(this, this->capacity * 2);
+        if (!grown) {
+            errno = 0;
+        }
+    }
+
+    return entry;
+}
+
+/* Private: Find the entries for a batch of keys in three passes. The first
+ * hashes every key and prefetches its bucket, the second prefetches the
+ * first entry in each bucket, and the third compares keys, by which time
+ * most of the memory it touches is already on its way into the cache.
+ * Maps in the middle of an incremental rehash look up each key in turn.
+ *
+ * this  - The hashmap to search.
+ * keys  - The keys to find.
+ * count - The number of keys, at most `FIND_BATCH`.
+ * found - The array receiving each key's entry, or null if not found.
+ *
+ * Returns nothing.
+ */
+void hashmap_find_batch(struct hashmap *this, struct hkey *keys, size_t count,
+                        struct hentry **found) {
+    uint64_t hashes[FIND_BATCH];
+    size_t indexes[FIND_BATCH];
+
+    for (size_t i = 0; i < count; i++) {
+        hashes[i] = hashmap_hash(this, &keys[i]);
+        indexes[i] = hashmap_index(hashes[i], this->capacity);
+        if (this->slots) {
+            HPREFETCH(&this->slots[indexes[i]]);
+        } else {
+            HPREFETCH(&this->entries[indexes[i]]);
+        }
+    }
+
+    if (this->old_entries) {
+        for (size_t i = 0; i < count; i++) {
+            found[i] = hashmap_find(this, &keys[i], hashes[i]);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (this->slots) {
+            found[i] = this->slots[indexes[i]].entry;
+        } else {
+            found[i] = this->entries[indexes[i]];
+        }
+        if (found[i]) {
+            HPREFETCH(found[i]);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (this->slots) {
+            size_t index = hslot_find(this, &keys[i], hashes[i]);
+            found[i] = index < this->capacity ? this->slots[index].entry : NULL;
+        } else {
+            found[i] = hchain_find(found[i], &keys[i], hashes[i]);
+        }
+    }
+}
+
+/* Private: Find the entry stored under the key in either storage layout.
+ *
+ * this   - The hashmap to search.
+ * key    - The key to look up.
+ * hashed - The key's hash value.
+ *
+ * Returns the entry or null if the key isn't in the map.
+ */
+struct hentry *hashmap_find(struct hashmap *this, struct hkey *key,
+                            uint64_t hashed) {
+    if (this->slots) {
+        size_t index = hslot_find(this, key, hashed);
+        return index < this->capacity ? this->slots[index].entry : NULL;
+    }
+
+    if (this->old_entries) {
+        hashmap_rehash_step(this, REHASH_STEP);
+    }
+
+    size_t bucket = hashmap_index(hashed, this->capacity);
+    struct hentry *entry = hchain_find(this->entries[bucket], key, hashed);
+    if (!entry && this->old_entries) {
+        bucket = hashmap_index(hashed, this->old_capacity);
+        entry = hchain_find(this->old_entries[bucket], key, hashed);
+    }
+
+    return entry;
+}
+
+/* Private: Allocate additional memory to accomodate a hash table with more
+ * buckets and a reduced load factor.
+ *
+ * This is triggered when the current load factor reaches above 75%. That is,
+ * when the number of entries consumes most of the available buckets, it's
+ * time to rehash to avoid excessive chaining within each bucket. The table
+ * also shrinks through this function, when reserving less memory.
+ *
+ * The existing entries are moved into the new buckets, and the previous
+ * bucket memory is released. Each entry caches its key's hash, so the keys
+ * are never rehashed.
+ *
+ * this     - The hashmap to rehash.
+ * capacity - The new number of buckets.
+ *
+ * Returns false if memory allocation failed, true for success.
+ */
+bool hashmap_resize(struct hashmap *this, size_t capacity) {
+    HSTATS_START(started);
+    if (this->flags & HASHMAP_OPEN) {
+        struct hslot *slots =
+            allocator_calloc(this->allocator, capacity, sizeof(struct hslot));
+        if (!slots) {
+            return false;
+        }
+
+        for (size_t i = 0; i < this->capacity; i++) {
+            struct hslot *slot = &this->slots[i];
+            if (slot->entry) {
+                hslot_insert(slots, capacity, slot->hash, slot->entry);
+            }
+        }
+
+        if (this->capacity) {
+            HSTATS_RESIZE(this);
+        }
+        allocator_free(this->allocator, this->slots,
+                       this->capacity * sizeof(struct hslot));
+        this->slots = slots;
+        this->capacity = capacity;
+
+        HSTATS_TIME(this, started);
+        return true;
+    }
+
+    struct hentry **entries =
+        allocator_calloc(this->allocator, capacity, sizeof(struct hentry *));
     if (!entries) {
         return false;
     }
 
     struct hentry *entry = this->head;
     while (entry) {
-        uint32_t hashed = hkey_hash(entry->key->data, entry->key->length);
-        size_t bucket = hashed % capacity;
+        size_t bucket = hashmap_index(entry->hash, capacity);
 
         struct hentry *start = entries[bucket];
         entries[bucket] = entry;
@@ -391,33 +1211,366 @@ bool hashmap_resize(struct hashmap *this, size_t capacity) {
         entry = entry->next;
     }
 
-    free(this->entries);
+    if (this->capacity) {
+        HSTATS_RESIZE(this);
+    }
+    allocator_free(this->allocator, this->entries,
+                   this->capacity * sizeof(struct hentry *));
+    this->entries = entries;
+    this->capacity = capacity;
+
+    if (this->old_entries) {
+        allocator_free(this->allocator, this->old_entries,
+                       this->old_capacity * sizeof(struct hentry *));
+        this->old_entries = NULL;
+        this->old_capacity = 0;
+        this->rehash_index = 0;
+    }
+
+    HSTATS_TIME(this, started);
+    return true;
+}
+
+/* Private: Calculate the number of buckets needed to hold entries without
+ * exceeding the maximum load factor. Tables always have a power of two
+ * buckets, so keys are placed with a mask rather than a division.
+ *
+ * size - The number of entries.
+ *
+ * Returns the bucket count, or zero if no power of two `size_t` is large
+ * enough.
+ */
+size_t hashmap_buckets(size_t size) {
+    if (size > SIZE_MAX / 4 * 3) {
+        return 0;
+    }
+    size_t needed = size / 3 * 4 + (size % 3 * 4 + 2) / 3;
+    if (needed > SIZE_MAX / 2 + 1) {
+        return 0;
+    }
+    size_t capacity = MIN_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/* Private: Select the bucket for a hash value. The hash is multiplied by the
+ * 64-bit golden ratio and its high half folded into the low half, so that
+ * every hash bit affects the bucket even when the hash function is weak in
+ * its low bits. The result is masked to the power of two capacity.
+ *
+ * hash     - The key's hash value.
+ * capacity - The number of buckets, which must be a power of two.
+ *
+ * Returns the bucket index.
+ */
+size_t hashmap_index(uint64_t hash, size_t capacity) {
+    uint64_t mixed = hash * 0x9e3779b97f4a7c15;
+    return (size_t)(mixed ^ (mixed >> 32)) & (capacity - 1);
+}
+
+/* Private: Begin moving entries into a larger bucket array, one small step at
+ * a time, rather than rehashing the whole table at once. This is the resize
+ * strategy for maps created with the `HASHMAP_INCREMENTAL` flag.
+ *
+ * The current buckets become the old table and new entries are added to the
+ * new table. Each following lookup, insert, or remove migrates a few old
+ * buckets, and searches check both tables until migration completes. If a
+ * previous migration is still in progress, it's finished first.
+ *
+ * this     - The hashmap to rehash.
+ * capacity - The new number of buckets.
+ *
+ * Returns false if memory allocation failed, true for success.
+ */
+bool hashmap_rehash_start(struct hashmap *this, size_t capacity) {
+    hashmap_rehash_finish(this);
+
+    struct hentry **entries =
+        allocator_calloc(this->allocator, capacity, sizeof(struct hentry *));
+    if (!entries) {
+        return false;
+    }
+
+    this->old_entries = this->entries;
+    this->old_capacity = this->capacity;
+    this->rehash_index = 0;
     this->entries = entries;
     this->capacity = capacity;
+    HSTATS_RESIZE(this);
 
     return true;
 }
 
+/* Private: Move a bounded number of old buckets into the new bucket array.
+ * The old array is freed once it's empty.
+ *
+ * this    - The hashmap being rehashed.
+ * buckets - The number of non-empty buckets to migrate.
+ *
+ * Returns nothing.
+ */
+void hashmap_rehash_step(struct hashmap *this, size_t buckets) {
+    HSTATS_START(started);
+    size_t visits = buckets * 10;
+
+    while (buckets > 0 && visits > 0 &&
+           this->rehash_index < this->old_capacity) {
+        struct hentry *entry = this->old_entries[this->rehash_index];
+        this->old_entries[this->rehash_index] = NULL;
+        this->rehash_index++;
+        visits--;
+
+        if (!entry) {
+            continue;
+        }
+
+        while (entry) {
+            struct hentry *next = entry->chain;
+            size_t bucket = hashmap_index(entry->hash, this->capacity);
+            entry->chain = this->entries[bucket];
+            this->entries[bucket] = entry;
+            entry = next;
+        }
+        buckets--;
+    }
+
+    if (this->rehash_index == this->old_capacity) {
+        allocator_free(this->allocator, this->old_entries,
+                       this->old_capacity * sizeof(struct hentry *));
+        this->old_entries = NULL;
+        this->old_capacity = 0;
+        this->rehash_index = 0;
+    }
+    HSTATS_TIME(this, started);
+}
+
+/* Private: Migrate every remaining old bucket, completing an incremental
+ * rehash.
+ *
+ * this - The hashmap being rehashed.
+ *
+ * Returns nothing.
+ */
+void hashmap_rehash_finish(struct hashmap *this) {
+    if (this->old_entries) {
+        hashmap_rehash_step(this, this->old_capacity);
+    }
+}
+
+/* Private: Find the entry for a key in one bucket's chain.
+ *
+ * entry  - The first entry in the chain.
+ * key    - The key to look up.
+ * hashed - The key's hash value.
+ *
+ * Returns the entry or null if the key isn't in the chain.
+ */
+struct hentry *hchain_find(struct hentry *entry, struct hkey *key,
+                           uint64_t hashed) {
+    while (entry) {
+        if (entry->hash == hashed && hkey_equals(&entry->key, key)) {
+            return entry;
+        }
+        entry = entry->chain;
+    }
+
+    return NULL;
+}
+
+/* Private: Unlink the entry for a key from one bucket's chain.
+ *
+ * bucket - The bucket holding the chain.
+ * key    - The key to remove.
+ * hashed - The key's hash value.
+ *
+ * Returns the unlinked entry or null if the key isn't in the chain.
+ */
+struct hentry *hchain_remove(struct hentry **bucket, struct hkey *key,
+                             uint64_t hashed) {
+    struct hentry *previous = NULL;
+    struct hentry *entry = *bucket;
+
+    while (entry && (entry->hash != hashed || !hkey_equals(&entry->key, key))) {
+        previous = entry;
+        entry = entry->chain;
+    }
+
+    if (!entry) {
+        return NULL;
+    }
+
+    if (previous) {
+        previous->chain = entry->chain;
+    } else {
+        *bucket = entry->chain;
+    }
+
+    return entry;
+}
+
+/* Private: Probe the open addressing table for the slot holding the key.
+ *
+ * Probing starts at the key's home slot and walks forward. Because robin hood
+ * insertion keeps slots ordered by their distance from home, the search stops
+ * early at an empty slot or at a slot closer to its own home than the key
+ * would be at this position.
+ *
+ * this   - The hashmap to search.
+ * key    - The key to look up.
+ * hashed - The key's hash value.
+ *
+ * Returns the slot index or the map's capacity if the key isn't found.
+ */
+size_t hslot_find(struct hashmap *this, struct hkey *key, uint64_t hashed) {
+    size_t index = hashmap_index(hashed, this->capacity);
+
+    for (size_t distance = 0; distance < this->capacity; distance++) {
+        struct hslot *slot = &this->slots[index];
+        if (!slot->entry) {
+            break;
+        }
+
+        if (hslot_distance(slot->hash, index, this->capacity) < distance) {
+            break;
+        }
+
+        if (slot->hash == hashed && hkey_equals(&slot->entry->key, key)) {
+            return index;
+        }
+
+        if (++index == this->capacity) {
+            index = 0;
+        }
+    }
+
+    return this->capacity;
+}
+
+/* Private: Store an entry in the open addressing table with robin hood
+ * displacement. An entry that has probed further from its home slot than
+ * a resident takes over that slot, and the resident continues probing.
+ * This bounds the variance of probe lengths at high load.
+ *
+ * The table must have at least one empty slot.
+ *
+ * slots    - The table in which to store the entry.
+ * capacity - The number of slots in the table.
+ * hash     - The entry key's hash value.
+ * entry    - The entry to store.
+ *
+ * Returns nothing.
+ */
+void hslot_insert(struct hslot *slots, size_t capacity, uint64_t hash,
+                  struct hentry *entry) {
+    struct hslot inserted = {hash, entry};
+    size_t index = hashmap_index(hash, capacity);
+    size_t distance = 0;
+
+    while (slots[index].entry) {
+        size_t resident = hslot_distance(slots[index].hash, index, capacity);
+        if (resident < distance) {
+            struct hslot temp = slots[index];
+            slots[index] = inserted;
+            inserted = temp;
+            distance = resident;
+        }
+
+        if (++index == capacity) {
+            index = 0;
+        }
+        distance++;
+    }
+
+    slots[index] = inserted;
+}
+
+/* Private: Clear a slot in the open addressing table. Following slots are
+ * shifted back one position until an empty slot or an entry already in its
+ * home slot is reached, so no tombstones are needed.
+ *
+ * this  - The hashmap from which to remove the slot.
+ * index - The slot to clear.
+ *
+ * Returns nothing.
+ */
+void hslot_delete(struct hashmap *this, size_t index) {
+    size_t next = index + 1 == this->capacity ? 0 : index + 1;
+
+    while (this->slots[next].entry &&
+           hslot_distance(this->slots[next].hash, next, this->capacity) > 0) {
+        this->slots[index] = this->slots[next];
+        index = next;
+        next = index + 1 == this->capacity ? 0 : index + 1;
+    }
+
+    this->slots[index].hash = 0;
+    this->slots[index].entry = NULL;
+}
+
+/* Private: Calculate how far a slot is from its key's home slot.
+ *
+ * hash     - The hash value of the key stored in the slot.
+ * index    - The slot's position in the table.
+ * capacity - The number of slots in the table.
+ *
+ * Returns the number of probes past the home slot.
+ */
+size_t hslot_distance(uint64_t hash, size_t index, size_t capacity) {
+    size_t home = hashmap_index(hash, capacity);
+    return index >= home ? index - home : index + capacity - home;
+}
+
 /* Private: Allocate memory for a new key/value entry pair. The entry must be
  * freed with hentry_destroy.
  *
+ * Keys up to `HKEY_INLINE_SIZE` bytes are copied into the entry itself, so
+ * the common case of short keys costs a single allocation. Longer keys are
+ * copied into their own allocation.
+ *
+ * Maps created with the `HASHMAP_SLAB` flag reuse entries from their free
+ * list, then carve new entries and long keys out of their slabs.
+ *
+ * map   - The hashmap that will own the entry.
  * key   - The key to use to lookup the value in the map.
+ * hash  - The key's hash value, cached for resizing and comparisons.
  * value - The value to store in the map.
  *
  * Returns the entry or null if allocation failed.
  */
-struct hentry *hentry_create(struct hkey *key, void *value) {
-    struct hentry *this = calloc(1, sizeof(struct hentry));
-    if (!this) {
-        return NULL;
+struct hentry *hentry_create(struct hashmap *map, struct hkey *key,
+                             uint64_t hash, void *value) {
+    bool slab = map->flags & HASHMAP_SLAB;
+    struct hentry *this = NULL;
+
+    if (slab && map->unused) {
+        this = map->unused;
+        map->unused = this->next;
+    } else {
+        this = slab ? hslab_alloc(map, sizeof(struct hentry))
+                    : allocator_alloc(map->allocator, sizeof(struct hentry));
+        if (!this) {
+            return NULL;
+        }
     }
 
-    this->key = hkey_create(key->data, key->length);
-    if (!this->key) {
-        hentry_destroy(this);
-        return NULL;
+    if (key->length <= HKEY_INLINE_SIZE) {
+        this->key.data = this->buffer;
+    } else {
+        this->key.data =
+            slab ? hslab_key_alloc(map, key->length)
+                 : allocator_alloc(map->allocator, key->length);
+        if (!this->key.data) {
+            this->key.data = this->buffer;
+            hentry_destroy(map, this);
+            return NULL;
+        }
     }
 
+    memcpy(this->key.data, key->data, key->length);
+    this->key.length = key->length;
+    this->hash = hash;
     this->value = value;
     this->chain = NULL;
     this->prev = NULL;
@@ -430,56 +1583,205 @@ struct hentry *hentry_create(struct hkey *key, void *value) {
  * with the entry, but the value stored in the entry is not. The caller must
  * free the entry value.
  *
+ * Entries and long keys owned by a slab are pushed onto the map's free lists
+ * instead.
+ *
+ * map   - The hashmap that owns the entry.
  * entry - The hash entry to free.
  *
  * Returns nothing.
  */
-void hentry_destroy(struct hentry *this) {
-    hkey_destroy(this->key);
-    this->key = NULL;
-    this->value = NULL;
-    this->chain = NULL;
-    this->prev = NULL;
-    this->next = NULL;
-    free(this);
+void hentry_destroy(struct hashmap *map, struct hentry *this) {
+    if (map->flags & HASHMAP_SLAB) {
+        if (this->key.data != this->buffer) {
+            hslab_key_free(map, this->key.data, this->key.length);
+        }
+        this->key.data = this->buffer;
+        this->next = map->unused;
+        map->unused = this;
+        return;
+    }
+
+    if (this->key.data != this->buffer) {
+        allocator_free(map->allocator, this->key.data, this->key.length);
+    }
+    allocator_free(map->allocator, this, sizeof(struct hentry));
 }
 
-/* Private: Allocate memory for a hash key. The key must be freed with
- * hkey_destroy.
+/* Private: Carve memory out of the map's newest slab, allocating a larger
+ * slab when it's full. The memory is released all at once by hslab_release.
  *
- * data   - The bytes to hash.
- * length - The number of bytes in data.
+ * this - The hashmap that owns the slabs.
+ * size - The number of bytes to allocate.
  *
- * Returns the key or null if allocation failed.
+ * Returns the memory or null if allocation failed.
  */
-struct hkey *hkey_create(const void *data, size_t length) {
-    struct hkey *this = calloc(1, sizeof(struct hkey));
-    if (!this) {
-        return NULL;
+void *hslab_alloc(struct hashmap *this, size_t size) {
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    struct hslab *slab = this->slabs;
+    if (!slab || slab->capacity - slab->used < size) {
+        size_t capacity = slab ? slab->capacity * 2 : MIN_SLAB_SIZE;
+        if (capacity > MAX_SLAB_SIZE) {
+            capacity = MAX_SLAB_SIZE;
+        }
+        if (capacity < size) {
+            capacity = size;
+        }
+
+        slab =
+            allocator_alloc(this->allocator, sizeof(struct hslab) + capacity);
+        if (!slab) {
+            return NULL;
+        }
+
+        slab->next = this->slabs;
+        slab->used = 0;
+        slab->capacity = capacity;
+        this->slabs = slab;
     }
 
-    this->data = malloc(length);
-    if (!this->data) {
-        hkey_destroy(this);
+    void *memory = slab->data + slab->used;
+    slab->used += size;
+    return memory;
+}
+
+/* Private: Free every slab owned by the map, along with all entries and keys
+ * carved out of them. This costs one call to free per slab rather than per
+ * entry.
+ *
+ * this - The hashmap whose slabs to release.
+ *
+ * Returns nothing.
+ */
+void hslab_release(struct hashmap *this) {
+    struct hslab *slab = this->slabs;
+    while (slab) {
+        struct hslab *next = slab->next;
+        allocator_free(this->allocator, slab,
+                       sizeof(struct hslab) + slab->capacity);
+        slab = next;
+    }
+
+    this->slabs = NULL;
+    this->unused = NULL;
+    this->unused_keys = NULL;
+}
+
+/* Private: Find the size class of a long key carved out of a slab: the
+ * smallest power of two that holds it.
+ *
+ * length - The number of bytes in the key.
+ *
+ * Returns the class's exponent, or `KEY_CLASSES` if the key is too long to
+ * round up.
+ */
+size_t hslab_key_class(size_t length) {
+    size_t class = 0;
+    while (class < KEY_CLASSES && ((size_t)1 << class) < length) {
+        class++;
+    }
+    return class;
+}
+
+/* Private: Allocate memory for a long key from a slab, reusing a removed key
+ * of the same size class when there is one. Rounding keys up to a power of
+ * two lets any freed key be reused by another in its class, so maps that
+ * churn through keys reach a steady size.
+ *
+ * this   - The hashmap that owns the slabs.
+ * length - The number of bytes in the key.
+ *
+ * Returns the memory or null if allocation failed.
+ */
+void *hslab_key_alloc(struct hashmap *this, size_t length) {
+    size_t class = hslab_key_class(length);
+    if (class == KEY_CLASSES) {
         return NULL;
     }
 
-    this->length = length;
-    memcpy(this->data, data, length);
-    return this;
+    if (!this->unused_keys) {
+        this->unused_keys = hslab_alloc(this, KEY_CLASSES * sizeof(void *));
+        if (!this->unused_keys) {
+            return NULL;
+        }
+        memset(this->unused_keys, 0, KEY_CLASSES * sizeof(void *));
+    }
+
+    void *memory = this->unused_keys[class];
+    if (memory) {
+        memcpy(&this->unused_keys[class], memory, sizeof(void *));
+        return memory;
+    }
+    return hslab_alloc(this, (size_t)1 << class);
 }
 
-/* Private: Free the memory associated with the key.
+/* Private: Push a long key's slab memory onto the free list of its size
+ * class. The first word of the memory links to the next free key.
  *
- * this - The key memory to free.
+ * this   - The hashmap that owns the slabs.
+ * data   - The key memory from hslab_key_alloc.
+ * length - The number of bytes in the key.
  *
  * Returns nothing.
  */
-void hkey_destroy(struct hkey *this) {
-    free(this->data);
-    this->data = NULL;
-    this->length = 0;
-    free(this);
+void hslab_key_free(struct hashmap *this, void *data, size_t length) {
+    size_t class = hslab_key_class(length);
+    memcpy(data, &this->unused_keys[class], sizeof(void *));
+    this->unused_keys[class] = data;
+}
+
+/* Private: Determine if two maps compute the same hash for every key, so
+ * entries can be copied between them without rehashing.
+ *
+ * a - A hashmap.
+ * b - Another hashmap.
+ *
+ * Returns true if the maps share a hash function and seed.
+ */
+bool hashmap_same_hash(struct hashmap *a, struct hashmap *b) {
+    if ((a->flags ^ b->flags) & HASH_FLAGS) {
+        return false;
+    }
+    return a->seed[0] == b->seed[0] && a->seed[1] == b->seed[1];
+}
+
+/* Private: Set the key for the map's seeded hash function. Without a seed
+ * from the caller, one is read from the system's random device, falling back
+ * to mixing the clock and the map's address where there is none. Maps that
+ * don't use a seeded hash get a zero seed.
+ *
+ * this - The hashmap to seed.
+ * seed - The caller's seed, or zeros to pick one at random.
+ *
+ * Returns nothing.
+ */
+void hashmap_seed(struct hashmap *this, const uint64_t seed[2]) {
+    this->seed[0] = seed[0];
+    this->seed[1] = seed[1];
+    if (!(this->flags & (HASHMAP_SEEDED | HASHMAP_SIPHASH))) {
+        this->seed[0] = this->seed[1] = 0;
+        return;
+    }
+
+    if (this->seed[0] || this->seed[1]) {
+        return;
+    }
+
+    FILE *random = fopen("/dev/urandom", "rb");
+    if (random) {
+        size_t read = fread(this->seed, sizeof(uint64_t), 2, random);
+        fclose(random);
+        if (read == 2) {
+            return;
+        }
+    }
+
+    static uint64_t counter;
+    uint64_t entropy[3] = {(uint64_t)time(NULL), (uint64_t)clock(),
+                           (uint64_t)(uintptr_t)this ^ ++counter};
+    this->seed[0] = hkey_wyhash(entropy, sizeof(entropy), 0);
+    this->seed[1] = hkey_wyhash(entropy, sizeof(entropy), this->seed[0]);
 }
 
 /* Private: Compare two keys for equality. This determines if a match is found
@@ -494,14 +1796,97 @@ bool hkey_equals(struct hkey *a, struct hkey *b) {
     return (a->length == b->length) && memcmp(a->data, b->data, a->length) == 0;
 }
 
-/* Private: Computes the FNV-1a hash of the key data.
+/* Compute the 64-bit hash of the key data. This is the default hash function
+ * for hashmaps, in the style of wyhash, and is public so other maps built on
+ * hkeys hash them the same way.
+ *
+ * Keys up to 16 bytes are read in two overlapping words without a loop. Longer
+ * keys are consumed 16 bytes per step, and keys over 48 bytes are split across
+ * three independent multiply chains so the processor can overlap them. Each
+ * step folds the full 128-bit product of two words back into 64 bits.
+ *
+ * data   - The bytes to hash.
+ * length - The number of bytes in data.
+ *
+ * Returns the numerical hash of the input bytes.
+ */
+uint64_t hkey_hash(const void *data, size_t length) {
+    return hkey_wyhash(data, length, 0);
+}
+
+/* Private: Compute the 64-bit hash of the key data, keyed by a seed. This is
+ * the body of `hkey_hash`, which uses a zero seed, and of the
+ * `HASHMAP_SEEDED` hash.
+ *
+ * data   - The bytes to hash.
+ * length - The number of bytes in data.
+ * seed   - The secret key mixed into the hash.
+ *
+ * Returns the numerical hash of the input bytes.
+ */
+uint64_t hkey_wyhash(const void *data, size_t length, uint64_t seed) {
+    static const uint64_t secret[4] = {0x2d358dccaa6c78a5, 0x8bb84b93962eacc9,
+                                       0x4b33a62ed433d4a3, 0x4d5a2da51de1aa47};
+    const unsigned char *bytes = data;
+    seed = hkey_mix(secret[0] ^ seed, secret[1]);
+    uint64_t a = 0;
+    uint64_t b = 0;
+
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t middle = (length >> 3) << 2;
+            a = (hkey_read32(bytes) << 32) | hkey_read32(bytes + middle);
+            b = (hkey_read32(bytes + length - 4) << 32) |
+                hkey_read32(bytes + length - 4 - middle);
+        } else if (length > 0) {
+            a = ((uint64_t)bytes[0] << 16) |
+                ((uint64_t)bytes[length >> 1] << 8) | bytes[length - 1];
+        }
+    } else {
+        size_t remaining = length;
+        if (remaining > 48) {
+            uint64_t lane1 = seed;
+            uint64_t lane2 = seed;
+            do {
+                seed = hkey_mix(hkey_read64(bytes) ^ secret[1],
+                                hkey_read64(bytes + 8) ^ seed);
+                lane1 = hkey_mix(hkey_read64(bytes + 16) ^ secret[2],
+                                 hkey_read64(bytes + 24) ^ lane1);
+                lane2 = hkey_mix(hkey_read64(bytes + 32) ^ secret[3],
+                                 hkey_read64(bytes + 40) ^ lane2);
+                bytes += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= lane1 ^ lane2;
+        }
+
+        while (remaining > 16) {
+            seed = hkey_mix(hkey_read64(bytes) ^ secret[1],
+                            hkey_read64(bytes + 8) ^ seed);
+            bytes += 16;
+            remaining -= 16;
+        }
+
+        a = hkey_read64(bytes + remaining - 16);
+        b = hkey_read64(bytes + remaining - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    hkey_multiply(&a, &b);
+    return hkey_mix(a ^ secret[0] ^ length, b ^ secret[1]);
+}
+
+/* Private: Computes the FNV-1a hash of the key data. This is slower than the
+ * default hash for all but the shortest keys, and is selected with the
+ * `HASHMAP_FNV1A` flag.
  *
  * data   - The bytes to hash.
  * length - The number of bytes in data.
  *
  * Returns the numerical hash of the input bytes.
  */
-uint32_t hkey_hash(const void *data, size_t length) {
+uint32_t hkey_fnv1a(const void *data, size_t length) {
     const unsigned char *bytes = data;
     uint32_t hash = 2166136261;
 
@@ -510,3 +1895,131 @@ uint32_t hkey_hash(const void *data, size_t length) {
     }
     return hash;
 }
+
+/* Private: Read eight bytes of key data as an integer. The bytes don't need
+ * to be aligned.
+ *
+ * bytes - The key data to read.
+ *
+ * Returns the bytes in native byte order.
+ */
+uint64_t hkey_read64(const unsigned char *bytes) {
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+/* Private: Read four bytes of key data as an integer. The bytes don't need
+ * to be aligned.
+ *
+ * bytes - The key data to read.
+ *
+ * Returns the bytes in native byte order.
+ */
+uint64_t hkey_read32(const unsigned char *bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+/* Private: Multiply two words into a 128-bit product.
+ *
+ * a - The first word, replaced with the low half of the product.
+ * b - The second word, replaced with the high half of the product.
+ *
+ * Returns nothing.
+ */
+void hkey_multiply(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    hkey_uint128 product = (hkey_uint128)*a * *b;
+    *a = (uint64_t)product;
+    *b = (uint64_t)(product >> 64);
+#else
+    uint64_t ha = *a >> 32, la = (uint32_t)*a;
+    uint64_t hb = *b >> 32, lb = (uint32_t)*b;
+    uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    uint64_t middle = (ll >> 32) + (uint32_t)hl + (uint32_t)lh;
+    *a = (middle << 32) | (uint32_t)ll;
+    *b = hh + (hl >> 32) + (lh >> 32) + (middle >> 32);
+#endif
+}
+
+/* Private: Multiply two words and fold the high and low halves of the product
+ * together. Every input bit affects most output bits, which makes this the
+ * mixing step of the hash function.
+ *
+ * a - The first word.
+ * b - The second word.
+ *
+ * Returns the folded product.
+ */
+uint64_t hkey_mix(uint64_t a, uint64_t b) {
+    hkey_multiply(&a, &b);
+    return a ^ b;
+}
+
+/* Private: Compute the SipHash-1-3 of the key data under a 128-bit secret
+ * key. This is slower than the default hash but is a keyed pseudorandom
+ * function, so without the key an attacker can't choose keys that collide.
+ *
+ * data   - The bytes to hash.
+ * length - The number of bytes in data.
+ * seed   - The two words of the secret key.
+ *
+ * Returns the numerical hash of the input bytes.
+ */
+uint64_t hkey_siphash(const void *data, size_t length,
+                      const uint64_t seed[2]) {
+    const unsigned char *bytes = data;
+    uint64_t state[4] = {seed[0] ^ 0x736f6d6570736575,
+                         seed[1] ^ 0x646f72616e646f6d,
+                         seed[0] ^ 0x6c7967656e657261,
+                         seed[1] ^ 0x7465646279746573};
+
+    size_t remaining = length;
+    while (remaining >= 8) {
+        uint64_t word = hkey_read64(bytes);
+        state[3] ^= word;
+        hkey_sipround(state);
+        state[0] ^= word;
+        bytes += 8;
+        remaining -= 8;
+    }
+
+    uint64_t last = (uint64_t)length << 56;
+    for (size_t i = 0; i < remaining; i++) {
+        last |= (uint64_t)bytes[i] << (8 * i);
+    }
+    state[3] ^= last;
+    hkey_sipround(state);
+    state[0] ^= last;
+
+    state[2] ^= 0xff;
+    hkey_sipround(state);
+    hkey_sipround(state);
+    hkey_sipround(state);
+    return state[0] ^ state[1] ^ state[2] ^ state[3];
+}
+
+/* Private: Apply one SipHash round to the hash state.
+ *
+ * state - The four words of hash state.
+ *
+ * Returns nothing.
+ */
+void hkey_sipround(uint64_t state[4]) {
+    state[0] += state[1];
+    state[1] = (state[1] << 13) | (state[1] >> 51);
+    state[1] ^= state[0];
+    state[0] = (state[0] << 32) | (state[0] >> 32);
+    state[2] += state[3];
+    state[3] = (state[3] << 16) | (state[3] >> 48);
+    state[3] ^= state[2];
+    state[0] += state[3];
+    state[3] = (state[3] << 21) | (state[3] >> 43);
+    state[3] ^= state[0];
+    state[2] += state[1];
+    state[1] = (state[1] << 17) | (state[1] >> 47);
+    state[1] ^= state[2];
+    state[2] = (state[2] << 32) | (state[2] >> 32);
+}
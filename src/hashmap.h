@@ -1,8 +1,10 @@
 #ifndef HASHMAP_H
 #define HASHMAP_H
 
+#include "allocator.h"
 #include "iterator.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 struct hkey {
@@ -10,24 +12,141 @@ struct hkey {
     size_t length;
 };
 
+/* Keys up to this many bytes are stored inside their entry rather than in a
+ * separate allocation.
+ */
+#define HKEY_INLINE_SIZE 24
+
 struct hentry {
     struct hentry *prev;
     struct hentry *next;
     struct hentry *chain;
-    struct hkey *key;
+    uint64_t hash;
+    struct hkey key;
     void *value;
+    unsigned char buffer[HKEY_INLINE_SIZE];
+};
+
+struct hslot {
+    uint64_t hash;
+    struct hentry *entry;
+};
+
+struct hslab;
+
+struct hashmap_options {
+    unsigned long flags;
+    size_t capacity;
+    const struct allocator *allocator;
+    uint64_t seed[2];
+};
+
+/* The number of probe lengths counted separately in `struct hashmap_stats`.
+ * Longer probes are counted in the last bin.
+ */
+#define HASHMAP_PROBE_BINS 16
+
+struct hashmap_stats {
+    size_t size;
+    size_t capacity;
+    double load;
+    size_t max_probe;
+    double mean_probe;
+    size_t probes[HASHMAP_PROBE_BINS];
+    size_t resizes;
+    double resize_seconds;
+    size_t key_bytes;
 };
 
 struct hashmap {
     struct hentry **entries;
+    struct hentry **old_entries;
+    struct hslot *slots;
     struct hentry *head;
     struct hentry *tail;
+    struct hslab *slabs;
+    struct hentry *unused;
+    void **unused_keys;
     size_t capacity;
+    size_t old_capacity;
+    size_t rehash_index;
     size_t size;
+    unsigned long flags;
+    uint64_t seed[2];
+    const struct allocator *allocator;
+    size_t resizes;
+    double resize_seconds;
+};
+
+/* An iterator that lives on the caller's stack. Unlike `hashmap_iterator`, it
+ * needs no allocation and its inline `next` function needs no indirect call.
+ * It holds the entry after the current one, so the current key may be
+ * removed during the loop.
+ */
+struct hashmap_iter {
+    struct hentry *entry;
+    struct hentry *current;
 };
 
+/* Loop over each entry in a map in insertion order, assigning it to `entry`,
+ * a `struct hentry *` declared before the loop. Keys must not be removed in
+ * the loop.
+ *
+ * Examples
+ *
+ *   struct hentry *entry;
+ *   HASHMAP_FOREACH(entry, map) {
+ *       printf("%s => %p\n", (char *)entry->key.data, entry->value);
+ *   }
+ */
+#define HASHMAP_FOREACH(entry, map)                                            \
+    for ((entry) = (map)->head; (entry); (entry) = (entry)->next)
+
+/* Store entries in one flat array of slots, probed linearly with robin hood
+ * displacement, rather than in chained buckets.
+ */
+#define HASHMAP_OPEN 0x1
+
+/* Hash keys with byte-at-a-time FNV-1a instead of the default 64-bit hash.
+ */
+#define HASHMAP_FNV1A 0x2
+
+/* Carve entries and keys out of large slabs owned by the map. Removed entries
+ * and long keys are kept on free lists for reuse, and clearing or destroying
+ * the map frees whole slabs instead of walking its entries.
+ */
+#define HASHMAP_SLAB 0x4
+
+/* Grow chained buckets by migrating a few buckets on each operation instead
+ * of rehashing every entry at once. Not supported with `HASHMAP_OPEN`.
+ */
+#define HASHMAP_INCREMENTAL 0x8
+
+/* Halve the table when removes leave it less than one eighth full.
+ */
+#define HASHMAP_SHRINK 0x10
+
+/* Key the default hash with a per-map random seed, so keys that collide in
+ * one map are unlikely to collide in another. Fast, for keys that aren't
+ * chosen by an attacker.
+ */
+#define HASHMAP_SEEDED 0x20
+
+/* Hash keys with SipHash-1-3 under a per-map random key. Use this for keys
+ * from untrusted input, which could otherwise be chosen to collide and
+ * degrade every operation to a linear scan.
+ */
+#define HASHMAP_SIPHASH 0x40
+
 struct hashmap *hashmap_create(void);
 
+struct hashmap *hashmap_create_with_options(struct hashmap_options *options);
+
+struct hashmap *hashmap_create_with_capacity(size_t capacity);
+
+struct hashmap *
+hashmap_create_with_allocator(const struct allocator *allocator);
+
 void hashmap_destroy(struct hashmap *this);
 
 struct hashmap *hashmap_clone(struct hashmap *this);
@@ -36,14 +155,83 @@ void *hashmap_get(struct hashmap *this, struct hkey *key);
 
 void *hashmap_set(struct hashmap *this, struct hkey *key, void *value);
 
+void **hashmap_entry(struct hashmap *this, struct hkey *key, bool *inserted);
+
+void *hashmap_update(struct hashmap *this, struct hkey *key,
+                     void *(*update)(void *value, void *context),
+                     void *context);
+
+void **hashmap_touch(struct hashmap *this, struct hkey *key);
+
+void **hashmap_touch_entry(struct hashmap *this, struct hkey *key,
+                           bool *inserted);
+
 bool hashmap_contains(struct hashmap *this, struct hkey *key);
 
+size_t hashmap_get_many(struct hashmap *this, struct hkey *keys, size_t count,
+                        void **values);
+
+size_t hashmap_contains_many(struct hashmap *this, struct hkey *keys,
+                             size_t count, bool *contains);
+
 void *hashmap_remove(struct hashmap *this, struct hkey *key);
 
+uint64_t hashmap_hash(struct hashmap *this, struct hkey *key);
+
+void *hashmap_get_hashed(struct hashmap *this, struct hkey *key,
+                         uint64_t hash);
+
+void *hashmap_set_hashed(struct hashmap *this, struct hkey *key, uint64_t hash,
+                         void *value);
+
+bool hashmap_contains_hashed(struct hashmap *this, struct hkey *key,
+                             uint64_t hash);
+
+void *hashmap_remove_hashed(struct hashmap *this, struct hkey *key,
+                            uint64_t hash);
+
 void hashmap_clear(struct hashmap *this);
 
+bool hashmap_reserve(struct hashmap *this, size_t size);
+
+bool hashmap_shrink_to_fit(struct hashmap *this);
+
 bool hashmap_merge(struct hashmap *this, struct hashmap *other);
 
 struct iterator *hashmap_iterator(struct hashmap *this);
 
+/* Start a stack iterator at the first entry of a map, in insertion order.
+ *
+ * this - The iterator to initialize.
+ * map  - The hashmap to iterate through.
+ *
+ * Returns nothing.
+ */
+static inline void hashmap_iter_init(struct hashmap_iter *this,
+                                     struct hashmap *map) {
+    this->entry = map->head;
+    this->current = NULL;
+}
+
+/* Advance a stack iterator to the next entry, storing it in `current`.
+ *
+ * this - The iterator to advance.
+ *
+ * Returns false when iteration is complete.
+ */
+static inline bool hashmap_iter_next(struct hashmap_iter *this) {
+    this->current = this->entry;
+    if (!this->entry) {
+        return false;
+    }
+    this->entry = this->entry->next;
+    return true;
+}
+
+#ifdef HASHMAP_STATS
+void hashmap_stats(struct hashmap *this, struct hashmap_stats *stats);
+#endif
+
+uint64_t hkey_hash(const void *data, size_t length);
+
 #endif
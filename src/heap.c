@@ -1,11 +1,32 @@
 #include "heap.h"
+#include <errno.h>
+#include <stdint.h>
 #include <string.h>
 
+/* The nodes an iterator has yet to visit whose parents have been visited,
+ * kept as a min-heap of indices into the iterated heap's node array.
+ */
+struct hfrontier {
+    struct heap *heap;
+    size_t *indices;
+    size_t capacity;
+    size_t size;
+};
+
 static void heap_move_up(struct heap *this, size_t k);
 static void heap_move_down(struct heap *this, size_t k);
+static size_t heap_move_hole_down(struct heap *this);
+static size_t heap_smallest_child(struct heap *this, size_t first);
 static void *heap_next_node(struct iterator *this);
 static void heap_destroy_iterator(struct iterator *this);
+static size_t heap_next_batch(struct iterator *this, void **out, size_t max);
+static bool hfrontier_reserve(struct hfrontier *this, size_t capacity);
+static void hfrontier_insert(struct hfrontier *this, size_t index);
+static void *hfrontier_pop(struct hfrontier *this);
+static void heap_heapify(struct heap *this);
+static size_t heap_log2(size_t n);
 static bool heap_resize(struct heap *this, size_t capacity);
+static size_t heap_block_size(size_t capacity);
 
 /* Allocate memory for a new heap instance. Depending on the comparator
  * function behavior, it can be a min-heap or a max-heap. The heap must
@@ -17,15 +38,75 @@ static bool heap_resize(struct heap *this, size_t capacity);
  * Returns the new heap or null if memory allocation failed.
  */
 struct heap *heap_create(int (*comparator)(const void *, const void *)) {
-    struct heap *this = calloc(1, sizeof(struct heap));
+    return heap_create_with_allocator(comparator, &allocator_libc);
+}
+
+/* Allocate memory for a new heap whose node storage, clones, and iterators are
+ * provided by an allocator. The heap must be freed with a call to
+ * heap_destroy.
+ *
+ * comparator - The function with which to sort entries in the heap.
+ * allocator  - The allocator to use for all of the heap's memory.
+ *
+ * Returns the new heap or null if memory allocation failed.
+ */
+struct heap *
+heap_create_with_allocator(int (*comparator)(const void *, const void *),
+                           const struct allocator *allocator) {
+    struct heap_options options = {0};
+    options.allocator = allocator;
+    return heap_create_with_options(comparator, &options);
+}
+
+/* Allocate memory for a new heap configured with non-default options. The
+ * heap must be freed with a call to heap_destroy.
+ *
+ * A d-ary heap gives each node `arity` children instead of two. Its tree is
+ * half as deep for 4 children and a third as deep for 8, so a pop visits
+ * fewer levels, though it compares more children at each one. The children
+ * of a node are stored next to each other in the aligned node array, so
+ * those of an 8-ary heap fill exactly one cache line. Large heaps that don't
+ * fit in cache pop faster as a result.
+ *
+ * comparator - The function with which to sort entries in the heap.
+ * options    - The heap configuration. The `arity` field is the number of
+ *              children per node: 2, 4, or 8, or zero for 2. The `allocator`
+ *              field provides all of the heap's memory, or is null for the C
+ *              library allocator.
+ *
+ * Examples
+ *
+ *   struct heap_options options = {0};
+ *   options.arity = 8;
+ *   struct heap *heap = heap_create_with_options(compare_nodes, &options);
+ *
+ * Returns the new heap or null if memory allocation failed or the arity isn't
+ * supported, in which case `errno` is set to `EINVAL`.
+ */
+struct heap *
+heap_create_with_options(int (*comparator)(const void *, const void *),
+                         struct heap_options *options) {
+    size_t arity = options->arity ? options->arity : 2;
+    if (arity != 2 && arity != 4 && arity != 8) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    const struct allocator *allocator =
+        options->allocator ? options->allocator : &allocator_libc;
+
+    struct heap *this = allocator_alloc(allocator, sizeof(struct heap));
     if (!this) {
         return NULL;
     }
 
+    this->allocator = allocator;
     this->comparator = comparator;
     this->nodes = NULL;
     this->capacity = 0;
     this->size = 0;
+    this->arity = arity;
+    this->block = NULL;
 
     if (!heap_resize(this, 16)) {
         heap_destroy(this);
@@ -35,6 +116,37 @@ struct heap *heap_create(int (*comparator)(const void *, const void *)) {
     return this;
 }
 
+/* Allocate memory for a new heap holding a copy of an array of items, such as
+ * the items of a `struct vector`. The heap is built bottom-up in O(n) time
+ * rather than with one push per item. The heap must be freed with a call to
+ * heap_destroy.
+ *
+ * comparator - The function with which to sort entries in the heap.
+ * items      - The array of items to copy into the heap.
+ * count      - The number of items in the array.
+ *
+ * Examples
+ *
+ *   struct heap *heap =
+ *       heap_create_from(compare_nodes, vector->items, vector->length);
+ *
+ * Returns the new heap or null if memory allocation failed.
+ */
+struct heap *heap_create_from(int (*comparator)(const void *, const void *),
+                              void **items, size_t count) {
+    struct heap *this = heap_create(comparator);
+    if (!this) {
+        return NULL;
+    }
+
+    if (!heap_push_many(this, items, count)) {
+        heap_destroy(this);
+        return NULL;
+    }
+
+    return this;
+}
+
 /* Free the memory associated with the heap. The values stored in the heap are
  * not freed. They must be deallocated before the heap is destroyed, or
  * otherwise cleaned up later by the caller.
@@ -44,11 +156,14 @@ struct heap *heap_create(int (*comparator)(const void *, const void *)) {
  * Returns nothing.
  */
 void heap_destroy(struct heap *this) {
+    if (this->block) {
+        allocator_free(this->allocator, this->block,
+                       heap_block_size(this->capacity));
+    }
     this->capacity = 0;
     this->size = 0;
     this->comparator = NULL;
-    free(this->nodes);
-    free(this);
+    allocator_free(this->allocator, this, sizeof(struct heap));
 }
 
 /* Copy the heap contents into a new heap. Modifications to either heap
@@ -59,7 +174,8 @@ void heap_destroy(struct heap *this) {
  * Returns the cloned heap or null if memory allocation failed.
  */
 struct heap *heap_clone(struct heap *this) {
-    struct heap *clone = heap_create(this->comparator);
+    struct heap_options options = {this->arity, this->allocator};
+    struct heap *clone = heap_create_with_options(this->comparator, &options);
     if (!clone) {
         return NULL;
     }
@@ -115,7 +231,8 @@ bool heap_push(struct heap *this, void *item) {
 }
 
 /* Remove the root item from the heap. The remaining items are sorted into place
- * with the heap's comparator function.
+ * with the heap's comparator function, bottom-up: the hole at the root is
+ * moved down to a leaf and the last item is moved up from there.
  *
  * heap - The heap from which to remove the item.
  *
@@ -127,16 +244,69 @@ void *heap_pop(struct heap *this) {
     }
 
     void *root = this->nodes[0];
-    this->nodes[0] = this->nodes[this->size - 1];
+    void *last = this->nodes[this->size - 1];
     this->nodes[this->size - 1] = NULL;
     this->size--;
     if (this->size > 0) {
-        heap_move_down(this, 0);
+        size_t k = heap_move_hole_down(this);
+        this->nodes[k] = last;
+        heap_move_up(this, k);
     }
 
     return root;
 }
 
+/* Find the root item of the heap without removing it.
+ *
+ * this - The heap to inspect.
+ *
+ * Returns the item that the next pop would return or null if the heap is
+ * empty.
+ */
+void *heap_peek(struct heap *this) {
+    return this->size > 0 ? this->nodes[0] : NULL;
+}
+
+/* Add a batch of items to the heap. Small batches are pushed one at a time,
+ * each costing up to one comparison per level of the heap. Larger batches
+ * are appended and the whole heap is rebuilt bottom-up, which costs O(n).
+ *
+ * this  - The heap onto which to push the items.
+ * items - The array of items to add.
+ * count - The number of items in the array.
+ *
+ * Returns true if the items were added or false if memory allocation failed,
+ * in which case the heap is unchanged.
+ */
+bool heap_push_many(struct heap *this, void **items, size_t count) {
+    if (count == 0) {
+        return true;
+    }
+
+    size_t total = this->size + count;
+    if (total > this->capacity) {
+        size_t capacity = this->capacity * 2;
+        if (!heap_resize(this, capacity < total ? total : capacity)) {
+            return false;
+        }
+    }
+
+    size_t first = this->size;
+    memcpy(this->nodes + first, items, count * sizeof(void *));
+    this->size = total;
+
+    size_t depth = first ? heap_log2(first) / heap_log2(this->arity) : 0;
+    if (2 * total < count * depth || first == 0) {
+        heap_heapify(this);
+    } else {
+        for (size_t i = first; i < total; i++) {
+            heap_move_up(this, i);
+        }
+    }
+
+    return true;
+}
+
 /* Combine one heap into another. The destination heap sorts new nodes into
  * place to maintain its total ordering. The source heap is unaffected by the
  * merge. It contains the same items after merging.
@@ -154,23 +324,68 @@ bool heap_merge(struct heap *this, struct heap *other) {
         }
     }
 
-    for (size_t i = 0; i < other->size; i++) {
-        if (!heap_push(this, other->nodes[i])) {
-            return false;
-        }
+    return heap_push_many(this, other->nodes, other->size);
+}
+
+/* Copy the smallest items in the heap, in sorted order, into a buffer without
+ * modifying the heap. Only the part of the heap's tree above the k-th item is
+ * visited, so this costs O(k log k) rather than the O(n log n) of sorting a
+ * copy of the whole heap.
+ *
+ * this - The heap from which to copy items.
+ * k    - The maximum number of items to copy.
+ * out  - The buffer to fill with at least `k` slots.
+ *
+ * Examples
+ *
+ *   void *names[10];
+ *   size_t count = heap_top_k(heap, 10, names);
+ *
+ * Returns the number of items copied, which is less than `k` only when the
+ * heap holds fewer items, or zero if memory allocation failed. The `errno`
+ * global is set to `ENOMEM` if allocation failed, zero otherwise.
+ */
+size_t heap_top_k(struct heap *this, size_t k, void **out) {
+    errno = 0;
+    if (k > this->size) {
+        k = this->size;
+    }
+    if (k == 0) {
+        return 0;
     }
 
-    return true;
+    /* Each pop replaces one index with at most `arity`, so this many slots
+     * never need to grow.
+     */
+    struct hfrontier frontier = {this, NULL, 0, 0};
+    if (!hfrontier_reserve(&frontier, k * (this->arity - 1) + 1)) {
+        errno = ENOMEM;
+        return 0;
+    }
+
+    hfrontier_insert(&frontier, 0);
+    for (size_t i = 0; i < k; i++) {
+        out[i] = hfrontier_pop(&frontier);
+    }
+
+    allocator_free(this->allocator, frontier.indices,
+                   frontier.capacity * sizeof(size_t));
+    return k;
 }
 
 /* Create an external iterator with which to loop over each item in the heap
  * in sorted order. The caller must free the iterator's memory when iteration
  * is complete.
  *
- * Because heap iteration is a destructive process, items must be popped from
- * the heap to maintain total ordering, the iterator allocates a cloned heap
- * through which to iterate. The clone is deallocated through the iterator's
- * `destroy` function.
+ * The iterator leaves the heap untouched. It walks the heap's tree with a
+ * small frontier of node indices ordered by the heap's comparator, so the
+ * first k items cost O(k log k) no matter how large the heap is. The heap
+ * must not be modified while the iterator is in use.
+ *
+ * The frontier grows as iteration goes deeper into the tree. If it can't,
+ * iteration ends early. When `next` returns null, or `next_batch` returns
+ * fewer nodes than requested, `errno` is set to `ENOMEM` if the iterator ran
+ * out of memory and to zero if every node was visited.
  *
  * this - The heap to iterate through.
  *
@@ -186,31 +401,53 @@ bool heap_merge(struct heap *this, struct heap *other) {
  * Returns an iterator or null if memory allocation failed.
  */
 struct iterator *heap_iterator(struct heap *this) {
-    struct heap *clone = heap_clone(this);
-    if (!clone) {
+    struct hfrontier *frontier =
+        allocator_alloc(this->allocator, sizeof(struct hfrontier));
+    if (!frontier) {
         return NULL;
     }
 
-    struct iterator *nodes = iterator_create(clone, heap_next_node);
+    frontier->heap = this;
+    frontier->indices = NULL;
+    frontier->capacity = 0;
+    frontier->size = 0;
+
+    if (this->size > 0) {
+        if (!hfrontier_reserve(frontier, 16)) {
+            allocator_free(this->allocator, frontier, sizeof(struct hfrontier));
+            return NULL;
+        }
+        hfrontier_insert(frontier, 0);
+    }
+
+    struct iterator *nodes = iterator_create_with_allocator(
+        frontier, heap_next_node, this->allocator);
     if (!nodes) {
-        heap_destroy(clone);
+        allocator_free(this->allocator, frontier->indices,
+                       frontier->capacity * sizeof(size_t));
+        allocator_free(this->allocator, frontier, sizeof(struct hfrontier));
         return NULL;
     }
 
+    nodes->next_batch = heap_next_batch;
     nodes->destroy = heap_destroy_iterator;
     return nodes;
 }
 
-/* Private: Free the iterator's memory, including the cloned heap through
- * which it was navigating. This is the function pointer used to implement
- * `iter->destroy(iter)`.
+/* Private: Free the iterator's memory, including the frontier of node indices
+ * through which it was navigating. This is the function pointer used to
+ * implement `iter->destroy(iter)`.
  *
  * this - The iterator to destroy.
  *
  * Returns nothing.
  */
 void heap_destroy_iterator(struct iterator *this) {
-    heap_destroy(this->iterable);
+    struct hfrontier *frontier = this->iterable;
+    const struct allocator *allocator = frontier->heap->allocator;
+    allocator_free(allocator, frontier->indices,
+                   frontier->capacity * sizeof(size_t));
+    allocator_free(allocator, frontier, sizeof(struct hfrontier));
     iterator_destroy(this);
 }
 
@@ -219,14 +456,25 @@ void heap_destroy_iterator(struct iterator *this) {
  *
  * this - The iterator to advance.
  *
- * Returns the next item or null if the heap is empty.
+ * Returns the next item or null if every item has been visited or memory
+ * allocation failed, setting `errno` to tell them apart.
  */
 void *heap_next_node(struct iterator *this) {
-    struct heap *heap = this->iterable;
+    struct hfrontier *frontier = this->iterable;
+    struct heap *heap = frontier->heap;
 
     bool first = !this->current && this->index == 0;
 
-    this->current = heap_pop(heap);
+    this->current = NULL;
+    if (frontier->size > 0) {
+        if (!hfrontier_reserve(frontier, frontier->size + heap->arity - 1)) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        this->current = hfrontier_pop(frontier);
+    } else {
+        errno = 0;
+    }
 
     if (!first && this->current) {
         this->index++;
@@ -235,7 +483,195 @@ void *heap_next_node(struct iterator *this) {
     return this->current;
 }
 
-/* Private: Move the last element in the heap up until it's in sorted order.
+/* Private: Copy the next run of nodes, in sorted order, into a buffer. This
+ * is the function pointer used to implement `iter->next_batch()`.
+ *
+ * this - The iterator to advance.
+ * out  - The buffer to fill.
+ * max  - The maximum number of nodes to copy.
+ *
+ * Returns the number of nodes copied, fewer than max if every item has been
+ * visited or memory allocation failed, setting `errno` to tell them apart.
+ */
+size_t heap_next_batch(struct iterator *this, void **out, size_t max) {
+    struct hfrontier *frontier = this->iterable;
+    struct heap *heap = frontier->heap;
+
+    bool first = !this->current && this->index == 0;
+
+    size_t count = 0;
+    while (count < max && frontier->size > 0) {
+        if (!hfrontier_reserve(frontier, frontier->size + heap->arity - 1)) {
+            break;
+        }
+        out[count++] = hfrontier_pop(frontier);
+    }
+    if (count < max) {
+        errno = frontier->size > 0 ? ENOMEM : 0;
+    }
+
+    if (count > 0) {
+        this->index += first ? count - 1 : count;
+    }
+    this->current = count == max && count > 0 ? out[count - 1] : NULL;
+
+    return count;
+}
+
+/* Private: Ensure the frontier has room for a number of node indices,
+ * doubling its capacity as it grows.
+ *
+ * this     - The frontier to expand.
+ * capacity - The number of indices to accomodate.
+ *
+ * Returns false if memory allocation failed.
+ */
+bool hfrontier_reserve(struct hfrontier *this, size_t capacity) {
+    if (capacity <= this->capacity) {
+        return true;
+    }
+
+    size_t grown = this->capacity * 2;
+    if (grown < capacity) {
+        grown = capacity;
+    }
+
+    size_t *indices = allocator_realloc(
+        this->heap->allocator, this->indices, this->capacity * sizeof(size_t),
+        grown * sizeof(size_t));
+    if (!indices) {
+        return false;
+    }
+
+    this->indices = indices;
+    this->capacity = grown;
+    return true;
+}
+
+/* Private: Add a heap node's index to the frontier, moving it up until the
+ * frontier is ordered by the nodes it refers to. The frontier must have room
+ * for it.
+ *
+ * this  - The frontier to which to add the index.
+ * index - The position of the node in the heap's node array.
+ *
+ * Returns nothing.
+ */
+void hfrontier_insert(struct hfrontier *this, size_t index) {
+    void **nodes = this->heap->nodes;
+    int (*compare)(const void *, const void *) = this->heap->comparator;
+
+    size_t k = this->size++;
+    while (k > 0) {
+        size_t parent = (k - 1) / 2;
+        if (compare(nodes[index], nodes[this->indices[parent]]) >= 0) {
+            break;
+        }
+        this->indices[k] = this->indices[parent];
+        k = parent;
+    }
+    this->indices[k] = index;
+}
+
+/* Private: Remove the frontier's smallest node and replace it with that
+ * node's children in the heap. A node's children are never smaller than it,
+ * so the frontier always holds the next item in sorted order. The frontier
+ * must have room for `arity - 1` more indices than it holds.
+ *
+ * this - The frontier from which to take the next node.
+ *
+ * Returns the heap's next node in sorted order.
+ */
+void *hfrontier_pop(struct hfrontier *this) {
+    void **nodes = this->heap->nodes;
+    int (*compare)(const void *, const void *) = this->heap->comparator;
+    size_t count = this->heap->size;
+
+    size_t root = this->indices[0];
+    size_t first = this->heap->arity * root + 1;
+    size_t last = first + this->heap->arity;
+    if (last > count) {
+        last = count;
+    }
+
+    /* The first child takes the root's place, or failing that the last index
+     * does, and then sinks into position.
+     */
+    size_t index;
+    if (first < count) {
+        index = first;
+    } else {
+        index = this->indices[--this->size];
+    }
+
+    size_t k = 0;
+    while (this->size > 0) {
+        size_t child = 2 * k + 1;
+        if (child >= this->size) {
+            break;
+        }
+        if (child + 1 < this->size &&
+            compare(nodes[this->indices[child + 1]],
+                    nodes[this->indices[child]]) < 0) {
+            child++;
+        }
+        if (compare(nodes[this->indices[child]], nodes[index]) >= 0) {
+            break;
+        }
+        this->indices[k] = this->indices[child];
+        k = child;
+    }
+    if (this->size > 0) {
+        this->indices[k] = index;
+    }
+
+    for (size_t child = first + 1; child < last; child++) {
+        hfrontier_insert(this, child);
+    }
+
+    return nodes[root];
+}
+
+/* Private: Arrange the heap's nodes into heap order with Floyd's method,
+ * moving each parent down into place from the last one up to the root.
+ *
+ * this - The heap to order.
+ *
+ * Returns nothing.
+ */
+void heap_heapify(struct heap *this) {
+    if (this->size < 2) {
+        return;
+    }
+
+    for (size_t k = (this->size - 2) / this->arity + 1; k > 0; k--) {
+        heap_move_down(this, k - 1);
+    }
+}
+
+/* Private: Calculate the depth of a heap's tree, the most levels a pushed
+ * node can move up.
+ *
+ * n - The number of nodes in the heap. Must be non-zero.
+ *
+ * Returns the base 2 logarithm of n, rounded down.
+ */
+size_t heap_log2(size_t n) {
+#if defined(__GNUC__)
+    return sizeof(unsigned long long) * 8 - 1 -
+           (size_t)__builtin_clzll((unsigned long long)n);
+#else
+    size_t depth = 0;
+    while (n >>= 1) {
+        depth++;
+    }
+    return depth;
+#endif
+}
+
+/* Private: Move a node up the heap until it's in sorted order. Parents
+ * larger than the node are moved down into the hole it leaves, and the node
+ * is written once into its final position.
  *
  * this - The heap to fix up.
  * k    - The node to sort up the heap until it's in position.
@@ -243,20 +679,24 @@ void *heap_next_node(struct iterator *this) {
  * Returns nothing.
  */
 void heap_move_up(struct heap *this, size_t k) {
-    if (k == 0) {
-        return;
-    }
+    void **nodes = this->nodes;
+    void *node = nodes[k];
 
-    size_t parent = (k - 1) / 2;
-    if (this->comparator(this->nodes[k], this->nodes[parent]) < 0) {
-        void *temp = this->nodes[k];
-        this->nodes[k] = this->nodes[parent];
-        this->nodes[parent] = temp;
-        heap_move_up(this, parent);
+    while (k > 0) {
+        size_t parent = (k - 1) / this->arity;
+        if (this->comparator(node, nodes[parent]) >= 0) {
+            break;
+        }
+        nodes[k] = nodes[parent];
+        k = parent;
     }
+
+    nodes[k] = node;
 }
 
-/* Private: Move the root element down in the heap until it's in sorted order.
+/* Private: Move a node down the heap until it's in sorted order. Smaller
+ * children are moved up into the hole it leaves, and the node is written
+ * once into its final position.
  *
  * this - The heap to fix up.
  * k    - The node to move down the heap until it's in position.
@@ -264,27 +704,92 @@ void heap_move_up(struct heap *this, size_t k) {
  * Returns nothing.
  */
 void heap_move_down(struct heap *this, size_t k) {
-    size_t left = 2 * k + 1;
-    size_t right = 2 * k + 2;
-    if (left > (this->size - 1)) {
-        return;
+    void **nodes = this->nodes;
+    void *node = nodes[k];
+
+    for (;;) {
+        size_t child = heap_smallest_child(this, this->arity * k + 1);
+        if (child >= this->size) {
+            break;
+        }
+        if (this->comparator(node, nodes[child]) <= 0) {
+            break;
+        }
+        nodes[k] = nodes[child];
+        k = child;
+    }
+
+    nodes[k] = node;
+}
+
+/* Private: Move the hole left by removing the root down to a leaf, filling
+ * it at each level with the smallest child. This saves the comparison with
+ * the moving node that `heap_move_down` makes at each level. The node that
+ * fills the leaf is usually large, so it seldom moves far back up.
+ *
+ * this - The heap whose root was removed.
+ *
+ * Returns the position of the hole, now at a leaf.
+ */
+size_t heap_move_hole_down(struct heap *this) {
+    void **nodes = this->nodes;
+
+    size_t k = 0;
+    for (;;) {
+        size_t child = heap_smallest_child(this, this->arity * k + 1);
+        if (child >= this->size) {
+            break;
+        }
+        nodes[k] = nodes[child];
+        k = child;
     }
 
-    size_t smaller = left;
-    if (right < this->size &&
-        this->comparator(this->nodes[right], this->nodes[left]) < 0) {
-        smaller = right;
+    return k;
+}
+
+/* Private: Find the smallest of a node's children.
+ *
+ * this  - The heap to search.
+ * first - The position of the node's first child.
+ *
+ * Returns the position of the smallest child, or `first` if the node has no
+ * children, in which case it's past the end of the heap.
+ */
+size_t heap_smallest_child(struct heap *this, size_t first) {
+    size_t last = first + this->arity;
+    if (last > this->size) {
+        last = this->size;
+    }
+    if (first >= last) {
+        return first;
     }
 
-    if (this->comparator(this->nodes[k], this->nodes[smaller]) > 0) {
-        void *temp = this->nodes[k];
-        this->nodes[k] = this->nodes[smaller];
-        this->nodes[smaller] = temp;
-        heap_move_down(this, smaller);
+    /* Carrying the smallest node along, rather than looking it up by its
+     * position, lets the compiler branch on each comparison instead of
+     * selecting with a conditional move. The processor can then predict the
+     * path down the heap and start loading the next level's nodes before the
+     * comparison completes.
+     */
+    void **nodes = this->nodes;
+    size_t smallest = first;
+    void *node = nodes[first];
+    for (size_t child = first + 1; child < last; child++) {
+        if (this->comparator(nodes[child], node) < 0) {
+            smallest = child;
+            node = nodes[child];
+        }
     }
+
+    return smallest;
 }
 
 /* Private: Allocate memory used to store heap node pointers.
+ *
+ * The nodes are stored one slot before a cache line boundary. The children
+ * of node k begin at position `arity * k + 1`, so every group of children
+ * starts at a multiple of `arity` slots from the boundary and never spans
+ * more lines than it must. The block is over-allocated to leave room to
+ * align it, and the nodes are moved if reallocation changes the alignment.
  *
  * this     - The heap to expand.
  * capacity - The new number of nodes to accomodate.
@@ -292,12 +797,39 @@ void heap_move_down(struct heap *this, size_t k) {
  * Returns true if memory allocation succeeded.
  */
 bool heap_resize(struct heap *this, size_t capacity) {
-    void **nodes = realloc(this->nodes, capacity * sizeof(void *));
-    if (!nodes) {
+    size_t offset = this->block
+                        ? (size_t)((char *)this->nodes - (char *)this->block)
+                        : 0;
+
+    char *block = allocator_realloc(this->allocator, this->block,
+                                    heap_block_size(this->capacity),
+                                    heap_block_size(capacity));
+    if (!block) {
         return false;
     }
 
-    this->nodes = nodes;
+    uintptr_t first = (uintptr_t)block + sizeof(void *);
+    size_t padding = (size_t)(-first & (HEAP_ALIGNMENT - 1));
+    if (this->block && padding != offset) {
+        memmove(block + padding, block + offset, this->size * sizeof(void *));
+    }
+
+    this->block = block;
+    this->nodes = (void **)(void *)(block + padding);
     this->capacity = capacity;
     return true;
 }
+
+/* Private: Calculate the size of the memory block holding a heap's nodes,
+ * including the slack needed to align them.
+ *
+ * capacity - The number of nodes the block holds.
+ *
+ * Returns the size of the block in bytes, or zero if it holds no nodes.
+ */
+size_t heap_block_size(size_t capacity) {
+    if (capacity == 0) {
+        return 0;
+    }
+    return capacity * sizeof(void *) + HEAP_ALIGNMENT;
+}
@@ -1,19 +1,44 @@
 #ifndef HEAP_H
 #define HEAP_H
 
+#include "allocator.h"
 #include "iterator.h"
 #include <stdbool.h>
 #include <stdlib.h>
 
+/* Node storage is aligned to this many bytes, a cache line, so that the
+ * children of a node in an 8-ary heap share one line.
+ */
+#define HEAP_ALIGNMENT 64
+
+struct heap_options {
+    size_t arity;
+    const struct allocator *allocator;
+};
+
 struct heap {
     int (*comparator)(const void *, const void *);
     void **nodes;
     size_t capacity;
     size_t size;
+    const struct allocator *allocator;
+    size_t arity;
+    void *block;
 };
 
 struct heap *heap_create(int (*comparator)(const void *, const void *));
 
+struct heap *
+heap_create_with_allocator(int (*comparator)(const void *, const void *),
+                           const struct allocator *allocator);
+
+struct heap *
+heap_create_with_options(int (*comparator)(const void *, const void *),
+                         struct heap_options *options);
+
+struct heap *heap_create_from(int (*comparator)(const void *, const void *),
+                              void **items, size_t count);
+
 void heap_destroy(struct heap *this);
 
 struct heap *heap_clone(struct heap *this);
@@ -22,8 +47,14 @@ void heap_clear(struct heap *this);
 
 bool heap_push(struct heap *this, void *item);
 
+bool heap_push_many(struct heap *this, void **items, size_t count);
+
 void *heap_pop(struct heap *this);
 
+void *heap_peek(struct heap *this);
+
+size_t heap_top_k(struct heap *this, size_t k, void **out);
+
 bool heap_merge(struct heap *this, struct heap *other);
 
 struct iterator *heap_iterator(struct heap *this);
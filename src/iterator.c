@@ -20,7 +20,22 @@
  */
 struct iterator *iterator_create(void *iterable,
                                  void *(*next)(struct iterator *)) {
-    struct iterator *this = calloc(1, sizeof(struct iterator));
+    return iterator_create_with_allocator(iterable, next, &allocator_libc);
+}
+
+/* Create an iterator whose memory is provided by an allocator. Data
+ * structures use this to allocate iterators with their own allocator.
+ *
+ * iterable  - The data structure providing the items through which to iterate.
+ * next      - The function that provides the next item in the iterator loop.
+ * allocator - The allocator that provides the iterator's memory.
+ *
+ * Returns the iterator or null if memory allocation failed.
+ */
+struct iterator *
+iterator_create_with_allocator(void *iterable, void *(*next)(struct iterator *),
+                               const struct allocator *allocator) {
+    struct iterator *this = allocator_alloc(allocator, sizeof(struct iterator));
     if (!this) {
         return NULL;
     }
@@ -29,11 +44,44 @@ struct iterator *iterator_create(void *iterable,
     this->iterable = iterable;
     this->current = NULL;
     this->next = next;
+    this->next_batch = iterator_next_batch;
     this->destroy = iterator_destroy;
+    this->allocator = allocator;
 
     return this;
 }
 
+/* Copy up to `max` items into a buffer by calling the iterator's `next`
+ * function for each one. This is the default implementation of the
+ * `iter->next_batch()` function pointer. Data structures replace it with one
+ * that fills the buffer without an indirect call per item.
+ *
+ * After each batch, `current` is the last item copied or null once the end
+ * has been reached, and `index` is the same as if each item had been fetched
+ * with `next`, so the two may be mixed.
+ *
+ * this - The iterator to advance.
+ * out  - The buffer to fill with at least `max` slots.
+ * max  - The maximum number of items to copy.
+ *
+ * Examples
+ *
+ *   void *items[64];
+ *   size_t count;
+ *   while ((count = iter->next_batch(iter, items, 64))) {
+ *       process(items, count);
+ *   }
+ *
+ * Returns the number of items copied, or zero when iteration is complete.
+ */
+size_t iterator_next_batch(struct iterator *this, void **out, size_t max) {
+    size_t count = 0;
+    while (count < max && this->next(this)) {
+        out[count++] = this->current;
+    }
+    return count;
+}
+
 /* Free the memory allocated for the iterator. This is typically invoked
  * through the `iter->destroy(iter)` function pointer. Iterator implementations
  * that allocate additional memory can provide their own destructor function
@@ -46,8 +94,9 @@ struct iterator *iterator_create(void *iterable,
 void iterator_destroy(struct iterator *this) {
     this->index = 0;
     this->next = NULL;
+    this->next_batch = NULL;
     this->destroy = NULL;
     this->current = NULL;
     this->iterable = NULL;
-    free(this);
+    allocator_free(this->allocator, this, sizeof(struct iterator));
 }
@@ -1,6 +1,7 @@
 #ifndef ITERATOR_H
 #define ITERATOR_H
 
+#include "allocator.h"
 #include <stdlib.h>
 
 struct iterator {
@@ -8,12 +9,20 @@ struct iterator {
     void *iterable;
     void *current;
     void *(*next)(struct iterator *this);
+    size_t (*next_batch)(struct iterator *this, void **out, size_t max);
     void (*destroy)(struct iterator *this);
+    const struct allocator *allocator;
 };
 
 struct iterator *iterator_create(void *iterable,
                                  void *(*next)(struct iterator *));
 
+struct iterator *
+iterator_create_with_allocator(void *iterable, void *(*next)(struct iterator *),
+                               const struct allocator *allocator);
+
+size_t iterator_next_batch(struct iterator *this, void **out, size_t max);
+
 void iterator_destroy(struct iterator *this);
 
 #endif
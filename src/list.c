@@ -1,17 +1,30 @@
 #include "list.h"
 
 static void *list_next_node(struct iterator *this);
+static size_t list_next_batch(struct iterator *this, void **out, size_t max);
 
 /* Allocate memory for a new linked list instance.
  *
  * Returns the new list or null if memory allocation failed.
  */
 struct list *list_create() {
-    struct list *this = calloc(1, sizeof(struct list));
+    return list_create_with_allocator(&allocator_libc);
+}
+
+/* Allocate memory for a new linked list whose nodes and iterators are provided
+ * by an allocator.
+ *
+ * allocator - The allocator to use for all of the list's memory.
+ *
+ * Returns the new list or null if memory allocation failed.
+ */
+struct list *list_create_with_allocator(const struct allocator *allocator) {
+    struct list *this = allocator_alloc(allocator, sizeof(struct list));
     if (!this) {
         return NULL;
     }
 
+    this->allocator = allocator;
     this->head = NULL;
     this->tail = NULL;
     this->length = 0;
@@ -28,7 +41,7 @@ struct list *list_create() {
  */
 void list_destroy(struct list *this) {
     list_clear(this);
-    free(this);
+    allocator_free(this->allocator, this, sizeof(struct list));
 }
 
 /* Copy the list contents into a new list. Future modifications to either list
@@ -39,7 +52,7 @@ void list_destroy(struct list *this) {
  * Returns a new list or null if memory allocation failed.
  */
 struct list *list_clone(struct list *this) {
-    struct list *clone = list_create();
+    struct list *clone = list_create_with_allocator(this->allocator);
     if (!clone) {
         return NULL;
     }
@@ -67,7 +80,7 @@ void list_clear(struct list *this) {
     struct lnode *node = this->head;
     while (node) {
         struct lnode *next = node->next;
-        free(node);
+        allocator_free(this->allocator, node, sizeof(struct lnode));
         node = next;
     }
 
@@ -103,7 +116,7 @@ bool list_concat(struct list *this, struct list *other) {
  * Returns false if memory allocation failed.
  */
 bool list_push(struct list *this, void *item) {
-    struct lnode *node = calloc(1, sizeof(struct lnode));
+    struct lnode *node = allocator_alloc(this->allocator, sizeof(struct lnode));
     if (!node) {
         return false;
     }
@@ -149,7 +162,7 @@ void *list_pop(struct list *this) {
     this->length--;
 
     void *item = node->value;
-    free(node);
+    allocator_free(this->allocator, node, sizeof(struct lnode));
     return item;
 }
 
@@ -161,7 +174,7 @@ void *list_pop(struct list *this) {
  * Returns false if memory allocation failed.
  */
 bool list_unshift(struct list *this, void *item) {
-    struct lnode *node = calloc(1, sizeof(struct lnode));
+    struct lnode *node = allocator_alloc(this->allocator, sizeof(struct lnode));
     if (!node) {
         return false;
     }
@@ -208,7 +221,7 @@ void *list_shift(struct list *this) {
     this->length--;
 
     void *item = node->value;
-    free(node);
+    allocator_free(this->allocator, node, sizeof(struct lnode));
     return item;
 }
 
@@ -254,5 +267,39 @@ void *list_next_node(struct iterator *this) {
  * Returns an iterator or null if memory allocation failed.
  */
 struct iterator *list_iterator(struct list *this) {
-    return iterator_create(this->head, list_next_node);
+    struct iterator *nodes = iterator_create_with_allocator(
+        this->head, list_next_node, this->allocator);
+    if (nodes) {
+        nodes->next_batch = list_next_batch;
+    }
+    return nodes;
+}
+
+/* Private: Copy the values of the next run of list nodes. This is the
+ * function pointer used to implement `iter->next_batch()`.
+ *
+ * this - The iterator to advance.
+ * out  - The buffer to fill.
+ * max  - The maximum number of items to copy.
+ *
+ * Returns the number of items copied, or zero if iteration is complete.
+ */
+size_t list_next_batch(struct iterator *this, void **out, size_t max) {
+    struct lnode *node = this->iterable;
+
+    bool first = !this->current && this->index == 0;
+
+    size_t count = 0;
+    while (count < max && node) {
+        out[count++] = node->value;
+        node = node->next;
+    }
+
+    this->iterable = node;
+    if (count > 0) {
+        this->index += first ? count - 1 : count;
+    }
+    this->current = count == max && count > 0 ? out[count - 1] : NULL;
+
+    return count;
 }
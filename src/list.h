@@ -1,6 +1,7 @@
 #ifndef LIST_H
 #define LIST_H
 
+#include "allocator.h"
 #include "iterator.h"
 #include <stdbool.h>
 #include <stdlib.h>
@@ -15,10 +16,38 @@ struct list {
     struct lnode *head;
     struct lnode *tail;
     size_t length;
+    const struct allocator *allocator;
 };
 
+/* An iterator that lives on the caller's stack. Unlike `list_iterator`, it
+ * needs no allocation and its inline `next` function needs no indirect call.
+ * It holds the node after the current one, so the current node may be
+ * unlinked during the loop.
+ */
+struct list_iter {
+    struct lnode *node;
+    void *current;
+};
+
+/* Loop over each item in a list, assigning it to `item`, which must be
+ * declared before the loop. Nodes must not be removed in the loop.
+ *
+ * Examples
+ *
+ *   char *name;
+ *   LIST_FOREACH(name, list) {
+ *       printf("name: %s\n", name);
+ *   }
+ */
+#define LIST_FOREACH(item, list)                                               \
+    for (struct lnode *item##_node = (list)->head;                             \
+         item##_node && ((item) = item##_node->value, 1);                      \
+         item##_node = item##_node->next)
+
 struct list *list_create(void);
 
+struct list *list_create_with_allocator(const struct allocator *allocator);
+
 void list_destroy(struct list *this);
 
 struct list *list_clone(struct list *this);
@@ -37,4 +66,33 @@ void list_clear(struct list *this);
 
 struct iterator *list_iterator(struct list *this);
 
+/* Start a stack iterator at the head of a list.
+ *
+ * this - The iterator to initialize.
+ * list - The list to iterate through.
+ *
+ * Returns nothing.
+ */
+static inline void list_iter_init(struct list_iter *this, struct list *list) {
+    this->node = list->head;
+    this->current = NULL;
+}
+
+/* Advance a stack iterator to the next item, storing it in `current`. Null
+ * items are returned like any other.
+ *
+ * this - The iterator to advance.
+ *
+ * Returns false when iteration is complete.
+ */
+static inline bool list_iter_next(struct list_iter *this) {
+    if (!this->node) {
+        this->current = NULL;
+        return false;
+    }
+    this->current = this->node->value;
+    this->node = this->node->next;
+    return true;
+}
+
 #endif
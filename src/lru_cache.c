@@ -0,0 +1,247 @@
+#include "lru_cache.h"
+#include <errno.h>
+
+static size_t lru_cache_weigh(struct lru_cache *this, struct hkey *key,
+                              void *value);
+static bool lru_cache_full(struct lru_cache *this);
+static void lru_cache_evict(struct lru_cache *this);
+
+/* Allocate and initialize memory for a new cache holding at most a number of
+ * entries. Storing a key in a full cache evicts the least recently used one.
+ * The cache must be freed later with a call to `lru_cache_destroy`.
+ *
+ * max_entries - The largest number of entries to keep, or zero for no limit.
+ *
+ * Returns the cache or null if allocation failed.
+ */
+struct lru_cache *lru_cache_create(size_t max_entries) {
+    struct lru_cache_options options = {0};
+    options.max_entries = max_entries;
+    return lru_cache_create_with_options(&options);
+}
+
+/* Allocate and initialize memory for a new cache configured with non-default
+ * options. The cache must be freed later with a call to `lru_cache_destroy`.
+ *
+ * Entries live in one `struct hashmap`, whose insertion ordered entry list
+ * doubles as the recency list: lookups move an entry to the tail and
+ * evictions take the head, so the cache costs no memory or lookups beyond
+ * the map's own.
+ *
+ * options - The cache configuration. The `max_entries` and `max_bytes` fields
+ *           bound the number of entries and their total weight, or are zero
+ *           for no limit. The `weigh` function returns an entry's weight in
+ *           bytes, or is null to weigh entries by key length. It must return
+ *           the same weight for a key and value each time it's called. The
+ *           `evict` function is called with the `context` for each evicted
+ *           entry, so its value can be freed, and may be null. The `flags`
+ *           and `allocator` fields configure the underlying hashmap.
+ *
+ * Examples
+ *
+ *   struct lru_cache_options options = {0};
+ *   options.max_bytes = 1 << 20;
+ *   options.weigh = page_size;
+ *   options.evict = page_free;
+ *   struct lru_cache *cache = lru_cache_create_with_options(&options);
+ *
+ * Returns the cache or null if allocation failed or the hashmap options
+ * conflict.
+ */
+struct lru_cache *
+lru_cache_create_with_options(struct lru_cache_options *options) {
+    struct hashmap_options map_options = {0};
+    map_options.flags = options->flags;
+    map_options.allocator = options->allocator;
+
+    struct hashmap *map = hashmap_create_with_options(&map_options);
+    if (!map) {
+        return NULL;
+    }
+
+    struct lru_cache *this =
+        allocator_alloc(map->allocator, sizeof(struct lru_cache));
+    if (!this) {
+        hashmap_destroy(map);
+        return NULL;
+    }
+
+    this->map = map;
+    this->max_entries = options->max_entries;
+    this->max_bytes = options->max_bytes;
+    this->bytes = 0;
+    this->weigh = options->weigh;
+    this->evict = options->evict;
+    this->context = options->context;
+
+    return this;
+}
+
+/* Free the memory associated with this cache. Every remaining entry is
+ * passed to the eviction function first, as with `lru_cache_clear`.
+ *
+ * this - The cache to free.
+ *
+ * Returns nothing.
+ */
+void lru_cache_destroy(struct lru_cache *this) {
+    struct hashmap *map = this->map;
+    lru_cache_clear(this);
+    allocator_free(map->allocator, this, sizeof(struct lru_cache));
+    hashmap_destroy(map);
+}
+
+/* Retrieve the value stored at the key, marking it as the most recently used
+ * entry.
+ *
+ * this - The cache from which to retrieve the value.
+ * key  - The key to look up in the cache.
+ *
+ * Returns the value or null if not found.
+ */
+void *lru_cache_get(struct lru_cache *this, struct hkey *key) {
+    void **value = hashmap_touch(this->map, key);
+    return value ? *value : NULL;
+}
+
+/* Retrieve the value stored at the key without changing its recency.
+ *
+ * this - The cache from which to retrieve the value.
+ * key  - The key to look up in the cache.
+ *
+ * Returns the value or null if not found.
+ */
+void *lru_cache_peek(struct lru_cache *this, struct hkey *key) {
+    return hashmap_get(this->map, key);
+}
+
+/* Store the key/value pair in the cache as its most recently used entry,
+ * then evict the least recently used entries until the cache is within its
+ * bounds. An entry that alone exceeds the byte limit is evicted as well.
+ *
+ * this  - The cache in which to store the value.
+ * key   - The key to store, copied into the cache.
+ * value - The value to store.
+ *
+ * Returns the value previously stored at the key or null. The replaced value
+ * isn't passed to the eviction function and must be freed by the caller, as
+ * needed. The `errno` global is set to non-zero if the set failed, zero if
+ * the value was stored successfully.
+ */
+void *lru_cache_set(struct lru_cache *this, struct hkey *key, void *value) {
+    bool inserted;
+    void **stored = hashmap_touch_entry(this->map, key, &inserted);
+    if (!stored) {
+        return NULL;
+    }
+
+    void *replaced = *stored;
+    if (!inserted) {
+        this->bytes -= lru_cache_weigh(this, key, replaced);
+    }
+    *stored = value;
+    this->bytes += lru_cache_weigh(this, key, value);
+
+    while (this->map->head && lru_cache_full(this)) {
+        lru_cache_evict(this);
+    }
+
+    errno = 0;
+    return replaced;
+}
+
+/* Determine if the key is stored in the cache without changing its recency.
+ *
+ * this - The cache to query.
+ * key  - The key to find.
+ *
+ * Returns true if the key is stored in the cache.
+ */
+bool lru_cache_contains(struct lru_cache *this, struct hkey *key) {
+    return hashmap_contains(this->map, key);
+}
+
+/* Remove the value stored at the key. The value isn't passed to the eviction
+ * function and must be freed by the caller, as needed.
+ *
+ * this - The cache from which to remove the key/value pair.
+ * key  - The key whose value should be discarded.
+ *
+ * Returns the stored value or null if the key didn't exist.
+ */
+void *lru_cache_remove(struct lru_cache *this, struct hkey *key) {
+    /* Null values are stored like any other, so a change in size, not the
+     * result, tells whether the key was removed.
+     */
+    size_t size = this->map->size;
+    void *value = hashmap_remove(this->map, key);
+    if (this->map->size < size) {
+        this->bytes -= lru_cache_weigh(this, key, value);
+    }
+    return value;
+}
+
+/* Evict every entry from the cache, least recently used first, passing each
+ * one to the eviction function.
+ *
+ * this - The cache to empty.
+ *
+ * Returns nothing.
+ */
+void lru_cache_clear(struct lru_cache *this) {
+    if (this->evict) {
+        for (struct hentry *entry = this->map->head; entry;
+             entry = entry->next) {
+            this->evict(&entry->key, entry->value, this->context);
+        }
+    }
+    hashmap_clear(this->map);
+    this->bytes = 0;
+}
+
+/* Private: Weigh an entry for the cache's byte limit.
+ *
+ * this  - The cache holding the entry.
+ * key   - The entry's key.
+ * value - The entry's value.
+ *
+ * Returns the entry's weight in bytes.
+ */
+size_t lru_cache_weigh(struct lru_cache *this, struct hkey *key,
+                       void *value) {
+    return this->weigh ? this->weigh(key, value) : key->length;
+}
+
+/* Private: Determine if the cache holds more entries or bytes than its limits
+ * allow.
+ *
+ * this - The cache to check.
+ *
+ * Returns true if an entry must be evicted.
+ */
+bool lru_cache_full(struct lru_cache *this) {
+    if (this->max_entries && this->map->size > this->max_entries) {
+        return true;
+    }
+    return this->max_bytes && this->bytes > this->max_bytes;
+}
+
+/* Private: Remove the least recently used entry, at the head of the map's
+ * entry list, and pass it to the eviction function.
+ *
+ * this - The cache to evict from.
+ *
+ * Returns nothing.
+ */
+void lru_cache_evict(struct lru_cache *this) {
+    struct hentry *oldest = this->map->head;
+    struct hkey key = oldest->key;
+    uint64_t hash = oldest->hash;
+    void *value = oldest->value;
+
+    this->bytes -= lru_cache_weigh(this, &key, value);
+    if (this->evict) {
+        this->evict(&key, value, this->context);
+    }
+    hashmap_remove_hashed(this->map, &key, hash);
+}
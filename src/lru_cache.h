@@ -0,0 +1,47 @@
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include "hashmap.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+struct lru_cache_options {
+    size_t max_entries;
+    size_t max_bytes;
+    size_t (*weigh)(struct hkey *key, void *value);
+    void (*evict)(struct hkey *key, void *value, void *context);
+    void *context;
+    unsigned long flags;
+    const struct allocator *allocator;
+};
+
+struct lru_cache {
+    struct hashmap *map;
+    size_t max_entries;
+    size_t max_bytes;
+    size_t bytes;
+    size_t (*weigh)(struct hkey *key, void *value);
+    void (*evict)(struct hkey *key, void *value, void *context);
+    void *context;
+};
+
+struct lru_cache *lru_cache_create(size_t max_entries);
+
+struct lru_cache *
+lru_cache_create_with_options(struct lru_cache_options *options);
+
+void lru_cache_destroy(struct lru_cache *this);
+
+void *lru_cache_get(struct lru_cache *this, struct hkey *key);
+
+void *lru_cache_peek(struct lru_cache *this, struct hkey *key);
+
+void *lru_cache_set(struct lru_cache *this, struct hkey *key, void *value);
+
+bool lru_cache_contains(struct lru_cache *this, struct hkey *key);
+
+void *lru_cache_remove(struct lru_cache *this, struct hkey *key);
+
+void lru_cache_clear(struct lru_cache *this);
+
+#endif
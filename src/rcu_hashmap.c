@@ -0,0 +1,529 @@
+#include "rcu_hashmap.h"
+#include <errno.h>
+#include <string.h>
+
+/* Readers and writers publish pointers and epochs with the `__atomic`
+ * builtins of gcc and clang. C99 has no portable atomics, so other compilers
+ * are refused here rather than failing on an undeclared function.
+ */
+#if !defined(__GNUC__)
+#error "rcu_hashmap requires the __atomic builtins of gcc or clang"
+#endif
+
+#define MAX_LOAD_FACTOR .75
+
+/* The number of buckets in a new map.
+ */
+#define MIN_CAPACITY 16
+
+/* Bytes of unused space after each reader's epoch, so two readers' records
+ * never share a cache line.
+ */
+#define RREADER_PADDING 64
+
+/* Memory retired by a writer, freed once no reader can still hold it. It is
+ * the first member of every entry and table.
+ */
+struct rretire {
+    struct rretire *next;
+    uint64_t epoch;
+    size_t size;
+};
+
+struct rentry {
+    struct rretire retire;
+    struct rentry *chain;
+    uint64_t hash;
+    void *value;
+    size_t length;
+    unsigned char key[];
+};
+
+struct rtable {
+    struct rretire retire;
+    size_t capacity;
+    struct rentry *buckets[];
+};
+
+/* A reader thread's record. The epoch is zero outside of a lookup, and
+ * otherwise the map's epoch when the lookup started.
+ */
+struct rreader {
+    uint64_t epoch;
+    struct rreader *next;
+    unsigned char padding[RREADER_PADDING];
+};
+
+static struct rentry *rcu_hashmap_find(struct rcu_hashmap *this,
+                                       struct rreader *reader,
+                                       struct hkey *key);
+static bool rcu_hashmap_resize(struct rcu_hashmap *this, size_t capacity);
+static void rcu_hashmap_retire(struct rcu_hashmap *this,
+                               struct rretire *memory);
+static void rcu_hashmap_reclaim(struct rcu_hashmap *this);
+
+static struct rtable *rtable_create(struct rcu_hashmap *map, size_t capacity);
+static struct rentry *rentry_create(struct rcu_hashmap *map, const void *key,
+                                    size_t length, uint64_t hash, void *value);
+static bool rentry_equals(struct rentry *entry, struct hkey *key,
+                          uint64_t hash);
+
+/* Allocate and initialize memory for a new read-mostly hashmap. Lookups take
+ * no locks and make no atomic read-modify-write operations, so readers on
+ * different cores never contend with each other. Writers are serialized by
+ * a mutex and publish changes with release stores. Removed entries and
+ * replaced bucket arrays are freed once every reader that could have seen
+ * them has finished. The map must be freed later with a call to
+ * `rcu_hashmap_destroy`.
+ *
+ * Each reading thread registers once with `rcu_hashmap_register` and passes
+ * its reader to lookups.
+ *
+ * Examples
+ *
+ *   struct rreader *reader = rcu_hashmap_register(map);
+ *   char *found = rcu_hashmap_get(map, reader, &key);
+ *   rcu_hashmap_unregister(map, reader);
+ *
+ * Returns the map or null if allocation failed.
+ */
+struct rcu_hashmap *rcu_hashmap_create(void) {
+    return rcu_hashmap_create_with_allocator(&allocator_libc);
+}
+
+/* Allocate and initialize memory for a new read-mostly hashmap whose memory
+ * is provided by an allocator. The map must be freed later with a call to
+ * `rcu_hashmap_destroy`.
+ *
+ * allocator - The allocator to use for all of the map's memory. Only writers
+ *             call it, one at a time.
+ *
+ * Returns the map or null if allocation failed.
+ */
+struct rcu_hashmap *
+rcu_hashmap_create_with_allocator(const struct allocator *allocator) {
+    struct rcu_hashmap *this =
+        allocator_alloc(allocator, sizeof(struct rcu_hashmap));
+    if (!this) {
+        return NULL;
+    }
+
+    this->allocator = allocator;
+    this->readers = NULL;
+    this->retired = NULL;
+    this->epoch = 1;
+    this->size = 0;
+    this->table = rtable_create(this, MIN_CAPACITY);
+    if (!this->table) {
+        allocator_free(allocator, this, sizeof(struct rcu_hashmap));
+        return NULL;
+    }
+
+    int error = pthread_mutex_init(&this->lock, NULL);
+    if (error) {
+        allocator_free(allocator, this->table, this->table->retire.size);
+        allocator_free(allocator, this, sizeof(struct rcu_hashmap));
+        errno = error;
+        return NULL;
+    }
+
+    return this;
+}
+
+/* Free the memory associated with this map, including any readers still
+ * registered. No other thread may be using the map. The values stored in
+ * the map are not freed.
+ *
+ * this - The map to free.
+ *
+ * Returns nothing.
+ */
+void rcu_hashmap_destroy(struct rcu_hashmap *this) {
+    struct rtable *table = this->table;
+    for (size_t i = 0; i < table->capacity; i++) {
+        struct rentry *entry = table->buckets[i];
+        while (entry) {
+            struct rentry *chain = entry->chain;
+            allocator_free(this->allocator, entry, entry->retire.size);
+            entry = chain;
+        }
+    }
+    allocator_free(this->allocator, table, table->retire.size);
+
+    struct rretire *retired = this->retired;
+    while (retired) {
+        struct rretire *next = retired->next;
+        allocator_free(this->allocator, retired, retired->size);
+        retired = next;
+    }
+
+    struct rreader *reader = this->readers;
+    while (reader) {
+        struct rreader *next = reader->next;
+        allocator_free(this->allocator, reader, sizeof(struct rreader));
+        reader = next;
+    }
+
+    pthread_mutex_destroy(&this->lock);
+    allocator_free(this->allocator, this, sizeof(struct rcu_hashmap));
+}
+
+/* Register the calling thread as a reader of this map. A reader may be used
+ * by one thread at a time, and must be unregistered before the thread exits
+ * or stops reading, or memory removed from the map is never freed.
+ *
+ * this - The map to read.
+ *
+ * Returns the reader or null if allocation failed.
+ */
+struct rreader *rcu_hashmap_register(struct rcu_hashmap *this) {
+    pthread_mutex_lock(&this->lock);
+    struct rreader *reader =
+        allocator_alloc(this->allocator, sizeof(struct rreader));
+    if (reader) {
+        reader->epoch = 0;
+        reader->next = this->readers;
+        this->readers = reader;
+    }
+    pthread_mutex_unlock(&this->lock);
+    return reader;
+}
+
+/* Unregister a reader and free its memory. The reader must not be in use.
+ *
+ * this   - The map the reader was registered with.
+ * reader - The reader to free.
+ *
+ * Returns nothing.
+ */
+void rcu_hashmap_unregister(struct rcu_hashmap *this, struct rreader *reader) {
+    pthread_mutex_lock(&this->lock);
+    struct rreader **link = &this->readers;
+    while (*link != reader) {
+        link = &(*link)->next;
+    }
+    *link = reader->next;
+    allocator_free(this->allocator, reader, sizeof(struct rreader));
+    rcu_hashmap_reclaim(this);
+    pthread_mutex_unlock(&this->lock);
+}
+
+/* Retrieve the value stored at the key without taking a lock.
+ *
+ * this   - The map from which to retrieve the value.
+ * reader - The calling thread's registered reader.
+ * key    - The key to look up in the map.
+ *
+ * Returns the value or null if not found.
+ */
+void *rcu_hashmap_get(struct rcu_hashmap *this, struct rreader *reader,
+                      struct hkey *key) {
+    struct rentry *entry = rcu_hashmap_find(this, reader, key);
+    void *value = NULL;
+    if (entry) {
+        value = __atomic_load_n(&entry->value, __ATOMIC_ACQUIRE);
+    }
+    __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+    return value;
+}
+
+/* Determine if the key is contained within the map without taking a lock.
+ *
+ * this   - The map to query.
+ * reader - The calling thread's registered reader.
+ * key    - The key to find.
+ *
+ * Returns true if the key is stored in the map.
+ */
+bool rcu_hashmap_contains(struct rcu_hashmap *this, struct rreader *reader,
+                          struct hkey *key) {
+    bool found = rcu_hashmap_find(this, reader, key) != NULL;
+    __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+    return found;
+}
+
+/* Store the key/value pair in the map. Writers wait for each other but
+ * never for readers. Lookups running concurrently see either the old or the
+ * new value.
+ *
+ * this  - The map in which to store the value.
+ * key   - The key to store, copied into the map.
+ * value - The value to store.
+ *
+ * Returns the previous value or null. The `errno` global is set to non-zero if
+ * the set failed, zero if the value was stored successfully.
+ */
+void *rcu_hashmap_set(struct rcu_hashmap *this, struct hkey *key, void *value) {
+    uint64_t hash = hkey_hash(key->data, key->length);
+
+    pthread_mutex_lock(&this->lock);
+    struct rtable *table = this->table;
+    struct rentry **bucket = &table->buckets[hash & (table->capacity - 1)];
+
+    struct rentry *entry = *bucket;
+    while (entry && !rentry_equals(entry, key, hash)) {
+        entry = entry->chain;
+    }
+
+    errno = 0;
+    void *evicted = NULL;
+    if (entry) {
+        evicted = entry->value;
+        __atomic_store_n(&entry->value, value, __ATOMIC_RELEASE);
+    } else {
+        entry = rentry_create(this, key->data, key->length, hash, value);
+        if (entry) {
+            entry->chain = *bucket;
+            __atomic_store_n(bucket, entry, __ATOMIC_RELEASE);
+            this->size++;
+
+            double load = (double)this->size / (double)table->capacity;
+            if (load > MAX_LOAD_FACTOR) {
+                rcu_hashmap_resize(this, table->capacity * 2);
+            }
+        } else {
+            errno = ENOMEM;
+        }
+    }
+
+    int error = errno;
+    pthread_mutex_unlock(&this->lock);
+    errno = error;
+    return evicted;
+}
+
+/* Remove the value stored under the key. The entry's memory is freed once
+ * no lookup can still be reading it. The value memory is not released by
+ * this function. The caller should free the value if needed.
+ *
+ * this - The map from which to remove the key/value pair.
+ * key  - The key whose value should be discarded.
+ *
+ * Returns the stored value or null if the key didn't exist.
+ */
+void *rcu_hashmap_remove(struct rcu_hashmap *this, struct hkey *key) {
+    uint64_t hash = hkey_hash(key->data, key->length);
+
+    pthread_mutex_lock(&this->lock);
+    struct rtable *table = this->table;
+    struct rentry **link = &table->buckets[hash & (table->capacity - 1)];
+    while (*link && !rentry_equals(*link, key, hash)) {
+        link = &(*link)->chain;
+    }
+
+    struct rentry *entry = *link;
+    void *value = NULL;
+    if (entry) {
+        value = entry->value;
+        __atomic_store_n(link, entry->chain, __ATOMIC_SEQ_CST);
+        this->size--;
+        rcu_hashmap_retire(this, &entry->retire);
+        rcu_hashmap_reclaim(this);
+    }
+
+    pthread_mutex_unlock(&this->lock);
+    return value;
+}
+
+/* Private: Start a lookup and find the entry for a key. The reader records
+ * the map's current epoch before loading any pointers, and the caller must
+ * clear it once it has finished reading the entry. The epoch store and the
+ * pointer loads are sequentially consistent so a writer either sees the
+ * reader's epoch or the reader sees the writer's unlink. On x86 and ARM these
+ * loads compile to plain or acquire loads, and the only store is to the
+ * reader's own cache line.
+ *
+ * this   - The map to search.
+ * reader - The calling thread's registered reader.
+ * key    - The key to find.
+ *
+ * Returns the entry or null if not found.
+ */
+struct rentry *rcu_hashmap_find(struct rcu_hashmap *this,
+                                struct rreader *reader, struct hkey *key) {
+    uint64_t hash = hkey_hash(key->data, key->length);
+
+    uint64_t epoch = __atomic_load_n(&this->epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&reader->epoch, epoch, __ATOMIC_SEQ_CST);
+
+    struct rtable *table = __atomic_load_n(&this->table, __ATOMIC_SEQ_CST);
+    struct rentry *entry = __atomic_load_n(
+        &table->buckets[hash & (table->capacity - 1)], __ATOMIC_SEQ_CST);
+    while (entry && !rentry_equals(entry, key, hash)) {
+        entry = __atomic_load_n(&entry->chain, __ATOMIC_SEQ_CST);
+    }
+    return entry;
+}
+
+/* Private: Copy every entry into a larger bucket array and publish it. The
+ * old array and entries are retired rather than relinked, because lookups
+ * may still be walking their chains. The map keeps its old buckets if
+ * memory allocation fails.
+ *
+ * this     - The map to resize, with its writer lock held.
+ * capacity - The new number of buckets.
+ *
+ * Returns true if the resize succeeded.
+ */
+bool rcu_hashmap_resize(struct rcu_hashmap *this, size_t capacity) {
+    struct rtable *old = this->table;
+    struct rtable *table = rtable_create(this, capacity);
+    if (!table) {
+        return false;
+    }
+
+    for (size_t i = 0; i < old->capacity; i++) {
+        for (struct rentry *entry = old->buckets[i]; entry;
+             entry = entry->chain) {
+            struct rentry *copy =
+                rentry_create(this, entry->key, entry->length, entry->hash,
+                              entry->value);
+            if (!copy) {
+                for (size_t j = 0; j < capacity; j++) {
+                    struct rentry *created = table->buckets[j];
+                    while (created) {
+                        struct rentry *chain = created->chain;
+                        allocator_free(this->allocator, created,
+                                       created->retire.size);
+                        created = chain;
+                    }
+                }
+                allocator_free(this->allocator, table, table->retire.size);
+                return false;
+            }
+
+            struct rentry **bucket =
+                &table->buckets[copy->hash & (capacity - 1)];
+            copy->chain = *bucket;
+            *bucket = copy;
+        }
+    }
+
+    __atomic_store_n(&this->table, table, __ATOMIC_SEQ_CST);
+
+    for (size_t i = 0; i < old->capacity; i++) {
+        struct rentry *entry = old->buckets[i];
+        while (entry) {
+            struct rentry *chain = entry->chain;
+            rcu_hashmap_retire(this, &entry->retire);
+            entry = chain;
+        }
+    }
+    rcu_hashmap_retire(this, &old->retire);
+    rcu_hashmap_reclaim(this);
+
+    return true;
+}
+
+/* Private: Queue memory that has been unlinked from the map to be freed
+ * once every lookup that might have seen it has finished.
+ *
+ * this   - The map, with its writer lock held.
+ * memory - The entry or table to retire.
+ *
+ * Returns nothing.
+ */
+void rcu_hashmap_retire(struct rcu_hashmap *this, struct rretire *memory) {
+    memory->epoch = this->epoch;
+    memory->next = this->retired;
+    this->retired = memory;
+}
+
+/* Private: Advance the map's epoch and free retired memory that no reader
+ * can still hold. A reader that started in an epoch after the memory was
+ * retired loaded its pointers after the memory was unlinked, so only
+ * readers from that epoch or earlier need to finish first.
+ *
+ * this - The map, with its writer lock held.
+ *
+ * Returns nothing.
+ */
+void rcu_hashmap_reclaim(struct rcu_hashmap *this) {
+    if (!this->retired) {
+        return;
+    }
+
+    __atomic_store_n(&this->epoch, this->epoch + 1, __ATOMIC_SEQ_CST);
+
+    uint64_t oldest = UINT64_MAX;
+    for (struct rreader *reader = this->readers; reader;
+         reader = reader->next) {
+        uint64_t epoch = __atomic_load_n(&reader->epoch, __ATOMIC_SEQ_CST);
+        if (epoch && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    struct rretire **link = &this->retired;
+    while (*link) {
+        struct rretire *retired = *link;
+        if (retired->epoch < oldest) {
+            *link = retired->next;
+            allocator_free(this->allocator, retired, retired->size);
+        } else {
+            link = &retired->next;
+        }
+    }
+}
+
+/* Private: Allocate an empty bucket array.
+ *
+ * map      - The map that will own the array.
+ * capacity - The number of buckets, a power of two.
+ *
+ * Returns the table or null if allocation failed.
+ */
+struct rtable *rtable_create(struct rcu_hashmap *map, size_t capacity) {
+    size_t size = sizeof(struct rtable) + capacity * sizeof(struct rentry *);
+    struct rtable *this = allocator_alloc(map->allocator, size);
+    if (!this) {
+        return NULL;
+    }
+
+    this->retire.size = size;
+    this->capacity = capacity;
+    memset(this->buckets, 0, capacity * sizeof(struct rentry *));
+    return this;
+}
+
+/* Private: Allocate an entry holding a copy of the key bytes.
+ *
+ * map    - The map that will own the entry.
+ * key    - The key bytes to copy.
+ * length - The number of key bytes.
+ * hash   - The key's hash.
+ * value  - The value to store.
+ *
+ * Returns the entry or null if allocation failed.
+ */
+struct rentry *rentry_create(struct rcu_hashmap *map, const void *key,
+                             size_t length, uint64_t hash, void *value) {
+    size_t size = sizeof(struct rentry) + length;
+    struct rentry *this = allocator_alloc(map->allocator, size);
+    if (!this) {
+        return NULL;
+    }
+
+    this->retire.size = size;
+    this->chain = NULL;
+    this->hash = hash;
+    this->value = value;
+    this->length = length;
+    if (length) {
+        memcpy(this->key, key, length);
+    }
+    return this;
+}
+
+/* Private: Compare an entry's key with a lookup key.
+ *
+ * entry - The entry to check.
+ * key   - The key to find.
+ * hash  - The lookup key's hash.
+ *
+ * Returns true if the keys match.
+ */
+bool rentry_equals(struct rentry *entry, struct hkey *key, uint64_t hash) {
+    return entry->hash == hash && entry->length == key->length &&
+           memcmp(entry->key, key->data, key->length) == 0;
+}
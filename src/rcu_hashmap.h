@@ -0,0 +1,45 @@
+#ifndef RCU_HASHMAP_H
+#define RCU_HASHMAP_H
+
+#include "hashmap.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+struct rtable;
+struct rreader;
+struct rretire;
+
+struct rcu_hashmap {
+    struct rtable *table;
+    struct rreader *readers;
+    struct rretire *retired;
+    uint64_t epoch;
+    size_t size;
+    const struct allocator *allocator;
+    pthread_mutex_t lock;
+};
+
+struct rcu_hashmap *rcu_hashmap_create(void);
+
+struct rcu_hashmap *
+rcu_hashmap_create_with_allocator(const struct allocator *allocator);
+
+void rcu_hashmap_destroy(struct rcu_hashmap *this);
+
+struct rreader *rcu_hashmap_register(struct rcu_hashmap *this);
+
+void rcu_hashmap_unregister(struct rcu_hashmap *this, struct rreader *reader);
+
+void *rcu_hashmap_get(struct rcu_hashmap *this, struct rreader *reader,
+                      struct hkey *key);
+
+bool rcu_hashmap_contains(struct rcu_hashmap *this, struct rreader *reader,
+                          struct hkey *key);
+
+void *rcu_hashmap_set(struct rcu_hashmap *this, struct hkey *key, void *value);
+
+void *rcu_hashmap_remove(struct rcu_hashmap *this, struct hkey *key);
+
+#endif
@@ -3,6 +3,7 @@
 
 static bool vector_resize(struct vector *this, size_t capacity);
 static void *vector_next_item(struct iterator *this);
+static size_t vector_next_batch(struct iterator *this, void **out, size_t max);
 
 /* Allocate memory for a new vector. The memory must be freed with a
  * subsequent call to `vector_destroy`.
@@ -10,11 +11,24 @@ static void *vector_next_item(struct iterator *this);
  * Returns the vector or null if memory allocation failed.
  */
 struct vector *vector_create() {
-    struct vector *this = calloc(1, sizeof(struct vector));
+    return vector_create_with_allocator(&allocator_libc);
+}
+
+/* Allocate memory for a new vector whose memory, including its item storage
+ * and iterators, is provided by an allocator. The memory must be freed with a
+ * subsequent call to `vector_destroy`.
+ *
+ * allocator - The allocator to use for all of the vector's memory.
+ *
+ * Returns the vector or null if memory allocation failed.
+ */
+struct vector *vector_create_with_allocator(const struct allocator *allocator) {
+    struct vector *this = allocator_alloc(allocator, sizeof(struct vector));
     if (!this) {
         return NULL;
     }
 
+    this->allocator = allocator;
     this->items = NULL;
     this->length = 0;
     this->capacity = 0;
@@ -36,9 +50,10 @@ struct vector *vector_create() {
  */
 void vector_destroy(struct vector *this) {
     vector_clear(this);
+    allocator_free(this->allocator, this->items,
+                   this->capacity * sizeof(void *));
     this->capacity = 0;
-    free(this->items);
-    free(this);
+    allocator_free(this->allocator, this, sizeof(struct vector));
 }
 
 /* Copy the vector's contents into a new vector instance. The clone instance
@@ -49,7 +64,7 @@ void vector_destroy(struct vector *this) {
  * Returns a new vector or null if memory allocation failed.
  */
 struct vector *vector_clone(struct vector *this) {
-    struct vector *clone = vector_create();
+    struct vector *clone = vector_create_with_allocator(this->allocator);
     if (!clone) {
         return NULL;
     }
@@ -181,7 +196,7 @@ bool vector_insert(struct vector *this, size_t index, void *item) {
  * Returns the vector subset or null if memory allocation failed.
  */
 struct vector *vector_slice(struct vector *this, size_t start, size_t length) {
-    struct vector *slice = vector_create();
+    struct vector *slice = vector_create_with_allocator(this->allocator);
     if (!slice) {
         return NULL;
     }
@@ -360,7 +375,12 @@ void vector_sort(struct vector *this,
  * Returns an iterator or null if memory allocation failed.
  */
 struct iterator *vector_iterator(struct vector *this) {
-    return iterator_create(this, vector_next_item);
+    struct iterator *items =
+        iterator_create_with_allocator(this, vector_next_item, this->allocator);
+    if (items) {
+        items->next_batch = vector_next_batch;
+    }
+    return items;
 }
 
 /* Private: Advance the iterator to the next item in the list.
@@ -372,7 +392,7 @@ struct iterator *vector_iterator(struct vector *this) {
 void *vector_next_item(struct iterator *this) {
     struct vector *list = this->iterable;
 
-    if (this->index == list->length) {
+    if (this->index >= list->length) {
         this->current = NULL;
     } else {
         this->current = list->items[this->index];
@@ -382,6 +402,30 @@ void *vector_next_item(struct iterator *this) {
     return this->current;
 }
 
+/* Private: Copy the next run of items straight out of the item array. This
+ * is the function pointer used to implement `iter->next_batch()`.
+ *
+ * this - The iterator to advance.
+ * out  - The buffer to fill.
+ * max  - The maximum number of items to copy.
+ *
+ * Returns the number of items copied, or zero if iteration is complete.
+ */
+size_t vector_next_batch(struct iterator *this, void **out, size_t max) {
+    struct vector *list = this->iterable;
+
+    size_t count = this->index < list->length ? list->length - this->index : 0;
+    if (count > max) {
+        count = max;
+    }
+
+    memcpy(out, list->items + this->index, count * sizeof(void *));
+    this->index += count;
+    this->current = count == max && count > 0 ? out[count - 1] : NULL;
+
+    return count;
+}
+
 /* Private: Allocate memory to store list item pointers.
  *
  * this     - The list to resize.
@@ -390,7 +434,9 @@ void *vector_next_item(struct iterator *this) {
  * Returns false if memory allocation failed.
  */
 bool vector_resize(struct vector *this, size_t capacity) {
-    void **items = realloc(this->items, capacity * sizeof(void *));
+    void **items = allocator_realloc(this->allocator, this->items,
+                                     this->capacity * sizeof(void *),
+                                     capacity * sizeof(void *));
     if (!items) {
         return false;
     }
@@ -1,6 +1,7 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+#include "allocator.h"
 #include "iterator.h"
 #include <stdbool.h>
 #include <stdlib.h>
@@ -9,10 +10,38 @@ struct vector {
     void **items;
     size_t length;
     size_t capacity;
+    const struct allocator *allocator;
 };
 
+/* An iterator that lives on the caller's stack. Unlike `vector_iterator`, it
+ * needs no allocation and its inline `next` function needs no indirect call,
+ * so the compiler can optimize the whole loop.
+ */
+struct vector_iter {
+    struct vector *vector;
+    size_t position;
+    void *current;
+};
+
+/* Loop over each item in a vector, assigning it to `item`, which must be
+ * declared before the loop. The vector must not be resized in the loop.
+ *
+ * Examples
+ *
+ *   char *name;
+ *   VECTOR_FOREACH(name, vector) {
+ *       printf("name: %s\n", name);
+ *   }
+ */
+#define VECTOR_FOREACH(item, vector)                                           \
+    for (void **item##_at = (vector)->items,                                   \
+              **item##_end = item##_at + (vector)->length;                     \
+         item##_at < item##_end && ((item) = *item##_at, 1); item##_at++)
+
 struct vector *vector_create(void);
 
+struct vector *vector_create_with_allocator(const struct allocator *allocator);
+
 void vector_destroy(struct vector *this);
 
 struct vector *vector_clone(struct vector *this);
@@ -29,6 +58,45 @@ bool vector_insert(struct vector *this, size_t index, void *item);
 
 struct iterator *vector_iterator(struct vector *this);
 
+/* Start a stack iterator at the first item of a vector.
+ *
+ * this   - The iterator to initialize.
+ * vector - The vector to iterate through.
+ *
+ * Examples
+ *
+ *   struct vector_iter items;
+ *   vector_iter_init(&items, vector);
+ *   while (vector_iter_next(&items)) {
+ *       char *name = items.current;
+ *       printf("index: %lu, name: %s\n", items.position - 1, name);
+ *   }
+ *
+ * Returns nothing.
+ */
+static inline void vector_iter_init(struct vector_iter *this,
+                                    struct vector *vector) {
+    this->vector = vector;
+    this->position = 0;
+    this->current = NULL;
+}
+
+/* Advance a stack iterator to the next item, storing it in `current`. Null
+ * items are returned like any other.
+ *
+ * this - The iterator to advance.
+ *
+ * Returns false when iteration is complete.
+ */
+static inline bool vector_iter_next(struct vector_iter *this) {
+    if (this->position >= this->vector->length) {
+        this->current = NULL;
+        return false;
+    }
+    this->current = this->vector->items[this->position++];
+    return true;
+}
+
 bool vector_concat(struct vector *this, struct vector *other);
 
 void vector_clear(struct vector *this);
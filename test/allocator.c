@@ -0,0 +1,325 @@
+#include "allocator.h"
+#include "hashmap.h"
+#include "heap.h"
+#include "list.h"
+#include "vector.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct counter {
+    size_t allocs;
+    size_t frees;
+    size_t bytes;
+    size_t fail;
+};
+
+void *counter_alloc(void *context, size_t size);
+void *counter_realloc(void *context, void *memory, size_t size,
+                      size_t new_size);
+void counter_free(void *context, void *memory, size_t size);
+int compare_nodes(const void *a, const void *b);
+void test_libc(void);
+void test_arena(void);
+void test_arena_realloc(void);
+void test_arena_reset(void);
+void test_structures(void);
+void test_arena_structures(void);
+void test_failed_key(void);
+void test_failed_grow(void);
+
+void *counter_alloc(void *context, size_t size) {
+    struct counter *counter = context;
+    if (size == counter->fail) {
+        return NULL;
+    }
+    counter->allocs++;
+    counter->bytes += size;
+    return malloc(size);
+}
+
+void *counter_realloc(void *context, void *memory, size_t size,
+                      size_t new_size) {
+    struct counter *counter = context;
+    if (!memory) {
+        counter->allocs++;
+    }
+    counter->bytes += new_size - size;
+    return realloc(memory, new_size);
+}
+
+void counter_free(void *context, void *memory, size_t size) {
+    struct counter *counter = context;
+    counter->frees++;
+    counter->bytes -= size;
+    free(memory);
+}
+
+int compare_nodes(const void *a, const void *b) { return strcmp(a, b); }
+
+void test_libc() {
+    char *memory = allocator_alloc(&allocator_libc, 16);
+    assert(memory != NULL);
+    memset(memory, 'a', 16);
+
+    memory = allocator_realloc(&allocator_libc, memory, 16, 32);
+    assert(memory != NULL);
+    assert(memory[15] == 'a');
+    allocator_free(&allocator_libc, memory, 32);
+
+    int *zeroed = allocator_calloc(&allocator_libc, 8, sizeof(int));
+    for (size_t i = 0; i < 8; i++) {
+        assert(zeroed[i] == 0);
+    }
+    allocator_free(&allocator_libc, zeroed, 8 * sizeof(int));
+
+    assert(allocator_calloc(&allocator_libc, SIZE_MAX, 2) == NULL);
+}
+
+void test_arena() {
+    struct arena *arena = arena_create(256);
+    assert(arena != NULL);
+    assert(arena->chunks == NULL);
+
+    char *a = allocator_alloc(&arena->allocator, 3);
+    char *b = allocator_alloc(&arena->allocator, 8);
+    assert(a != NULL);
+    assert(b != NULL);
+    assert((uintptr_t)a % 16 == 0);
+    assert((uintptr_t)b % 16 == 0);
+    assert(b - a == 16);
+
+    allocator_free(&arena->allocator, b, 8);
+    char *c = allocator_alloc(&arena->allocator, 8);
+    assert(c == b);
+
+    char *large = allocator_alloc(&arena->allocator, 1000);
+    assert(large != NULL);
+    memset(large, 'x', 1000);
+
+    /* Sizes that would wrap the chunk size fail like malloc does. */
+    assert(allocator_alloc(&arena->allocator, SIZE_MAX) == NULL);
+    assert(allocator_alloc(&arena->allocator, SIZE_MAX - 8) == NULL);
+    assert(allocator_realloc(&arena->allocator, large, 1000, SIZE_MAX) == NULL);
+    arena_destroy(arena);
+
+    arena = arena_create(SIZE_MAX);
+    assert(allocator_alloc(&arena->allocator, 16) == NULL);
+
+    arena_destroy(arena);
+}
+
+void test_arena_realloc() {
+    struct arena *arena = arena_create(256);
+
+    char *a = allocator_alloc(&arena->allocator, 16);
+    memset(a, 'a', 16);
+    char *grown = allocator_realloc(&arena->allocator, a, 16, 64);
+    assert(grown == a);
+
+    char *b = allocator_alloc(&arena->allocator, 16);
+    assert(b != NULL);
+    char *moved = allocator_realloc(&arena->allocator, a, 64, 128);
+    assert(moved != a);
+    assert(moved[0] == 'a');
+    assert(moved[15] == 'a');
+
+    char *fresh = allocator_realloc(&arena->allocator, NULL, 0, 16);
+    assert(fresh != NULL);
+
+    arena_destroy(arena);
+}
+
+void test_arena_reset() {
+    struct arena *arena = arena_create(64);
+
+    void *last = NULL;
+    for (int i = 0; i < 10; i++) {
+        last = allocator_alloc(&arena->allocator, 48);
+        assert(last != NULL);
+    }
+
+    arena_reset(arena);
+    assert(arena->chunks != NULL);
+    assert(allocator_alloc(&arena->allocator, 48) == last);
+
+    arena_destroy(arena);
+}
+
+void test_structures() {
+    struct counter counter = {0, 0, 0, 0};
+    struct allocator allocator = {counter_alloc, counter_realloc,
+                                  counter_free, &counter};
+    char *a = "item 1";
+    char *b = "item 2";
+
+    struct vector *vector = vector_create_with_allocator(&allocator);
+    for (int i = 0; i < 100; i++) {
+        vector_push(vector, a);
+    }
+    struct vector *slice = vector_slice(vector, 0, 50);
+    struct iterator *items = vector_iterator(slice);
+    assert(items->allocator == &allocator);
+    items->destroy(items);
+    vector_destroy(slice);
+    vector_destroy(vector);
+
+    struct list *list = list_create_with_allocator(&allocator);
+    list_push(list, a);
+    list_unshift(list, b);
+    struct list *copy = list_clone(list);
+    assert(list_shift(copy) == b);
+    list_destroy(copy);
+    list_destroy(list);
+
+    struct heap *heap = heap_create_with_allocator(compare_nodes, &allocator);
+    for (int i = 0; i < 100; i++) {
+        heap_push(heap, i % 2 ? a : b);
+    }
+    struct iterator *nodes = heap_iterator(heap);
+    assert(nodes->next(nodes) == a);
+    nodes->destroy(nodes);
+    heap_destroy(heap);
+
+    struct hashmap *map = hashmap_create_with_allocator(&allocator);
+    char key_data[64] = {0};
+    for (int i = 0; i < 100; i++) {
+        memcpy(key_data, &i, sizeof(i));
+        struct hkey key = {key_data, i % 2 ? sizeof(key_data) : sizeof(i)};
+        hashmap_set(map, &key, a);
+    }
+    struct hashmap *clone = hashmap_clone(map);
+    assert(clone->allocator == &allocator);
+    struct iterator *entries = hashmap_iterator(clone);
+    entries->destroy(entries);
+    hashmap_destroy(clone);
+    hashmap_destroy(map);
+
+    struct hashmap_options options = {0};
+    options.flags = HASHMAP_SLAB;
+    options.allocator = &allocator;
+    map = hashmap_create_with_options(&options);
+    for (int i = 0; i < 100; i++) {
+        memcpy(key_data, &i, sizeof(i));
+        struct hkey key = {key_data, sizeof(key_data)};
+        hashmap_set(map, &key, a);
+    }
+    hashmap_destroy(map);
+
+    assert(counter.allocs > 0);
+    assert(counter.allocs == counter.frees);
+    assert(counter.bytes == 0);
+}
+
+void test_arena_structures() {
+    struct arena *arena = arena_create(4096);
+    char *a = "item 1";
+
+    struct vector *vector = vector_create_with_allocator(&arena->allocator);
+    struct hashmap *map = hashmap_create_with_allocator(&arena->allocator);
+    for (int i = 0; i < 1000; i++) {
+        vector_push(vector, a);
+        struct hkey key = {&i, sizeof(i)};
+        hashmap_set(map, &key, a);
+    }
+    assert(vector->length == 1000);
+    assert(map->size == 1000);
+
+    int id = 500;
+    struct hkey key = {&id, sizeof(id)};
+    assert(hashmap_get(map, &key) == a);
+
+    arena_destroy(arena);
+}
+
+void test_failed_key() {
+    struct counter counter = {0, 0, 0, 0};
+    struct allocator allocator = {counter_alloc, counter_realloc,
+                                  counter_free, &counter};
+    struct hashmap *map = hashmap_create_with_allocator(&allocator);
+
+    /* The entry is freed with its own size when its long key can't be. */
+    char key_data[64] = {0};
+    counter.fail = sizeof(key_data);
+    struct hkey key = {key_data, sizeof(key_data)};
+    assert(hashmap_set(map, &key, key_data) == NULL);
+    assert(map->size == 0);
+    assert(hashmap_get(map, &key) == NULL);
+
+    hashmap_destroy(map);
+    assert(counter.allocs == counter.frees);
+    assert(counter.bytes == 0);
+}
+
+void test_failed_grow() {
+    struct counter counter = {0, 0, 0, 0};
+    struct allocator allocator = {counter_alloc, counter_realloc,
+                                  counter_free, &counter};
+    int ids[100];
+    for (int i = 0; i < 100; i++) {
+        ids[i] = i;
+    }
+
+    /* Open tables can't store a key once they're too full and can't grow. */
+    struct hashmap_options options = {0};
+    options.flags = HASHMAP_OPEN;
+    options.allocator = &allocator;
+    struct hashmap *map = hashmap_create_with_options(&options);
+    counter.fail = 2 * map->capacity * sizeof(struct hslot);
+    for (int i = 0; i < 100; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        errno = 0;
+        assert(hashmap_set(map, &key, &ids[i]) == NULL);
+        assert(errno == (i < 12 ? 0 : ENOMEM));
+    }
+    assert(map->size == 12);
+    assert(map->capacity == 16);
+
+    counter.fail = 0;
+    struct hkey key = {&ids[99], sizeof(ids[99])};
+    assert(hashmap_set(map, &key, &ids[99]) == NULL);
+    assert(errno == 0);
+    assert(map->size == 13);
+    hashmap_destroy(map);
+
+    /* Chained tables that can't grow store every key in longer chains. */
+    unsigned long flags[] = {0, HASHMAP_INCREMENTAL};
+    for (size_t i = 0; i < 2; i++) {
+        options.flags = flags[i];
+        map = hashmap_create_with_options(&options);
+        counter.fail = 2 * map->capacity * sizeof(struct hentry *);
+        for (int j = 0; j < 100; j++) {
+            struct hkey chained = {&ids[j], sizeof(ids[j])};
+            errno = ENOMEM;
+            assert(hashmap_set(map, &chained, &ids[j]) == NULL);
+            assert(errno == 0);
+        }
+        assert(map->size == 100);
+        assert(map->capacity == 16);
+        for (int j = 0; j < 100; j++) {
+            struct hkey chained = {&ids[j], sizeof(ids[j])};
+            assert(hashmap_get(map, &chained) == &ids[j]);
+        }
+        counter.fail = 0;
+        hashmap_destroy(map);
+    }
+
+    assert(counter.allocs == counter.frees);
+    assert(counter.bytes == 0);
+}
+
+int main() {
+    test_libc();
+    test_arena();
+    test_arena_realloc();
+    test_arena_reset();
+    test_structures();
+    test_arena_structures();
+    test_failed_key();
+    test_failed_grow();
+
+    return 0;
+}
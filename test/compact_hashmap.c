@@ -0,0 +1,248 @@
+#include "compact_hashmap.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void *failing_alloc(void *context, size_t size);
+void *failing_realloc(void *context, void *memory, size_t size,
+                      size_t new_size);
+void failing_free(void *context, void *memory, size_t size);
+void test_create(void);
+void test_get(void);
+void test_remove(void);
+void test_iterator(void);
+void test_long_keys(void);
+void test_failed_key(void);
+void test_index_widths(void);
+void test_clear(void);
+
+void *failing_alloc(void *context, size_t size) {
+    return size == *(size_t *)context ? NULL : malloc(size);
+}
+
+void *failing_realloc(void *context, void *memory, size_t size,
+                      size_t new_size) {
+    (void)context;
+    (void)size;
+    return realloc(memory, new_size);
+}
+
+void failing_free(void *context, void *memory, size_t size) {
+    (void)context;
+    (void)size;
+    free(memory);
+}
+
+void test_create() {
+    struct compact_hashmap *map = compact_hashmap_create();
+
+    assert(map->size == 0);
+    assert(map->used == 0);
+    assert(map->capacity > 0);
+
+    compact_hashmap_destroy(map);
+}
+
+void test_get() {
+    struct compact_hashmap *map = compact_hashmap_create();
+
+    int id = 42;
+    struct hkey key = {&id, sizeof(id)};
+    char *a = "item 1";
+    char *b = "item 2";
+
+    assert(compact_hashmap_get(map, &key) == NULL);
+    assert(!compact_hashmap_contains(map, &key));
+    assert(compact_hashmap_set(map, &key, a) == NULL);
+    assert(errno == 0);
+    assert(compact_hashmap_get(map, &key) == a);
+    assert(compact_hashmap_contains(map, &key));
+    assert(compact_hashmap_set(map, &key, b) == a);
+    assert(compact_hashmap_get(map, &key) == b);
+    assert(map->size == 1);
+
+    compact_hashmap_destroy(map);
+}
+
+void test_remove() {
+    struct compact_hashmap *map = compact_hashmap_create();
+
+    int ids[1100];
+    for (int i = 0; i < 1000; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        compact_hashmap_set(map, &key, &ids[i]);
+    }
+
+    for (int i = 0; i < 1000; i += 2) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(compact_hashmap_remove(map, &key) == &ids[i]);
+        assert(compact_hashmap_remove(map, &key) == NULL);
+    }
+    assert(map->size == 500);
+    assert(map->used == 1000);
+
+    for (int i = 0; i < 1000; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(compact_hashmap_get(map, &key) == (i % 2 ? &ids[i] : NULL));
+    }
+
+    /* Reinserted keys are appended after the holes. */
+    for (int i = 0; i < 1000; i += 2) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        compact_hashmap_set(map, &key, &ids[i]);
+    }
+    assert(map->size == 1000);
+    assert(map->used == 1500);
+
+    /* Filling the dense array compacts the holes away. */
+    for (int i = 1000; i < 1100; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        compact_hashmap_set(map, &key, &ids[i]);
+    }
+    assert(map->size == 1100);
+    assert(map->used == 1100);
+    for (int i = 0; i < 1100; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(compact_hashmap_get(map, &key) == &ids[i]);
+    }
+
+    compact_hashmap_destroy(map);
+}
+
+void test_iterator() {
+    struct compact_hashmap *map = compact_hashmap_create();
+
+    int ids[100];
+    for (int i = 0; i < 100; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        compact_hashmap_set(map, &key, &ids[i]);
+    }
+    for (int i = 0; i < 100; i += 3) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        compact_hashmap_remove(map, &key);
+    }
+
+    int expected = 1;
+    struct iterator *entries = compact_hashmap_iterator(map);
+    while (entries->next(entries)) {
+        struct centry *entry = entries->current;
+        assert(*(int *)entry->key.data == expected);
+        assert(entry->value == &ids[expected]);
+        expected += expected % 3 == 2 ? 2 : 1;
+    }
+    assert(entries->index == map->size - 1);
+    entries->destroy(entries);
+
+    /* Batches fall back to calling next for each entry. */
+    void *batch[8];
+    size_t count, total = 0;
+    entries = compact_hashmap_iterator(map);
+    while ((count = entries->next_batch(entries, batch, 8))) {
+        struct centry *entry = batch[0];
+        assert(entry->value == &ids[*(int *)entry->key.data]);
+        total += count;
+    }
+    assert(total == map->size);
+    assert(entries->current == NULL);
+    entries->destroy(entries);
+
+    compact_hashmap_destroy(map);
+}
+
+void test_long_keys() {
+    struct compact_hashmap *map = compact_hashmap_create();
+
+    char keys[200][40];
+    for (int i = 0; i < 200; i++) {
+        memset(keys[i], 'k', sizeof(keys[i]));
+        memcpy(keys[i], &i, sizeof(i));
+        struct hkey key = {keys[i], sizeof(keys[i])};
+        compact_hashmap_set(map, &key, keys[i]);
+    }
+    for (int i = 0; i < 200; i += 2) {
+        struct hkey key = {keys[i], sizeof(keys[i])};
+        assert(compact_hashmap_remove(map, &key) == keys[i]);
+    }
+    for (int i = 0; i < 200; i++) {
+        struct hkey key = {keys[i], sizeof(keys[i])};
+        assert(compact_hashmap_get(map, &key) == (i % 2 ? keys[i] : NULL));
+    }
+
+    compact_hashmap_destroy(map);
+}
+
+void test_failed_key() {
+    char data[40] = "a key too long to store inline";
+    size_t fail = sizeof(data);
+    struct allocator allocator = {failing_alloc, failing_realloc, failing_free,
+                                  &fail};
+    struct compact_hashmap *map =
+        compact_hashmap_create_with_allocator(&allocator);
+
+    struct hkey key = {data, sizeof(data)};
+    errno = 0;
+    assert(compact_hashmap_set(map, &key, data) == NULL);
+    assert(errno == ENOMEM);
+    assert(map->size == 0);
+    assert(!compact_hashmap_contains(map, &key));
+
+    fail = 0;
+    assert(compact_hashmap_set(map, &key, data) == NULL);
+    assert(errno == 0);
+    assert(compact_hashmap_get(map, &key) == data);
+
+    compact_hashmap_destroy(map);
+}
+
+void test_index_widths() {
+    struct compact_hashmap *map = compact_hashmap_create();
+
+    int *ids = malloc(100000 * sizeof(int));
+    for (int i = 0; i < 100000; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        compact_hashmap_set(map, &key, &ids[i]);
+    }
+    assert(map->capacity > UINT16_MAX);
+    for (int i = 0; i < 100000; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(compact_hashmap_get(map, &key) == &ids[i]);
+    }
+
+    compact_hashmap_destroy(map);
+    free(ids);
+}
+
+void test_clear() {
+    struct compact_hashmap *map = compact_hashmap_create();
+
+    char key[64] = "a long key";
+    struct hkey hkey = {key, sizeof(key)};
+    compact_hashmap_set(map, &hkey, key);
+    compact_hashmap_clear(map);
+    assert(map->size == 0);
+    assert(compact_hashmap_get(map, &hkey) == NULL);
+
+    compact_hashmap_set(map, &hkey, key);
+    assert(compact_hashmap_get(map, &hkey) == key);
+
+    compact_hashmap_destroy(map);
+}
+
+int main() {
+    test_create();
+    test_get();
+    test_remove();
+    test_iterator();
+    test_long_keys();
+    test_failed_key();
+    test_index_widths();
+    test_clear();
+
+    return 0;
+}
@@ -0,0 +1,267 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "concurrent_hashmap.h"
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define THREADS 8
+#define PER_THREAD 5000
+
+struct worker {
+    struct concurrent_hashmap *map;
+    int *ids;
+    int count;
+    int padding;
+};
+
+void *limited_alloc(void *context, size_t size);
+void *limited_realloc(void *context, void *memory, size_t size,
+                      size_t new_size);
+void limited_free(void *context, void *memory, size_t size);
+void *insert_keys(void *context);
+void *read_keys(void *context);
+void test_create(void);
+void test_get(void);
+void test_remove(void);
+void test_merge(void);
+void test_failed_merge(void);
+void test_options(void);
+void test_threads(void);
+
+void *limited_alloc(void *context, size_t size) {
+    size_t *remaining = context;
+    if (*remaining == 0) {
+        return NULL;
+    }
+    (*remaining)--;
+    return malloc(size);
+}
+
+void *limited_realloc(void *context, void *memory, size_t size,
+                      size_t new_size) {
+    (void)context;
+    (void)size;
+    return realloc(memory, new_size);
+}
+
+void limited_free(void *context, void *memory, size_t size) {
+    (void)context;
+    (void)size;
+    free(memory);
+}
+
+void *insert_keys(void *context) {
+    struct worker *worker = context;
+    for (int i = 0; i < worker->count; i++) {
+        struct hkey key = {&worker->ids[i], sizeof(worker->ids[i])};
+        concurrent_hashmap_set(worker->map, &key, &worker->ids[i]);
+        assert(errno == 0);
+    }
+    return NULL;
+}
+
+void *read_keys(void *context) {
+    struct worker *worker = context;
+    for (int i = 0; i < worker->count; i++) {
+        struct hkey key = {&worker->ids[i], sizeof(worker->ids[i])};
+        void *value = concurrent_hashmap_get(worker->map, &key);
+        assert(value == NULL || value == &worker->ids[i]);
+    }
+    return NULL;
+}
+
+void test_create() {
+    struct concurrent_hashmap *map = concurrent_hashmap_create(5);
+    assert(map->count == 8);
+    assert(concurrent_hashmap_size(map) == 0);
+    concurrent_hashmap_destroy(map);
+
+    map = concurrent_hashmap_create(0);
+    assert(map->count > 0);
+    assert((map->count & (map->count - 1)) == 0);
+    concurrent_hashmap_destroy(map);
+}
+
+void test_get() {
+    struct concurrent_hashmap *map = concurrent_hashmap_create(4);
+
+    int id = 42;
+    struct hkey key = {&id, sizeof(id)};
+    char *a = "item 1";
+    char *b = "item 2";
+
+    assert(concurrent_hashmap_get(map, &key) == NULL);
+    assert(!concurrent_hashmap_contains(map, &key));
+    assert(concurrent_hashmap_set(map, &key, a) == NULL);
+    assert(errno == 0);
+    assert(concurrent_hashmap_get(map, &key) == a);
+    assert(concurrent_hashmap_contains(map, &key));
+    assert(concurrent_hashmap_set(map, &key, b) == a);
+    assert(concurrent_hashmap_get(map, &key) == b);
+    assert(concurrent_hashmap_size(map) == 1);
+
+    concurrent_hashmap_destroy(map);
+}
+
+void test_remove() {
+    struct concurrent_hashmap *map = concurrent_hashmap_create(4);
+
+    int ids[100];
+    for (int i = 0; i < 100; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        concurrent_hashmap_set(map, &key, &ids[i]);
+    }
+    assert(concurrent_hashmap_size(map) == 100);
+
+    for (int i = 0; i < 100; i += 2) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(concurrent_hashmap_remove(map, &key) == &ids[i]);
+        assert(concurrent_hashmap_remove(map, &key) == NULL);
+    }
+    assert(concurrent_hashmap_size(map) == 50);
+
+    for (int i = 0; i < 100; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(concurrent_hashmap_contains(map, &key) == (i % 2 == 1));
+    }
+
+    concurrent_hashmap_clear(map);
+    assert(concurrent_hashmap_size(map) == 0);
+
+    concurrent_hashmap_destroy(map);
+}
+
+void test_merge() {
+    struct concurrent_hashmap *map = concurrent_hashmap_create(4);
+    struct hashmap *other = hashmap_create();
+
+    int ids[100];
+    for (int i = 0; i < 100; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(other, &key, &ids[i]);
+    }
+
+    assert(concurrent_hashmap_merge(map, other));
+    assert(concurrent_hashmap_size(map) == 100);
+    for (int i = 0; i < 100; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(concurrent_hashmap_get(map, &key) == &ids[i]);
+    }
+
+    hashmap_destroy(other);
+    concurrent_hashmap_destroy(map);
+}
+
+void test_failed_merge() {
+    size_t remaining = SIZE_MAX;
+    struct allocator allocator = {limited_alloc, limited_realloc,
+                                  limited_free, &remaining};
+    struct hashmap_options options = {0};
+    options.capacity = 1000;
+    options.allocator = &allocator;
+    struct concurrent_hashmap *map =
+        concurrent_hashmap_create_with_options(&options, 4);
+    struct hashmap *other = hashmap_create();
+
+    int ids[100];
+    int replaced[100];
+    for (int i = 0; i < 100; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(other, &key, &replaced[i]);
+        if (i < 50) {
+            concurrent_hashmap_set(map, &key, &ids[i]);
+        }
+    }
+
+    /* Fail after replacing 50 values and inserting 10 keys. */
+    remaining = 11;
+    assert(!concurrent_hashmap_merge(map, other));
+    assert(concurrent_hashmap_size(map) == 50);
+    for (int i = 0; i < 100; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(concurrent_hashmap_get(map, &key) == (i < 50 ? &ids[i] : NULL));
+    }
+
+    remaining = SIZE_MAX;
+    assert(concurrent_hashmap_merge(map, other));
+    assert(concurrent_hashmap_size(map) == 100);
+    for (int i = 0; i < 100; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(concurrent_hashmap_get(map, &key) == &replaced[i]);
+    }
+
+    hashmap_destroy(other);
+    concurrent_hashmap_destroy(map);
+}
+
+void test_options() {
+    struct hashmap_options options = {0};
+    options.flags = HASHMAP_INCREMENTAL;
+    errno = 0;
+    assert(concurrent_hashmap_create_with_options(&options, 4) == NULL);
+    assert(errno == EINVAL);
+
+    options.flags = HASHMAP_OPEN | HASHMAP_SLAB;
+    options.capacity = 1000;
+    struct concurrent_hashmap *map =
+        concurrent_hashmap_create_with_options(&options, 4);
+    assert(map);
+
+    int id = 42;
+    struct hkey key = {&id, sizeof(id)};
+    concurrent_hashmap_set(map, &key, &id);
+    assert(concurrent_hashmap_get(map, &key) == &id);
+
+    concurrent_hashmap_destroy(map);
+}
+
+void test_threads() {
+    struct concurrent_hashmap *map = concurrent_hashmap_create(16);
+    int *ids = malloc(THREADS * PER_THREAD * sizeof(int));
+    for (int i = 0; i < THREADS * PER_THREAD; i++) {
+        ids[i] = i;
+    }
+
+    pthread_t writers[THREADS];
+    pthread_t readers[THREADS];
+    struct worker workers[THREADS];
+    for (int i = 0; i < THREADS; i++) {
+        workers[i].map = map;
+        workers[i].ids = &ids[i * PER_THREAD];
+        workers[i].count = PER_THREAD;
+        pthread_create(&writers[i], NULL, insert_keys, &workers[i]);
+        pthread_create(&readers[i], NULL, read_keys, &workers[i]);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(writers[i], NULL);
+        pthread_join(readers[i], NULL);
+    }
+
+    assert(concurrent_hashmap_size(map) == THREADS * PER_THREAD);
+    for (int i = 0; i < THREADS * PER_THREAD; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(concurrent_hashmap_get(map, &key) == &ids[i]);
+    }
+
+    concurrent_hashmap_destroy(map);
+    free(ids);
+}
+
+int main() {
+    test_create();
+    test_get();
+    test_remove();
+    test_merge();
+    test_failed_merge();
+    test_options();
+    test_threads();
+
+    return 0;
+}
@@ -0,0 +1,275 @@
+#include "expiring_map.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define KEYS 2000
+
+struct fake_clock {
+    uint64_t now;
+    size_t expired;
+    void *last;
+};
+
+uint64_t read_clock(void *context);
+void record_expiry(struct hkey *key, void *value, void *context);
+struct expiring_map *create_map(struct fake_clock *clock);
+void test_create(void);
+void test_get(void);
+void test_forever(void);
+void test_replace(void);
+void test_remove(void);
+void test_expire_step(void);
+void test_bounded_step(void);
+void test_clear(void);
+
+uint64_t read_clock(void *context) {
+    struct fake_clock *clock = context;
+    return clock->now;
+}
+
+void record_expiry(struct hkey *key, void *value, void *context) {
+    struct fake_clock *clock = context;
+    (void)key;
+    clock->expired++;
+    clock->last = value;
+}
+
+struct expiring_map *create_map(struct fake_clock *clock) {
+    struct expiring_map_options options = {0};
+    options.clock = read_clock;
+    options.expire = record_expiry;
+    options.context = clock;
+    return expiring_map_create_with_options(&options);
+}
+
+void test_create() {
+    struct expiring_map *map = expiring_map_create();
+    assert(map->size == 0);
+    assert(map->capacity > 0);
+    expiring_map_destroy(map);
+
+    struct fake_clock clock = {1000, 0, NULL};
+    map = create_map(&clock);
+    assert(map->tick == 1000);
+    expiring_map_destroy(map);
+}
+
+void test_get() {
+    struct fake_clock clock = {1000, 0, NULL};
+    struct expiring_map *map = create_map(&clock);
+
+    int id = 42;
+    struct hkey key = {&id, sizeof(id)};
+    char *a = "item 1";
+
+    assert(expiring_map_get(map, &key) == NULL);
+    assert(expiring_map_set(map, &key, a, 10) == NULL);
+    assert(errno == 0);
+    assert(map->size == 1);
+
+    clock.now = 1009;
+    assert(expiring_map_get(map, &key) == a);
+    assert(expiring_map_contains(map, &key));
+    assert(clock.expired == 0);
+
+    /* Expired entries are reaped when they're looked up. */
+    clock.now = 1010;
+    assert(expiring_map_get(map, &key) == NULL);
+    assert(!expiring_map_contains(map, &key));
+    assert(clock.expired == 1);
+    assert(clock.last == a);
+    assert(map->size == 0);
+
+    expiring_map_destroy(map);
+}
+
+void test_forever() {
+    struct fake_clock clock = {0, 0, NULL};
+    struct expiring_map *map = create_map(&clock);
+
+    int ids[2] = {1, 2};
+    struct hkey forever = {&ids[0], sizeof(ids[0])};
+    struct hkey later = {&ids[1], sizeof(ids[1])};
+    expiring_map_set(map, &forever, &ids[0], 0);
+    expiring_map_set(map, &later, &ids[1], UINT64_MAX);
+
+    clock.now = UINT64_MAX - 2;
+    assert(expiring_map_expire_step(map, SIZE_MAX) == 0);
+    assert(expiring_map_get(map, &forever) == &ids[0]);
+    assert(expiring_map_get(map, &later) == &ids[1]);
+
+    expiring_map_destroy(map);
+    assert(clock.expired == 2);
+}
+
+void test_replace() {
+    struct fake_clock clock = {0, 0, NULL};
+    struct expiring_map *map = create_map(&clock);
+
+    int id = 42;
+    struct hkey key = {&id, sizeof(id)};
+    char *a = "item 1";
+    char *b = "item 2";
+
+    expiring_map_set(map, &key, a, 100);
+    clock.now = 90;
+    assert(expiring_map_set(map, &key, b, 100) == a);
+    assert(map->size == 1);
+
+    clock.now = 150;
+    assert(expiring_map_expire_step(map, SIZE_MAX) == 0);
+    assert(expiring_map_get(map, &key) == b);
+
+    /* Replacing an expired entry reaps its old value. */
+    clock.now = 190;
+    assert(expiring_map_set(map, &key, a, 0) == NULL);
+    assert(clock.expired == 1);
+    assert(clock.last == b);
+    assert(expiring_map_get(map, &key) == a);
+
+    expiring_map_destroy(map);
+}
+
+void test_remove() {
+    struct fake_clock clock = {0, 0, NULL};
+    struct expiring_map *map = create_map(&clock);
+
+    int ids[100];
+    for (int i = 0; i < 100; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        expiring_map_set(map, &key, &ids[i], (uint64_t)i + 1);
+    }
+
+    for (int i = 0; i < 100; i += 2) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(expiring_map_remove(map, &key) == &ids[i]);
+        assert(expiring_map_remove(map, &key) == NULL);
+    }
+    assert(map->size == 50);
+
+    clock.now = 100;
+    assert(expiring_map_expire_step(map, SIZE_MAX) == 50);
+    assert(clock.expired == 50);
+    assert(map->size == 0);
+
+    expiring_map_destroy(map);
+}
+
+void test_expire_step() {
+    struct fake_clock clock = {12345, 0, NULL};
+    struct expiring_map *map = create_map(&clock);
+
+    /* Deadlines spread across the bottom three levels of the wheel. */
+    int *ids = malloc(KEYS * sizeof(int));
+    uint64_t *deadlines = malloc(KEYS * sizeof(uint64_t));
+    for (int i = 0; i < KEYS; i++) {
+        ids[i] = i;
+        uint64_t ttl = (uint64_t)i * 7919 % 300000 + 1;
+        deadlines[i] = clock.now + ttl;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        expiring_map_set(map, &key, &ids[i], ttl);
+    }
+
+    /* After each step, exactly the entries past their deadline are gone. */
+    uint64_t advances[] = {1, 62, 1, 64, 4095, 1, 5000, 123457};
+    size_t reaped = 0;
+    for (size_t step = 0; map->size > 0; step++) {
+        clock.now += advances[step % 8];
+        reaped += expiring_map_expire_step(map, SIZE_MAX);
+
+        size_t live = 0;
+        for (int i = 0; i < KEYS; i++) {
+            live += deadlines[i] > clock.now;
+        }
+        assert(map->size == live);
+        assert(reaped == KEYS - live);
+    }
+    assert(clock.expired == KEYS);
+
+    expiring_map_destroy(map);
+    free(deadlines);
+    free(ids);
+}
+
+void test_bounded_step() {
+    struct fake_clock clock = {0, 0, NULL};
+    struct expiring_map *map = create_map(&clock);
+
+    int ids[100];
+    for (int i = 0; i < 100; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        expiring_map_set(map, &key, &ids[i], 5000);
+    }
+
+    /* The entries share one upper slot, moved down then reaped in bounded
+     * batches.
+     */
+    clock.now = 6000;
+    size_t reaped = 0;
+    for (int i = 0; i < 5; i++) {
+        reaped += expiring_map_expire_step(map, 10);
+    }
+    assert(map->tick < 6000);
+
+    /* Entries timed while the wheel lags behind the clock still expire. */
+    int late = 100;
+    struct hkey key = {&late, sizeof(late)};
+    expiring_map_set(map, &key, &late, 1);
+
+    size_t steps = 5;
+    while (map->size > 1) {
+        reaped += expiring_map_expire_step(map, 10);
+        steps++;
+    }
+    assert(reaped == 100);
+    assert(clock.expired == 100);
+    assert(steps >= 20);
+    assert(expiring_map_get(map, &key) == &late);
+
+    clock.now = 6001;
+    assert(expiring_map_expire_step(map, SIZE_MAX) == 1);
+    assert(map->size == 0);
+    assert(clock.last == &late);
+
+    expiring_map_destroy(map);
+}
+
+void test_clear() {
+    struct fake_clock clock = {0, 0, NULL};
+    struct expiring_map *map = create_map(&clock);
+
+    char key[100] = "a long key stored after its entry";
+    for (int i = 0; i < 10; i++) {
+        key[99] = (char)i;
+        struct hkey hkey = {key, sizeof(key)};
+        expiring_map_set(map, &hkey, NULL, (uint64_t)i * 1000);
+    }
+
+    expiring_map_clear(map);
+    assert(clock.expired == 10);
+    assert(map->size == 0);
+
+    clock.now = 100000;
+    assert(expiring_map_expire_step(map, SIZE_MAX) == 0);
+
+    expiring_map_destroy(map);
+    assert(clock.expired == 10);
+}
+
+int main() {
+    test_create();
+    test_get();
+    test_forever();
+    test_replace();
+    test_remove();
+    test_expire_step();
+    test_bounded_step();
+    test_clear();
+
+    return 0;
+}
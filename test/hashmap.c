@@ -1,17 +1,40 @@
 #include "hashmap.h"
 #include <assert.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 void test_create(void);
 void test_get(void);
 void test_set(void);
 void test_contains(void);
 void test_iterator(void);
+void test_iter(void);
+void test_next_batch(void);
 void test_remove(void);
 void test_merge(void);
 void test_clone(void);
+void test_open(void);
+void test_key_lengths(void);
+void test_fnv1a(void);
+void test_slab(void);
+void test_incremental(void);
+void test_capacity(void);
+void test_shrink(void);
+void test_get_many(void);
+void test_entry(void);
+void test_update(void);
+void *increment(void *value, void *context);
+void test_hashed(void);
+void test_seeded(void);
+void test_touch(void);
+void test_collisions(void);
+size_t longest_chain(struct hashmap *map);
+#ifdef HASHMAP_STATS
+void test_stats(void);
+#endif
 
 void test_create() {
     struct hashmap *map = hashmap_create();
@@ -113,6 +136,70 @@ void test_contains() {
     hashmap_destroy(map);
 }
 
+void test_iter() {
+    struct hashmap *map = hashmap_create();
+
+    int ids[100];
+    for (int i = 0; i < 100; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+
+    /* Entries come in insertion order, and the current one may be removed. */
+    struct hashmap_iter iter;
+    hashmap_iter_init(&iter, map);
+    for (int i = 0; i < 100; i++) {
+        assert(hashmap_iter_next(&iter));
+        assert(iter.current->value == &ids[i]);
+        if (i % 2) {
+            hashmap_remove(map, &iter.current->key);
+        }
+    }
+    assert(!hashmap_iter_next(&iter));
+    assert(iter.current == NULL);
+    assert(map->size == 50);
+
+    int count = 0;
+    struct hentry *entry;
+    HASHMAP_FOREACH(entry, map) {
+        assert(entry->value == &ids[count * 2]);
+        count++;
+    }
+    assert(count == 50);
+
+    hashmap_destroy(map);
+}
+
+void test_next_batch() {
+    struct hashmap *map = hashmap_create();
+
+    int ids[10];
+    for (int i = 0; i < 10; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+
+    void *entries[4];
+    struct iterator *iter = hashmap_iterator(map);
+    assert(iter->next(iter) == map->head);
+    assert(iter->next_batch(iter, entries, 4) == 4);
+    assert(((struct hentry *)entries[0])->value == &ids[1]);
+    assert(((struct hentry *)entries[3])->value == &ids[4]);
+    assert(iter->current == entries[3]);
+    assert(iter->index == 4);
+
+    assert(iter->next_batch(iter, entries, 4) == 4);
+    assert(iter->next_batch(iter, entries, 4) == 1);
+    assert(entries[0] == map->tail);
+    assert(iter->current == NULL);
+    assert(iter->index == 9);
+    iter->destroy(iter);
+
+    hashmap_destroy(map);
+}
+
 void test_iterator() {
     struct hashmap *map = hashmap_create();
 
@@ -272,15 +359,705 @@ void test_clone() {
     hashmap_destroy(clone);
 }
 
+void test_open() {
+    struct hashmap_options options = {0};
+    options.flags = HASHMAP_OPEN;
+    struct hashmap *map = hashmap_create_with_options(&options);
+    assert(map->slots != NULL);
+    assert(map->entries == NULL);
+
+    int ids[1000];
+    for (int i = 0; i < 1000; i++) {
+        ids[i] = i * 7;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        errno = 1;
+        assert(hashmap_set(map, &key, &ids[i]) == NULL);
+        assert(errno == 0);
+    }
+    assert(map->size == 1000);
+    assert(map->capacity > 1000);
+
+    for (int i = 0; i < 1000; i += 2) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(hashmap_remove(map, &key) == &ids[i]);
+    }
+    assert(map->size == 500);
+
+    for (int i = 0; i < 1000; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(hashmap_contains(map, &key) == (i % 2 == 1));
+        assert(hashmap_get(map, &key) == (i % 2 == 1 ? &ids[i] : NULL));
+    }
+
+    struct iterator *entries = hashmap_iterator(map);
+    int expected = 1;
+    while (entries->next(entries)) {
+        struct hentry *entry = entries->current;
+        assert(entry->value == &ids[expected]);
+        expected += 2;
+    }
+    assert(expected == 1001);
+    entries->destroy(entries);
+
+    struct hashmap *clone = hashmap_clone(map);
+    assert(clone->slots != NULL);
+    assert(clone->size == 500);
+    struct hkey key = {&ids[1], sizeof(ids[1])};
+    assert(hashmap_get(clone, &key) == &ids[1]);
+    hashmap_destroy(clone);
+
+    hashmap_clear(map);
+    assert(map->size == 0);
+    assert(hashmap_get(map, &key) == NULL);
+
+    hashmap_destroy(map);
+}
+
+void test_key_lengths() {
+    struct hashmap *map = hashmap_create();
+
+    char data[300];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (char)i;
+    }
+
+    for (size_t length = 0; length <= sizeof(data); length++) {
+        struct hkey key = {data, length};
+        assert(hashmap_set(map, &key, data + length) == NULL);
+    }
+    assert(map->size == sizeof(data) + 1);
+
+    for (size_t length = 0; length <= sizeof(data); length++) {
+        struct hkey key = {data, length};
+        assert(hashmap_get(map, &key) == data + length);
+    }
+
+    struct iterator *entries = hashmap_iterator(map);
+    while (entries->next(entries)) {
+        struct hentry *entry = entries->current;
+        bool stored_inline = entry->key.data == entry->buffer;
+        assert(stored_inline == (entry->key.length <= HKEY_INLINE_SIZE));
+        assert(entry->key.data != data);
+    }
+    entries->destroy(entries);
+
+    hashmap_destroy(map);
+}
+
+void test_fnv1a() {
+    struct hashmap_options options = {0};
+    options.flags = HASHMAP_FNV1A;
+    struct hashmap *map = hashmap_create_with_options(&options);
+    struct hashmap *other = hashmap_create();
+
+    char *a = "item 1";
+    char *b = "item 2";
+
+    int id = 42;
+    struct hkey key = {&id, sizeof(id)};
+    hashmap_set(map, &key, a);
+    assert(hashmap_get(map, &key) == a);
+
+    int id2 = 22;
+    struct hkey key2 = {&id2, sizeof(id2)};
+    hashmap_set(map, &key2, b);
+
+    assert(hashmap_merge(other, map));
+    assert(hashmap_get(other, &key) == a);
+    assert(hashmap_get(other, &key2) == b);
+    assert(hashmap_remove(other, &key) == a);
+    assert(other->size == 1);
+
+    hashmap_destroy(map);
+    hashmap_destroy(other);
+}
+
+void test_slab() {
+    struct hashmap_options options = {0};
+    options.flags = HASHMAP_SLAB;
+    struct hashmap *map = hashmap_create_with_options(&options);
+
+    char data[64] = {0};
+    int ids[2000];
+    for (int i = 0; i < 2000; i++) {
+        ids[i] = i;
+        memcpy(data, &ids[i], sizeof(ids[i]));
+        struct hkey key = {data, i % 2 ? sizeof(data) : sizeof(ids[i])};
+        assert(hashmap_set(map, &key, &ids[i]) == NULL);
+    }
+    assert(map->size == 2000);
+    assert(map->slabs != NULL);
+    assert(map->unused == NULL);
+
+    memcpy(data, &ids[10], sizeof(ids[10]));
+    struct hkey key = {data, sizeof(ids[10])};
+    assert(hashmap_remove(map, &key) == &ids[10]);
+    assert(map->unused != NULL);
+
+    struct hentry *unused = map->unused;
+    assert(hashmap_set(map, &key, &ids[0]) == NULL);
+    assert(map->unused == NULL);
+    assert(map->tail == unused);
+    assert(hashmap_get(map, &key) == &ids[0]);
+
+    memcpy(data, &ids[11], sizeof(ids[11]));
+    struct hkey key2 = {data, sizeof(data)};
+    assert(hashmap_get(map, &key2) == &ids[11]);
+
+    /* Removed long keys are reused by keys of the same size class. */
+    void *memory = NULL;
+    for (int i = 0; i < 100; i++) {
+        memcpy(data, &i, sizeof(i));
+        data[sizeof(data) - 1] = 1;
+        struct hkey churn = {data, i % 2 ? sizeof(data) : sizeof(data) - 8};
+        assert(hashmap_set(map, &churn, &ids[i]) == NULL);
+        assert(memory == NULL || map->tail->key.data == memory);
+        memory = map->tail->key.data;
+        assert(hashmap_remove(map, &churn) == &ids[i]);
+    }
+    data[sizeof(data) - 1] = 0;
+
+    hashmap_clear(map);
+    assert(map->size == 0);
+    assert(map->slabs == NULL);
+    assert(hashmap_get(map, &key2) == NULL);
+
+    assert(hashmap_set(map, &key2, &ids[1]) == NULL);
+    assert(hashmap_get(map, &key2) == &ids[1]);
+
+    hashmap_destroy(map);
+}
+
+void test_incremental() {
+    struct hashmap_options options = {0};
+    options.flags = HASHMAP_INCREMENTAL | HASHMAP_OPEN;
+    errno = 0;
+    assert(hashmap_create_with_options(&options) == NULL);
+    assert(errno == EINVAL);
+
+    options.flags = HASHMAP_INCREMENTAL;
+    struct hashmap *map = hashmap_create_with_options(&options);
+
+    int ids[1000];
+    bool migrating = false;
+    for (int i = 0; i < 1000; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(hashmap_set(map, &key, &ids[i]) == NULL);
+
+        if (map->old_entries) {
+            migrating = true;
+            for (int j = 0; j <= i; j++) {
+                struct hkey found = {&ids[j], sizeof(ids[j])};
+                assert(hashmap_contains(map, &found));
+            }
+        }
+    }
+    assert(migrating);
+    assert(map->size == 1000);
+
+    options.flags = HASHMAP_INCREMENTAL;
+    struct hashmap *other = hashmap_create_with_options(&options);
+    for (int i = 0; i < 12; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(other, &key, &ids[i]);
+    }
+    struct hkey key = {&ids[12], sizeof(ids[12])};
+    hashmap_set(other, &key, &ids[12]);
+    assert(other->old_entries != NULL);
+
+    assert(hashmap_remove(other, &key) == &ids[12]);
+    for (int i = 0; i < 12; i++) {
+        struct hkey removed = {&ids[i], sizeof(ids[i])};
+        assert(hashmap_remove(other, &removed) == &ids[i]);
+    }
+    assert(other->size == 0);
+    assert(other->head == NULL);
+    assert(other->old_entries == NULL);
+    hashmap_destroy(other);
+
+    struct iterator *entries = hashmap_iterator(map);
+    int expected = 0;
+    while (entries->next(entries)) {
+        struct hentry *entry = entries->current;
+        assert(entry->value == &ids[expected]);
+        expected++;
+    }
+    assert(expected == 1000);
+    entries->destroy(entries);
+
+    for (int i = 0; i < 1000; i++) {
+        struct hkey found = {&ids[i], sizeof(ids[i])};
+        assert(hashmap_get(map, &found) == &ids[i]);
+    }
+    assert(map->old_entries == NULL);
+
+    hashmap_destroy(map);
+}
+
+void test_capacity() {
+    struct hashmap *map = hashmap_create_with_capacity(1000);
+    size_t capacity = map->capacity;
+    assert(capacity >= 1000);
+    assert((capacity & (capacity - 1)) == 0);
+
+    int ids[1000];
+    for (int i = 0; i < 1000; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+    assert(map->capacity == capacity);
+
+    assert(hashmap_reserve(map, 10));
+    assert(map->capacity == capacity);
+
+    assert(hashmap_reserve(map, 4000));
+    assert(map->capacity > capacity);
+    assert((map->capacity & (map->capacity - 1)) == 0);
+    capacity = map->capacity;
+    for (int i = 0; i < 1000; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(hashmap_get(map, &key) == &ids[i]);
+    }
+
+    /* No power of two bucket count holds this many entries. */
+    assert(!hashmap_reserve(map, SIZE_MAX / 8 * 7));
+    assert(!hashmap_reserve(map, SIZE_MAX));
+    assert(map->capacity == capacity);
+    assert(hashmap_create_with_capacity(SIZE_MAX / 8 * 7) == NULL);
+
+    hashmap_destroy(map);
+}
+
+void test_shrink() {
+    struct hashmap *map = hashmap_create();
+
+    int ids[1000];
+    for (int i = 0; i < 1000; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+    for (int i = 10; i < 1000; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_remove(map, &key);
+    }
+    size_t capacity = map->capacity;
+    assert(capacity > 1000);
+
+    assert(hashmap_shrink_to_fit(map));
+    assert(map->capacity < capacity);
+    assert((map->capacity & (map->capacity - 1)) == 0);
+    assert(map->capacity >= 10);
+    for (int i = 0; i < 10; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(hashmap_get(map, &key) == &ids[i]);
+    }
+    hashmap_destroy(map);
+
+    struct hashmap_options options = {0};
+    options.flags = HASHMAP_SHRINK | HASHMAP_OPEN;
+    map = hashmap_create_with_options(&options);
+    for (int i = 0; i < 1000; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_set(map, &key, &ids[i]);
+    }
+    capacity = map->capacity;
+    for (int i = 10; i < 1000; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        hashmap_remove(map, &key);
+        assert((double)map->size / (double)map->capacity >= .0625 ||
+               map->capacity == 16);
+    }
+    assert(map->capacity < capacity);
+    for (int i = 0; i < 10; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(hashmap_get(map, &key) == &ids[i]);
+    }
+    hashmap_destroy(map);
+}
+
+void test_get_many() {
+    unsigned long layouts[] = {0, HASHMAP_OPEN, HASHMAP_INCREMENTAL};
+    for (size_t layout = 0; layout < 3; layout++) {
+        struct hashmap_options options = {0};
+        options.flags = layouts[layout];
+        struct hashmap *map = hashmap_create_with_options(&options);
+
+        int ids[100];
+        struct hkey keys[100];
+        for (int i = 0; i < 100; i++) {
+            ids[i] = i;
+            keys[i].data = &ids[i];
+            keys[i].length = sizeof(ids[i]);
+            if (i % 3) {
+                hashmap_set(map, &keys[i], &ids[i]);
+            }
+        }
+
+        void *values[100];
+        bool contains[100];
+        assert(hashmap_get_many(map, keys, 100, values) == 66);
+        assert(hashmap_contains_many(map, keys, 100, contains) == 66);
+        for (int i = 0; i < 100; i++) {
+            assert(values[i] == (i % 3 ? &ids[i] : NULL));
+            assert(contains[i] == (i % 3 != 0));
+        }
+
+        assert(hashmap_get_many(map, keys, 0, values) == 0);
+        hashmap_destroy(map);
+    }
+}
+
+void test_entry() {
+    unsigned long layouts[] = {0, HASHMAP_OPEN, HASHMAP_INCREMENTAL};
+    for (size_t layout = 0; layout < 3; layout++) {
+        struct hashmap_options options = {0};
+        options.flags = layouts[layout];
+        struct hashmap *map = hashmap_create_with_options(&options);
+
+        int ids[100];
+        for (int i = 0; i < 100; i++) {
+            ids[i] = i;
+        }
+
+        for (int round = 0; round < 3; round++) {
+            for (int i = 0; i < 100; i++) {
+                struct hkey key = {&ids[i], sizeof(ids[i])};
+                bool inserted;
+                void **value = hashmap_entry(map, &key, &inserted);
+                assert(value);
+                assert(errno == 0);
+                assert(inserted == (round == 0));
+                assert(*value == (round ? &ids[i] : NULL));
+                *value = &ids[i];
+            }
+        }
+        assert(map->size == 100);
+
+        int id = 7;
+        struct hkey key = {&id, sizeof(id)};
+        assert(hashmap_entry(map, &key, NULL) != NULL);
+        assert(hashmap_get(map, &key) == &ids[7]);
+
+        hashmap_destroy(map);
+    }
+}
+
+void *increment(void *value, void *context) {
+    size_t *calls = context;
+    (*calls)++;
+    return (void *)((uintptr_t)value + 1);
+}
+
+void test_update() {
+    struct hashmap *map = hashmap_create();
+
+    size_t calls = 0;
+    int ids[3] = {1, 2, 3};
+    for (int i = 0; i < 30; i++) {
+        struct hkey key = {&ids[i % 3], sizeof(ids[i % 3])};
+        void *value = hashmap_update(map, &key, increment, &calls);
+        assert((uintptr_t)value == (uintptr_t)(i / 3 + 1));
+        assert(errno == 0);
+    }
+
+    assert(calls == 30);
+    assert(map->size == 3);
+    for (int i = 0; i < 3; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        void *value = hashmap_get(map, &key);
+        assert((uintptr_t)value == 10);
+    }
+
+    hashmap_destroy(map);
+}
+
+void test_hashed() {
+    struct hashmap *l1 = hashmap_create();
+    struct hashmap_options options = {0};
+    options.flags = HASHMAP_OPEN;
+    struct hashmap *l2 = hashmap_create_with_options(&options);
+    options.flags = HASHMAP_FNV1A;
+    struct hashmap *fnv = hashmap_create_with_options(&options);
+
+    int id = 42;
+    struct hkey key = {&id, sizeof(id)};
+    uint64_t hash = hashmap_hash(l1, &key);
+    assert(hash == hashmap_hash(l2, &key));
+    assert(hash == hkey_hash(&id, sizeof(id)));
+    assert(hash != hashmap_hash(fnv, &key));
+
+    assert(hashmap_set_hashed(l1, &key, hash, "item 1") == NULL);
+    assert(errno == 0);
+    assert(hashmap_set_hashed(l2, &key, hash, "item 2") == NULL);
+    assert(strcmp(hashmap_get_hashed(l1, &key, hash), "item 1") == 0);
+    assert(strcmp(hashmap_get_hashed(l2, &key, hash), "item 2") == 0);
+    assert(strcmp(hashmap_get(l2, &key), "item 2") == 0);
+    assert(hashmap_contains_hashed(l1, &key, hash));
+
+    uint64_t fnv_hash = hashmap_hash(fnv, &key);
+    hashmap_set_hashed(fnv, &key, fnv_hash, "item 3");
+    assert(strcmp(hashmap_get(fnv, &key), "item 3") == 0);
+
+    assert(strcmp(hashmap_remove_hashed(l1, &key, hash), "item 1") == 0);
+    assert(!hashmap_contains_hashed(l1, &key, hash));
+    assert(hashmap_remove_hashed(l1, &key, hash) == NULL);
+    assert(hashmap_contains(l2, &key));
+
+    hashmap_destroy(l1);
+    hashmap_destroy(l2);
+    hashmap_destroy(fnv);
+}
+
+void test_seeded() {
+    struct hashmap_options options = {0};
+    options.flags = HASHMAP_FNV1A | HASHMAP_SIPHASH;
+    errno = 0;
+    assert(hashmap_create_with_options(&options) == NULL);
+    assert(errno == EINVAL);
+
+    int id = 42;
+    struct hkey key = {&id, sizeof(id)};
+    unsigned long hashes[] = {HASHMAP_SEEDED, HASHMAP_SIPHASH};
+    for (size_t i = 0; i < 2; i++) {
+        options.flags = hashes[i];
+        struct hashmap *a = hashmap_create_with_options(&options);
+        struct hashmap *b = hashmap_create_with_options(&options);
+        assert(a->seed[0] || a->seed[1]);
+        assert(hashmap_hash(a, &key) != hashmap_hash(b, &key));
+        assert(hashmap_hash(a, &key) != hkey_hash(&id, sizeof(id)));
+
+        options.seed[0] = 1;
+        options.seed[1] = 2;
+        struct hashmap *c = hashmap_create_with_options(&options);
+        struct hashmap *d = hashmap_create_with_options(&options);
+        assert(hashmap_hash(c, &key) == hashmap_hash(d, &key));
+        options.seed[0] = options.seed[1] = 0;
+
+        int ids[100];
+        for (int j = 0; j < 100; j++) {
+            ids[j] = j;
+            struct hkey jkey = {&ids[j], sizeof(ids[j])};
+            hashmap_set(a, &jkey, &ids[j]);
+        }
+
+        struct hashmap *clone = hashmap_clone(a);
+        assert(clone->seed[0] == a->seed[0] && clone->seed[1] == a->seed[1]);
+        assert(hashmap_merge(b, a));
+        for (int j = 0; j < 100; j++) {
+            struct hkey jkey = {&ids[j], sizeof(ids[j])};
+            assert(hashmap_get(b, &jkey) == &ids[j]);
+            assert(hashmap_get(clone, &jkey) == &ids[j]);
+        }
+
+        hashmap_destroy(a);
+        hashmap_destroy(b);
+        hashmap_destroy(c);
+        hashmap_destroy(d);
+        hashmap_destroy(clone);
+    }
+
+    /* Unseeded maps ignore the seed so they keep sharing hashes. */
+    options.flags = 0;
+    options.seed[0] = 7;
+    struct hashmap *map = hashmap_create_with_options(&options);
+    assert(hashmap_hash(map, &key) == hkey_hash(&id, sizeof(id)));
+    hashmap_destroy(map);
+}
+
+void test_touch() {
+    unsigned long layouts[] = {0, HASHMAP_OPEN};
+    for (size_t i = 0; i < 2; i++) {
+        struct hashmap_options options = {0};
+        options.flags = layouts[i];
+        struct hashmap *map = hashmap_create_with_options(&options);
+
+        int ids[3] = {0, 1, 2};
+        struct hkey keys[3];
+        for (int j = 0; j < 3; j++) {
+            keys[j].data = &ids[j];
+            keys[j].length = sizeof(ids[j]);
+            hashmap_set(map, &keys[j], &ids[j]);
+        }
+
+        int missing = 3;
+        struct hkey key = {&missing, sizeof(missing)};
+        assert(hashmap_touch(map, &key) == NULL);
+
+        /* Touching the tail leaves the order unchanged. */
+        assert(*hashmap_touch(map, &keys[2]) == &ids[2]);
+        assert(map->head->value == &ids[0]);
+        assert(map->tail->value == &ids[2]);
+
+        /* Touch the head, then the middle entry. */
+        void **value = hashmap_touch(map, &keys[0]);
+        assert(*value == &ids[0]);
+        assert(map->head->value == &ids[1]);
+        assert(map->tail->value == &ids[0]);
+        assert(map->head->prev == NULL);
+        assert(map->tail->next == NULL);
+
+        hashmap_touch(map, &keys[2]);
+        struct hentry *entry = map->head;
+        assert(entry->value == &ids[1]);
+        assert(entry->next->value == &ids[0]);
+        assert(entry->next->next->value == &ids[2]);
+        assert(entry->next->prev == entry);
+        assert(map->tail->prev == entry->next);
+
+        /* The returned pointer updates the stored value. */
+        *value = &ids[1];
+        assert(hashmap_get(map, &keys[0]) == &ids[1]);
+
+        /* Touching an entry promotes stored keys and appends new ones. */
+        bool inserted;
+        value = hashmap_touch_entry(map, &keys[1], &inserted);
+        assert(!inserted);
+        assert(*value == &ids[1]);
+        assert(*(int *)map->tail->key.data == 1);
+        assert(*(int *)map->head->key.data == 0);
+
+        value = hashmap_touch_entry(map, &key, &inserted);
+        assert(inserted);
+        assert(*value == NULL);
+        assert(map->tail->key.length == sizeof(missing));
+        assert(map->size == 4);
+
+        hashmap_destroy(map);
+    }
+}
+
+size_t longest_chain(struct hashmap *map) {
+    size_t longest = 0;
+    for (size_t i = 0; i < map->capacity; i++) {
+        size_t length = 0;
+        for (struct hentry *entry = map->entries[i]; entry;
+             entry = entry->chain) {
+            length++;
+        }
+        longest = length > longest ? length : longest;
+    }
+    return longest;
+}
+
+void test_collisions() {
+    /* Find keys the unseeded hash puts in the same bucket, as an attacker
+     * who knows the hash function could.
+     */
+    struct hashmap *probe = hashmap_create_with_capacity(768);
+    assert(probe->capacity == 1024);
+    size_t ids[64];
+    size_t found = 0;
+    for (size_t id = 0; found < 64; id++) {
+        struct hkey key = {&id, sizeof(id)};
+        hashmap_set(probe, &key, NULL);
+        if (probe->entries[0]) {
+            ids[found++] = id;
+        }
+        hashmap_remove(probe, &key);
+    }
+    hashmap_destroy(probe);
+
+    unsigned long hashes[] = {0, HASHMAP_SEEDED, HASHMAP_SIPHASH};
+    for (size_t i = 0; i < 3; i++) {
+        struct hashmap_options options = {0};
+        options.flags = hashes[i];
+        options.capacity = 768;
+        struct hashmap *map = hashmap_create_with_options(&options);
+        for (size_t j = 0; j < 64; j++) {
+            struct hkey key = {&ids[j], sizeof(ids[j])};
+            hashmap_set(map, &key, &ids[j]);
+        }
+
+        assert(map->capacity == 1024);
+        if (hashes[i]) {
+            assert(longest_chain(map) < 8);
+        } else {
+            assert(longest_chain(map) == 64);
+        }
+        hashmap_destroy(map);
+    }
+}
+
+#ifdef HASHMAP_STATS
+void test_stats() {
+    unsigned long layouts[] = {0, HASHMAP_OPEN, HASHMAP_INCREMENTAL};
+    for (size_t i = 0; i < 3; i++) {
+        struct hashmap_options options = {0};
+        options.flags = layouts[i];
+        struct hashmap *map = hashmap_create_with_options(&options);
+
+        struct hashmap_stats stats;
+        hashmap_stats(map, &stats);
+        assert(stats.size == 0);
+        assert(stats.capacity == 16);
+        assert(stats.max_probe == 0);
+        assert(stats.mean_probe <= 0);
+        assert(stats.resizes == 0);
+        assert(stats.key_bytes == 0);
+
+        int ids[1000];
+        for (int j = 0; j < 1000; j++) {
+            ids[j] = j;
+            struct hkey key = {&ids[j], sizeof(ids[j])};
+            hashmap_set(map, &key, &ids[j]);
+        }
+
+        hashmap_stats(map, &stats);
+        assert(stats.size == 1000);
+        assert(stats.capacity == map->capacity);
+        assert(stats.load > .4 && stats.load <= .75);
+        assert(stats.resizes == 7);
+        assert(stats.resize_seconds >= 0);
+        assert(stats.key_bytes == 1000 * sizeof(int));
+        assert(stats.max_probe >= 1);
+        assert(stats.mean_probe >= 1 && stats.mean_probe < 3);
+
+        size_t counted = 0;
+        for (size_t j = 0; j < HASHMAP_PROBE_BINS; j++) {
+            counted += stats.probes[j];
+        }
+        assert(counted == 1000);
+        assert(stats.probes[0] > stats.probes[1]);
+        if (!(layouts[i] & HASHMAP_OPEN)) {
+            assert(stats.max_probe == longest_chain(map));
+        }
+
+        hashmap_destroy(map);
+    }
+}
+#endif
+
 int main() {
     test_create();
     test_get();
     test_set();
     test_contains();
     test_iterator();
+    test_iter();
+    test_next_batch();
     test_remove();
     test_merge();
     test_clone();
+    test_open();
+    test_key_lengths();
+    test_fnv1a();
+    test_slab();
+    test_incremental();
+    test_capacity();
+    test_shrink();
+    test_get_many();
+    test_entry();
+    test_update();
+    test_hashed();
+    test_seeded();
+    test_touch();
+    test_collisions();
+#ifdef HASHMAP_STATS
+    test_stats();
+#endif
 
     return 0;
 }
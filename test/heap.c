@@ -1,10 +1,18 @@
 #include "heap.h"
 #include <assert.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 int compare_nodes(const void *a, const void *b);
+int compare_ints(const void *a, const void *b);
+bool is_heap(struct heap *heap);
+void *failing_alloc(void *context, size_t size);
+void *failing_realloc(void *context, void *memory, size_t size,
+                      size_t new_size);
+void failing_free(void *context, void *memory, size_t size);
 void test_create(void);
 void test_push(void);
 void test_pop(void);
@@ -12,9 +20,50 @@ void test_clear(void);
 void test_clone(void);
 void test_merge(void);
 void test_iterator(void);
+void test_next_batch(void);
+void test_peek(void);
+void test_top_k(void);
+void test_sorted_iterator(void);
+void test_iterator_memory(void);
+void test_create_from(void);
+void test_push_many(void);
+void test_pop_order(void);
+void test_arity(void);
 
 int compare_nodes(const void *a, const void *b) { return strcmp(a, b); }
 
+int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+bool is_heap(struct heap *heap) {
+    for (size_t k = 1; k < heap->size; k++) {
+        size_t parent = (k - 1) / heap->arity;
+        if (heap->comparator(heap->nodes[parent], heap->nodes[k]) > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void *failing_alloc(void *context, size_t size) {
+    return *(bool *)context ? NULL : malloc(size);
+}
+
+void *failing_realloc(void *context, void *memory, size_t size,
+                      size_t new_size) {
+    (void)size;
+    return *(bool *)context ? NULL : realloc(memory, new_size);
+}
+
+void failing_free(void *context, void *memory, size_t size) {
+    (void)context;
+    (void)size;
+    free(memory);
+}
+
 void test_create() {
     struct heap *heap = heap_create(compare_nodes);
 
@@ -168,6 +217,318 @@ void test_iterator() {
     heap_destroy(heap);
 }
 
+void test_next_batch() {
+    struct heap *heap = heap_create(compare_nodes);
+
+    char *names[] = {"e", "b", "d", "a", "c"};
+    for (int i = 0; i < 5; i++) {
+        heap_push(heap, names[i]);
+    }
+
+    void *nodes[3];
+    struct iterator *iter = heap_iterator(heap);
+    assert(iter->next_batch(iter, nodes, 3) == 3);
+    assert(strcmp(nodes[0], "a") == 0);
+    assert(strcmp(nodes[1], "b") == 0);
+    assert(strcmp(nodes[2], "c") == 0);
+    assert(iter->current == nodes[2]);
+    assert(iter->index == 2);
+
+    assert(iter->next_batch(iter, nodes, 3) == 2);
+    assert(strcmp(nodes[0], "d") == 0);
+    assert(strcmp(nodes[1], "e") == 0);
+    assert(iter->current == NULL);
+    assert(iter->index == 4);
+    assert(iter->next_batch(iter, nodes, 3) == 0);
+    iter->destroy(iter);
+
+    assert(heap->size == 5);
+    heap_destroy(heap);
+}
+
+void test_peek() {
+    struct heap *heap = heap_create(compare_nodes);
+    assert(heap_peek(heap) == NULL);
+
+    char *a = "test 1";
+    char *b = "test 2";
+    heap_push(heap, b);
+    assert(heap_peek(heap) == b);
+    heap_push(heap, a);
+    assert(heap_peek(heap) == a);
+    assert(heap->size == 2);
+
+    assert(heap_pop(heap) == a);
+    assert(heap_peek(heap) == b);
+
+    heap_destroy(heap);
+}
+
+void test_top_k() {
+    struct heap *heap = heap_create(compare_ints);
+
+    void *top[20];
+    assert(heap_top_k(heap, 10, top) == 0);
+
+    int values[1000];
+    for (int i = 0; i < 1000; i++) {
+        values[i] = (i * 7919) % 1000;
+        heap_push(heap, &values[i]);
+    }
+
+    void **nodes = malloc(heap->size * sizeof(void *));
+    memcpy(nodes, heap->nodes, heap->size * sizeof(void *));
+
+    assert(heap_top_k(heap, 0, top) == 0);
+    assert(heap_top_k(heap, 10, top) == 10);
+    for (int i = 0; i < 10; i++) {
+        assert(*(int *)top[i] == i);
+    }
+
+    /* The heap is left as it was. */
+    assert(heap->size == 1000);
+    assert(memcmp(nodes, heap->nodes, heap->size * sizeof(void *)) == 0);
+    free(nodes);
+
+    heap_destroy(heap);
+
+    heap = heap_create(compare_ints);
+    for (int i = 0; i < 5; i++) {
+        heap_push(heap, &values[i]);
+    }
+    assert(heap_top_k(heap, 20, top) == 5);
+    for (int i = 1; i < 5; i++) {
+        assert(*(int *)top[i - 1] <= *(int *)top[i]);
+    }
+    heap_destroy(heap);
+}
+
+void test_sorted_iterator() {
+    struct heap *heap = heap_create(compare_ints);
+
+    int values[1000];
+    for (int i = 0; i < 1000; i++) {
+        values[i] = (i * 7919) % 500;
+        heap_push(heap, &values[i]);
+    }
+
+    int previous = -1;
+    size_t count = 0;
+    struct iterator *iter = heap_iterator(heap);
+    while (iter->next(iter)) {
+        int value = *(int *)iter->current;
+        assert(value >= previous);
+        assert(iter->index == count);
+        previous = value;
+        count++;
+    }
+    assert(count == 1000);
+    iter->destroy(iter);
+
+    assert(heap->size == 1000);
+    assert(*(int *)heap_peek(heap) == 0);
+
+    heap_clear(heap);
+    iter = heap_iterator(heap);
+    assert(iter->next(iter) == NULL);
+    iter->destroy(iter);
+
+    heap_destroy(heap);
+}
+
+void test_iterator_memory() {
+    bool fail = false;
+    struct allocator allocator = {failing_alloc, failing_realloc,
+                                  failing_free, &fail};
+    struct heap *heap = heap_create_with_allocator(compare_ints, &allocator);
+
+    int values[1000];
+    for (int i = 0; i < 1000; i++) {
+        values[i] = i;
+        heap_push(heap, &values[i]);
+    }
+
+    /* Iteration stops early, and says why, when the frontier can't grow. */
+    struct iterator *iter = heap_iterator(heap);
+    fail = true;
+    size_t count = 0;
+    while (iter->next(iter)) {
+        count++;
+    }
+    assert(count > 0);
+    assert(count < 1000);
+    assert(errno == ENOMEM);
+
+    void *nodes[4];
+    assert(iter->next_batch(iter, nodes, 4) == 0);
+    assert(errno == ENOMEM);
+    iter->destroy(iter);
+
+    /* heap_top_k can't allocate its frontier either. */
+    assert(heap_top_k(heap, 4, nodes) == 0);
+    assert(errno == ENOMEM);
+
+    fail = false;
+    iter = heap_iterator(heap);
+    count = 0;
+    while (iter->next(iter)) {
+        count++;
+    }
+    assert(count == 1000);
+    assert(errno == 0);
+
+    errno = ENOMEM;
+    assert(iter->next_batch(iter, nodes, 4) == 0);
+    assert(errno == 0);
+    iter->destroy(iter);
+
+    errno = ENOMEM;
+    assert(heap_top_k(heap, 4, nodes) == 4);
+    assert(errno == 0);
+    assert(*(int *)nodes[3] == 3);
+
+    heap_destroy(heap);
+}
+
+void test_create_from() {
+    int values[1000];
+    void *items[1000];
+    for (int i = 0; i < 1000; i++) {
+        values[i] = (i * 7919) % 1000;
+        items[i] = &values[i];
+    }
+
+    struct heap *heap = heap_create_from(compare_ints, items, 1000);
+    assert(heap->size == 1000);
+    assert(heap->capacity >= 1000);
+    assert(is_heap(heap));
+    for (int i = 0; i < 1000; i++) {
+        assert(*(int *)heap_pop(heap) == i);
+    }
+    heap_destroy(heap);
+
+    heap = heap_create_from(compare_ints, NULL, 0);
+    assert(heap->size == 0);
+    assert(heap_pop(heap) == NULL);
+    heap_destroy(heap);
+}
+
+void test_push_many() {
+    int values[1000];
+    void *items[1000];
+    for (int i = 0; i < 1000; i++) {
+        values[i] = (i * 7919) % 1000;
+        items[i] = &values[i];
+    }
+
+    /* Small batches are pushed, large ones rebuild the heap. */
+    struct heap *heap = heap_create(compare_ints);
+    assert(heap_push_many(heap, items, 100));
+    assert(is_heap(heap));
+    assert(heap_push_many(heap, items + 100, 10));
+    assert(is_heap(heap));
+    assert(heap_push_many(heap, items + 110, 890));
+    assert(heap->size == 1000);
+    for (int i = 0; i < 1000; i++) {
+        assert(*(int *)heap_pop(heap) == i);
+    }
+
+    /* A heap may be merged into itself. */
+    assert(heap_push_many(heap, items, 10));
+    assert(heap_merge(heap, heap));
+    assert(heap->size == 20);
+    assert(is_heap(heap));
+
+    heap_destroy(heap);
+}
+
+void test_pop_order() {
+    struct heap *heap = heap_create(compare_ints);
+
+    /* Many duplicates, pushed in an order that sends some nodes to the root
+     * and others straight to a leaf.
+     */
+    int values[500];
+    for (int i = 0; i < 500; i++) {
+        values[i] = i % 2 ? 500 - i % 37 : (i * 31) % 17;
+        heap_push(heap, &values[i]);
+        assert(is_heap(heap));
+    }
+
+    int previous = -1;
+    for (int i = 0; i < 500; i++) {
+        int value = *(int *)heap_pop(heap);
+        assert(value >= previous);
+        assert(is_heap(heap));
+        assert(heap->size == 499 - (size_t)i);
+        previous = value;
+    }
+    assert(heap_pop(heap) == NULL);
+
+    heap_destroy(heap);
+}
+
+void test_arity() {
+    struct heap_options options = {0};
+    options.arity = 3;
+    errno = 0;
+    assert(heap_create_with_options(compare_ints, &options) == NULL);
+    assert(errno == EINVAL);
+
+    int values[1000];
+    void *items[1000];
+    for (int i = 0; i < 1000; i++) {
+        values[i] = (i * 7919) % 1000;
+        items[i] = &values[i];
+    }
+
+    size_t arities[] = {2, 4, 8};
+    for (size_t a = 0; a < 3; a++) {
+        options.arity = arities[a];
+        struct heap *heap = heap_create_with_options(compare_ints, &options);
+        assert(heap->arity == arities[a]);
+
+        /* Each node's children start on a multiple of the arity. */
+        for (int i = 0; i < 1000; i++) {
+            heap_push(heap, items[i]);
+            assert((uintptr_t)&heap->nodes[1] % HEAP_ALIGNMENT == 0);
+        }
+        assert(is_heap(heap));
+
+        void *top[10];
+        assert(heap_top_k(heap, 10, top) == 10);
+        for (int i = 0; i < 10; i++) {
+            assert(*(int *)top[i] == i);
+        }
+
+        int previous = -1;
+        struct iterator *iter = heap_iterator(heap);
+        while (iter->next(iter)) {
+            assert(*(int *)iter->current > previous);
+            previous = *(int *)iter->current;
+        }
+        assert(previous == 999);
+        iter->destroy(iter);
+
+        struct heap *clone = heap_clone(heap);
+        assert(clone->arity == arities[a]);
+        heap_destroy(clone);
+
+        for (int i = 0; i < 1000; i++) {
+            assert(*(int *)heap_pop(heap) == i);
+            assert(is_heap(heap));
+        }
+
+        assert(heap_push_many(heap, items, 1000));
+        assert(is_heap(heap));
+        assert(heap_push_many(heap, items, 10));
+        assert(is_heap(heap));
+        assert(heap->size == 1010);
+
+        heap_destroy(heap);
+    }
+}
+
 int main() {
     test_create();
     test_push();
@@ -176,6 +537,15 @@ int main() {
     test_clone();
     test_merge();
     test_iterator();
+    test_next_batch();
+    test_peek();
+    test_top_k();
+    test_sorted_iterator();
+    test_iterator_memory();
+    test_create_from();
+    test_push_many();
+    test_pop_order();
+    test_arity();
 
     return 0;
 }
@@ -12,6 +12,8 @@ void test_clone(void);
 void test_concat(void);
 void test_clear(void);
 void test_iterator(void);
+void test_iter(void);
+void test_next_batch(void);
 
 void test_create() {
     struct list *list = list_create();
@@ -213,6 +215,37 @@ void test_clear() {
     list_destroy(list);
 }
 
+void test_iter() {
+    struct list *list = list_create();
+
+    struct list_iter iter;
+    list_iter_init(&iter, list);
+    assert(!list_iter_next(&iter));
+
+    char *items[] = {"test1", NULL, "test3"};
+    for (size_t i = 0; i < 3; i++) {
+        list_push(list, items[i]);
+    }
+
+    list_iter_init(&iter, list);
+    for (size_t i = 0; i < 3; i++) {
+        assert(list_iter_next(&iter));
+        assert(iter.current == items[i]);
+    }
+    assert(!list_iter_next(&iter));
+    assert(iter.current == NULL);
+
+    size_t count = 0;
+    char *item;
+    LIST_FOREACH(item, list) {
+        assert(item == items[count]);
+        count++;
+    }
+    assert(count == 3);
+
+    list_destroy(list);
+}
+
 void test_iterator() {
     struct list *list = list_create();
 
@@ -245,6 +278,39 @@ void test_iterator() {
     list_destroy(list);
 }
 
+void test_next_batch() {
+    struct list *list = list_create();
+
+    int ids[10];
+    for (int i = 0; i < 10; i++) {
+        ids[i] = i;
+        list_push(list, &ids[i]);
+    }
+
+    void *items[4];
+    struct iterator *iter = list_iterator(list);
+    assert(iter->next_batch(iter, items, 4) == 4);
+    assert(items[0] == &ids[0]);
+    assert(items[3] == &ids[3]);
+    assert(iter->current == &ids[3]);
+    assert(iter->index == 3);
+
+    /* Items fetched one at a time continue after the batch. */
+    assert(iter->next(iter) == &ids[4]);
+    assert(iter->index == 4);
+    assert(iter->next_batch(iter, items, 4) == 4);
+    assert(items[0] == &ids[5]);
+    assert(iter->index == 8);
+    assert(iter->next_batch(iter, items, 4) == 1);
+    assert(items[0] == &ids[9]);
+    assert(iter->current == NULL);
+    assert(iter->index == 9);
+    assert(iter->next_batch(iter, items, 4) == 0);
+    iter->destroy(iter);
+
+    list_destroy(list);
+}
+
 int main() {
     test_create();
     test_push();
@@ -255,6 +321,8 @@ int main() {
     test_clone();
     test_concat();
     test_iterator();
+    test_iter();
+    test_next_batch();
 
     return 0;
 }
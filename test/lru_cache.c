@@ -0,0 +1,226 @@
+#include "lru_cache.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct evictions {
+    size_t count;
+    size_t bytes;
+    void *last;
+};
+
+size_t weigh_value(struct hkey *key, void *value);
+void record_eviction(struct hkey *key, void *value, void *context);
+void test_create(void);
+void test_get(void);
+void test_max_entries(void);
+void test_max_bytes(void);
+void test_remove(void);
+void test_clear(void);
+
+size_t weigh_value(struct hkey *key, void *value) {
+    return key->length + strlen(value);
+}
+
+void record_eviction(struct hkey *key, void *value, void *context) {
+    struct evictions *evictions = context;
+    evictions->count++;
+    evictions->bytes += key->length;
+    evictions->last = value;
+}
+
+void test_create() {
+    struct lru_cache *cache = lru_cache_create(10);
+    assert(cache->map->size == 0);
+    assert(cache->max_entries == 10);
+    assert(cache->max_bytes == 0);
+    assert(cache->bytes == 0);
+    lru_cache_destroy(cache);
+
+    struct lru_cache_options options = {0};
+    options.flags = HASHMAP_OPEN | HASHMAP_INCREMENTAL;
+    errno = 0;
+    assert(lru_cache_create_with_options(&options) == NULL);
+    assert(errno == EINVAL);
+}
+
+void test_get() {
+    struct lru_cache *cache = lru_cache_create(0);
+
+    int id = 42;
+    struct hkey key = {&id, sizeof(id)};
+    char *a = "item 1";
+    char *b = "item 2";
+
+    assert(lru_cache_get(cache, &key) == NULL);
+    assert(!lru_cache_contains(cache, &key));
+    assert(lru_cache_set(cache, &key, a) == NULL);
+    assert(errno == 0);
+    assert(lru_cache_get(cache, &key) == a);
+    assert(lru_cache_peek(cache, &key) == a);
+    assert(lru_cache_contains(cache, &key));
+    assert(lru_cache_set(cache, &key, b) == a);
+    assert(lru_cache_get(cache, &key) == b);
+    assert(cache->map->size == 1);
+    assert(cache->bytes == sizeof(id));
+
+    lru_cache_destroy(cache);
+}
+
+void test_max_entries() {
+    struct evictions evictions = {0};
+    struct lru_cache_options options = {0};
+    options.max_entries = 3;
+    options.evict = record_eviction;
+    options.context = &evictions;
+    struct lru_cache *cache = lru_cache_create_with_options(&options);
+
+    int ids[5] = {0, 1, 2, 3, 4};
+    struct hkey keys[5];
+    for (int i = 0; i < 5; i++) {
+        keys[i].data = &ids[i];
+        keys[i].length = sizeof(ids[i]);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        lru_cache_set(cache, &keys[i], &ids[i]);
+    }
+    assert(evictions.count == 0);
+
+    /* Promote 0, so 1 is the least recently used. */
+    assert(lru_cache_get(cache, &keys[0]) == &ids[0]);
+    lru_cache_set(cache, &keys[3], &ids[3]);
+    assert(evictions.count == 1);
+    assert(evictions.last == &ids[1]);
+    assert(!lru_cache_contains(cache, &keys[1]));
+
+    /* Peeking doesn't promote, but replacing a value does. */
+    assert(lru_cache_peek(cache, &keys[2]) == &ids[2]);
+    assert(lru_cache_set(cache, &keys[0], &ids[0]) == &ids[0]);
+    lru_cache_set(cache, &keys[4], &ids[4]);
+    assert(evictions.count == 2);
+    assert(evictions.last == &ids[2]);
+
+    assert(cache->map->size == 3);
+    struct hentry *entry = cache->map->head;
+    assert(entry->value == &ids[3]);
+    assert(entry->next->value == &ids[0]);
+    assert(entry->next->next->value == &ids[4]);
+
+    lru_cache_destroy(cache);
+    assert(evictions.count == 5);
+}
+
+void test_max_bytes() {
+    struct evictions evictions = {0};
+    struct lru_cache_options options = {0};
+    options.max_bytes = 40;
+    options.weigh = weigh_value;
+    options.evict = record_eviction;
+    options.context = &evictions;
+    options.flags = HASHMAP_OPEN;
+    struct lru_cache *cache = lru_cache_create_with_options(&options);
+
+    char keys[4][8] = {"key 0", "key 1", "key 2", "key 3"};
+    char *values[] = {"ten bytes.", "ten bytes.", "twenty bytes of data"};
+
+    struct hkey key0 = {keys[0], 5};
+    struct hkey key1 = {keys[1], 5};
+    struct hkey key2 = {keys[2], 5};
+    lru_cache_set(cache, &key0, values[0]);
+    lru_cache_set(cache, &key1, values[1]);
+    assert(cache->bytes == 30);
+
+    lru_cache_set(cache, &key2, values[2]);
+    assert(cache->bytes == 40);
+    assert(evictions.count == 1);
+    assert(evictions.last == values[0]);
+
+    /* Growing a value evicts the least recently used entries. */
+    assert(lru_cache_set(cache, &key1, values[2]) == values[1]);
+    assert(evictions.count == 2);
+    assert(evictions.last == values[2]);
+    assert(cache->bytes == 25);
+    assert(lru_cache_get(cache, &key1) == values[2]);
+
+    /* An entry heavier than the limit can't be kept. */
+    char big[64];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    struct hkey key3 = {keys[3], 5};
+    lru_cache_set(cache, &key3, big);
+    assert(cache->map->size == 0);
+    assert(cache->bytes == 0);
+    assert(evictions.last == big);
+
+    lru_cache_destroy(cache);
+}
+
+void test_remove() {
+    struct lru_cache *cache = lru_cache_create(100);
+
+    int ids[100];
+    for (int i = 0; i < 100; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        lru_cache_set(cache, &key, &ids[i]);
+    }
+    assert(cache->bytes == 100 * sizeof(int));
+
+    for (int i = 0; i < 100; i += 2) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(lru_cache_remove(cache, &key) == &ids[i]);
+        assert(lru_cache_remove(cache, &key) == NULL);
+    }
+    assert(cache->map->size == 50);
+    assert(cache->bytes == 50 * sizeof(int));
+
+    /* Keys holding null values still give back their weight. */
+    struct hkey key = {&ids[0], sizeof(ids[0])};
+    lru_cache_set(cache, &key, NULL);
+    assert(cache->bytes == 51 * sizeof(int));
+    assert(lru_cache_remove(cache, &key) == NULL);
+    assert(cache->bytes == 50 * sizeof(int));
+    assert(lru_cache_remove(cache, &key) == NULL);
+    assert(cache->bytes == 50 * sizeof(int));
+
+    lru_cache_destroy(cache);
+}
+
+void test_clear() {
+    struct evictions evictions = {0};
+    struct lru_cache_options options = {0};
+    options.evict = record_eviction;
+    options.context = &evictions;
+    options.flags = HASHMAP_SLAB;
+    struct lru_cache *cache = lru_cache_create_with_options(&options);
+
+    char key[100] = "a long key that is stored outside of its entry";
+    for (int i = 0; i < 10; i++) {
+        key[99] = (char)i;
+        struct hkey hkey = {key, sizeof(key)};
+        lru_cache_set(cache, &hkey, NULL);
+    }
+
+    lru_cache_clear(cache);
+    assert(evictions.count == 10);
+    assert(evictions.bytes == 10 * sizeof(key));
+    assert(cache->map->size == 0);
+    assert(cache->bytes == 0);
+
+    lru_cache_destroy(cache);
+    assert(evictions.count == 10);
+}
+
+int main() {
+    test_create();
+    test_get();
+    test_max_entries();
+    test_max_bytes();
+    test_remove();
+    test_clear();
+
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "rcu_hashmap.h"
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define KEYS 2000
+#define READERS 4
+#define WRITERS 2
+#define ROUNDS 20
+
+struct stress {
+    struct rcu_hashmap *map;
+    int *ids;
+    int writer;
+    int padding;
+};
+
+void *read_keys(void *context);
+void *write_keys(void *context);
+void test_create(void);
+void test_get(void);
+void test_remove(void);
+void test_long_keys(void);
+void test_stress(void);
+
+void *read_keys(void *context) {
+    struct stress *stress = context;
+    struct rreader *reader = rcu_hashmap_register(stress->map);
+    for (int round = 0; round < ROUNDS * 4; round++) {
+        for (int i = 0; i < KEYS; i++) {
+            struct hkey key = {&stress->ids[i], sizeof(stress->ids[i])};
+            int *value = rcu_hashmap_get(stress->map, reader, &key);
+            assert(value == NULL || value == &stress->ids[i]);
+        }
+    }
+    rcu_hashmap_unregister(stress->map, reader);
+    return NULL;
+}
+
+void *write_keys(void *context) {
+    struct stress *stress = context;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = stress->writer; i < KEYS; i += WRITERS) {
+            struct hkey key = {&stress->ids[i], sizeof(stress->ids[i])};
+            rcu_hashmap_set(stress->map, &key, &stress->ids[i]);
+            assert(errno == 0);
+        }
+        for (int i = stress->writer; i < KEYS; i += WRITERS * 2) {
+            struct hkey key = {&stress->ids[i], sizeof(stress->ids[i])};
+            assert(rcu_hashmap_remove(stress->map, &key) == &stress->ids[i]);
+        }
+    }
+    return NULL;
+}
+
+void test_create() {
+    struct rcu_hashmap *map = rcu_hashmap_create();
+    assert(map->size == 0);
+    assert(map->readers == NULL);
+
+    struct rreader *reader = rcu_hashmap_register(map);
+    assert(map->readers == reader);
+    rcu_hashmap_unregister(map, reader);
+    assert(map->readers == NULL);
+
+    rcu_hashmap_destroy(map);
+}
+
+void test_get() {
+    struct rcu_hashmap *map = rcu_hashmap_create();
+    struct rreader *reader = rcu_hashmap_register(map);
+
+    int id = 42;
+    struct hkey key = {&id, sizeof(id)};
+    char *a = "item 1";
+    char *b = "item 2";
+
+    assert(rcu_hashmap_get(map, reader, &key) == NULL);
+    assert(!rcu_hashmap_contains(map, reader, &key));
+    assert(rcu_hashmap_set(map, &key, a) == NULL);
+    assert(errno == 0);
+    assert(rcu_hashmap_get(map, reader, &key) == a);
+    assert(rcu_hashmap_contains(map, reader, &key));
+    assert(rcu_hashmap_set(map, &key, b) == a);
+    assert(rcu_hashmap_get(map, reader, &key) == b);
+    assert(map->size == 1);
+
+    rcu_hashmap_unregister(map, reader);
+    rcu_hashmap_destroy(map);
+}
+
+void test_remove() {
+    struct rcu_hashmap *map = rcu_hashmap_create();
+    struct rreader *reader = rcu_hashmap_register(map);
+
+    int ids[1000];
+    for (int i = 0; i < 1000; i++) {
+        ids[i] = i;
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        rcu_hashmap_set(map, &key, &ids[i]);
+    }
+    assert(map->size == 1000);
+
+    for (int i = 0; i < 1000; i += 2) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(rcu_hashmap_remove(map, &key) == &ids[i]);
+        assert(rcu_hashmap_remove(map, &key) == NULL);
+    }
+    assert(map->size == 500);
+
+    for (int i = 0; i < 1000; i++) {
+        struct hkey key = {&ids[i], sizeof(ids[i])};
+        assert(rcu_hashmap_contains(map, reader, &key) == (i % 2 == 1));
+    }
+
+    /* Nothing is left to reclaim once no lookup is running. */
+    assert(map->retired == NULL);
+
+    rcu_hashmap_unregister(map, reader);
+    rcu_hashmap_destroy(map);
+}
+
+void test_long_keys() {
+    struct rcu_hashmap *map = rcu_hashmap_create();
+    struct rreader *reader = rcu_hashmap_register(map);
+
+    char a[100] = "a long key that is stored after the entry";
+    char b[100] = "a long key that is stored after the entry";
+    b[99] = 'b';
+    struct hkey akey = {a, sizeof(a)};
+    struct hkey bkey = {b, sizeof(b)};
+
+    rcu_hashmap_set(map, &akey, a);
+    rcu_hashmap_set(map, &bkey, b);
+    assert(rcu_hashmap_get(map, reader, &akey) == a);
+    assert(rcu_hashmap_get(map, reader, &bkey) == b);
+
+    rcu_hashmap_unregister(map, reader);
+    rcu_hashmap_destroy(map);
+}
+
+void test_stress() {
+    struct rcu_hashmap *map = rcu_hashmap_create();
+    int *ids = malloc(KEYS * sizeof(int));
+    for (int i = 0; i < KEYS; i++) {
+        ids[i] = i;
+    }
+
+    pthread_t threads[READERS + WRITERS];
+    struct stress stress[READERS + WRITERS];
+    for (int i = 0; i < READERS + WRITERS; i++) {
+        stress[i].map = map;
+        stress[i].ids = ids;
+        stress[i].writer = i - READERS;
+        pthread_create(&threads[i], NULL, i < READERS ? read_keys : write_keys,
+                       &stress[i]);
+    }
+    for (int i = 0; i < READERS + WRITERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    assert(map->readers == NULL);
+    assert(map->retired == NULL);
+    assert(map->size == KEYS / 2);
+
+    rcu_hashmap_destroy(map);
+    free(ids);
+}
+
+int main() {
+    test_create();
+    test_get();
+    test_remove();
+    test_long_keys();
+    test_stress();
+
+    return 0;
+}
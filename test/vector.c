@@ -15,6 +15,8 @@ void test_unshift(void);
 void test_shift(void);
 void test_sort(void);
 void test_iterator(void);
+void test_iter(void);
+void test_next_batch(void);
 void test_get(void);
 void test_set(void);
 void test_slice(void);
@@ -204,6 +206,55 @@ void test_sort() {
     vector_destroy(vector);
 }
 
+void test_iter() {
+    struct vector *vector = vector_create();
+
+    char *items[] = {"test1", NULL, "test3"};
+    for (size_t i = 0; i < 3; i++) {
+        vector_push(vector, items[i]);
+    }
+
+    struct vector_iter iter;
+    vector_iter_init(&iter, vector);
+    for (size_t i = 0; i < 3; i++) {
+        assert(vector_iter_next(&iter));
+        assert(iter.current == items[i]);
+        assert(iter.position == i + 1);
+    }
+    assert(!vector_iter_next(&iter));
+    assert(!vector_iter_next(&iter));
+    assert(iter.current == NULL);
+
+    /* Removing the current item skips the next, but never reads past the
+     * end of a vector that shrank.
+     */
+    vector_iter_init(&iter, vector);
+    assert(vector_iter_next(&iter));
+    vector_remove(vector, iter.position - 1);
+    assert(vector_iter_next(&iter));
+    assert(iter.current == items[2]);
+    vector_remove(vector, iter.position - 1);
+    assert(!vector_iter_next(&iter));
+    assert(iter.current == NULL);
+    vector_insert(vector, 0, items[0]);
+    vector_push(vector, items[2]);
+
+    size_t count = 0;
+    char *item;
+    VECTOR_FOREACH(item, vector) {
+        assert(item == items[count]);
+        count++;
+    }
+    assert(count == 3);
+
+    vector_clear(vector);
+    VECTOR_FOREACH(item, vector) {
+        assert(false);
+    }
+
+    vector_destroy(vector);
+}
+
 void test_iterator() {
     struct vector *vector = vector_create();
 
@@ -236,6 +287,55 @@ void test_iterator() {
     vector_destroy(vector);
 }
 
+void test_next_batch() {
+    struct vector *vector = vector_create();
+
+    int ids[10];
+    for (int i = 0; i < 10; i++) {
+        ids[i] = i;
+        vector_push(vector, &ids[i]);
+    }
+
+    void *items[4];
+    struct iterator *iter = vector_iterator(vector);
+    assert(iter->next(iter) == &ids[0]);
+    assert(iter->next_batch(iter, items, 4) == 4);
+    assert(items[0] == &ids[1]);
+    assert(items[3] == &ids[4]);
+    assert(iter->current == &ids[4]);
+    assert(iter->index == 5);
+
+    /* Items fetched one at a time continue after the batch. */
+    assert(iter->next(iter) == &ids[5]);
+    assert(iter->next_batch(iter, items, 4) == 4);
+    assert(items[3] == &ids[9]);
+    assert(iter->next_batch(iter, items, 4) == 0);
+    assert(iter->current == NULL);
+    assert(iter->index == 10);
+    iter->destroy(iter);
+
+    /* A short batch reaches the end. */
+    iter = vector_iterator(vector);
+    assert(iter->next_batch(iter, items, 0) == 0);
+    iter->index = 8;
+    assert(iter->next_batch(iter, items, 4) == 2);
+    assert(items[1] == &ids[9]);
+    assert(iter->current == NULL);
+    iter->destroy(iter);
+
+    /* A vector that shrank behind the iterator ends iteration. */
+    iter = vector_iterator(vector);
+    iter->index = 8;
+    vector_remove(vector, 9);
+    vector_remove(vector, 8);
+    vector_remove(vector, 7);
+    assert(iter->next_batch(iter, items, 4) == 0);
+    assert(iter->next(iter) == NULL);
+    iter->destroy(iter);
+
+    vector_destroy(vector);
+}
+
 void test_get() {
     struct vector *vector = vector_create();
 
@@ -389,6 +489,8 @@ int main() {
     test_shift();
     test_sort();
     test_iterator();
+    test_iter();
+    test_next_batch();
     test_get();
     test_set();
     test_slice();